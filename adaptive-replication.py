@@ -0,0 +1,218 @@
+"""! Adaptive replication of one configuration of nr-handover.cc or ex005.cc.
+
+Runs independent RNG replications (RngRun = first, first + 1, ...) of a single
+configuration, a batch of --jobs runs at a time, and after every batch computes
+the mean and the Student t confidence interval of each KPI over the runs done.
+It stops as soon as every KPI has a relative half-width within --precision, or
+when --max-runs runs are done. Only whole batches are evaluated, so the result
+does not depend on which runs of a batch finish first.
+
+The KPIs are summary.csv columns. The default set covers throughput, delay,
+handover interruption and loss of the FlowMonitor and handover KPI results.
+Adding -p earlyStop=1 also shortens every run once its own KPIs stabilise.
+
+Writes replications.csv (one row per run) and replication-summary.csv (one row
+per KPI) in the output directory.
+
+Example:
+    python3 scratch/adaptive-replication.py --program nr-handover --output adaptive \\
+        -p scenario=UMa -p speed=15 -p simTime=7 --precision 0.05 --max-runs 40
+"""
+
+import argparse
+import math
+import os
+import statistics
+import sys
+
+import handover_jobs
+
+DEFAULT_KPIS = "rxBitrateKbps,meanDelayMs,meanInterruptionMs,packetLossPercent"
+
+
+def betainc(a, b, x):
+    """! Regularized incomplete beta function I_x(a, b) (continued fraction)."""
+    if x <= 0:
+        return 0.0
+    if x >= 1:
+        return 1.0
+    if x > (a + 1) / (a + b + 2):
+        return 1.0 - betainc(b, a, 1.0 - x)
+    front = math.exp(
+        math.lgamma(a + b)
+        - math.lgamma(a)
+        - math.lgamma(b)
+        + a * math.log(x)
+        + b * math.log(1.0 - x)
+    )
+    # modified Lentz evaluation of the continued fraction
+    tiny = 1e-300
+    c, d = 1.0, 1.0 - (a + b) * x / (a + 1)
+    d = 1.0 / (d if abs(d) > tiny else tiny)
+    f = d
+    for m in range(1, 300):
+        for numerator in (
+            m * (b - m) * x / ((a + 2 * m - 1) * (a + 2 * m)),
+            -(a + m) * (a + b + m) * x / ((a + 2 * m) * (a + 2 * m + 1)),
+        ):
+            d = 1.0 + numerator * d
+            d = 1.0 / (d if abs(d) > tiny else tiny)
+            c = 1.0 + numerator / c
+            c = c if abs(c) > tiny else tiny
+            f *= c * d
+        if abs(c * d - 1.0) < 1e-12:
+            break
+    return front * f / a
+
+
+def student_t_quantile(p, dof):
+    """! Quantile p (> 0.5) of the Student t distribution, by bisection on its CDF."""
+    lo, hi = 0.0, 1.0
+    upper = lambda t: 0.5 * betainc(dof / 2.0, 0.5, dof / (dof + t * t))
+    while upper(hi) > 1.0 - p:
+        hi *= 2.0
+    for _ in range(100):
+        mid = (lo + hi) / 2.0
+        if upper(mid) > 1.0 - p:
+            lo = mid
+        else:
+            hi = mid
+    return (lo + hi) / 2.0
+
+
+def interval(values, confidence):
+    """! (mean, standard deviation, half-width of the confidence interval of the mean)."""
+    mean = statistics.fmean(values)
+    if len(values) < 2:
+        return mean, math.nan, math.inf
+    stdev = statistics.stdev(values)
+    t = student_t_quantile(0.5 + confidence / 2.0, len(values) - 1)
+    return mean, stdev, t * stdev / math.sqrt(len(values))
+
+
+def kpi_values(results, kpi):
+    """! Numeric values of a summary column over the successful runs."""
+    values = []
+    for r in results:
+        try:
+            v = float(r.get(kpi, ""))
+        except ValueError:
+            continue
+        if not math.isnan(v):
+            values.append(v)
+    return values
+
+
+def evaluate(results, kpis, confidence, precision):
+    """! One row per KPI; a KPI converges when half-width <= precision * |mean|."""
+    rows = []
+    for kpi in kpis:
+        values = kpi_values(results, kpi)
+        row = {"kpi": kpi, "runs": len(values)}
+        if values:
+            mean, stdev, half = interval(values, confidence)
+            relative = half / abs(mean) if mean != 0 else (0.0 if half == 0 else math.inf)
+            row.update(
+                {
+                    "mean": "%.6g" % mean,
+                    "stdev": "%.6g" % stdev,
+                    "halfWidth": "%.6g" % half,
+                    "relativeHalfWidth": "%.4g" % relative,
+                    "converged": int(relative <= precision),
+                }
+            )
+        else:
+            row["converged"] = 0
+        rows.append(row)
+    return rows
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--program", default="nr-handover", help="scratch program to run")
+    parser.add_argument("--output", default="adaptive", help="root directory of the job outputs")
+    parser.add_argument(
+        "-p",
+        "--param",
+        action="append",
+        default=[],
+        metavar="NAME=VALUE",
+        help="command line value of the configuration",
+    )
+    parser.add_argument("--kpi", default=DEFAULT_KPIS, help="comma separated summary columns")
+    parser.add_argument(
+        "--precision", type=float, default=0.05, help="target relative half-width (0.05 = 5%%)"
+    )
+    parser.add_argument("--confidence", type=float, default=0.95, help="confidence level")
+    parser.add_argument("--min-runs", type=int, default=3, help="runs before the first test")
+    parser.add_argument("--max-runs", type=int, default=30, help="budget of runs")
+    parser.add_argument("--first-run", type=int, default=1, help="RngRun of the first run")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="parallel processes")
+    parser.add_argument("--ns3-dir", default=".", help="root of the ns-3 tree")
+    parser.add_argument("--binary", help="built program to run instead of ./ns3 run")
+    args = parser.parse_args(argv[1:])
+
+    params = {}
+    for item in args.param:
+        name, _, value = item.partition("=")
+        params[name] = value
+    kpis = [k for k in args.kpi.split(",") if k]
+    min_runs = max(2, args.min_runs)
+
+    results = []
+    failed = 0
+    stats = []
+    converged = False
+    run = args.first_run
+    while len(results) + failed < args.max_runs:
+        # the first batch reaches min-runs, the next ones use every worker
+        size = max(args.jobs, min_runs - len(results))
+        size = min(size, args.max_runs - len(results) - failed)
+        jobs = []
+        for rng_run in range(run, run + size):
+            job_params = dict(params)
+            job_params["RngRun"] = rng_run
+            jobs.append(
+                handover_jobs.Job("run%04d" % rng_run, args.program, job_params, args.output)
+            )
+        run += size
+        for result in handover_jobs.run_jobs(jobs, args.jobs, args.ns3_dir, args.binary):
+            if result["status"] == "ok":
+                results.append(result)
+            else:
+                failed += 1
+                print("%s failed (exit code %s)" % (result["job"], result["returncode"]))
+        results.sort(key=lambda r: r["job"])
+
+        stats = evaluate(results, kpis, args.confidence, args.precision)
+        print(
+            "%d runs: %s"
+            % (
+                len(results),
+                ", ".join(
+                    "%s %s +/- %s" % (s["kpi"], s.get("mean", "-"), s.get("halfWidth", "-"))
+                    for s in stats
+                ),
+            )
+        )
+        sys.stdout.flush()
+        if len(results) >= min_runs and all(s["converged"] for s in stats):
+            converged = True
+            break
+
+    os.makedirs(args.output, exist_ok=True)
+    handover_jobs.write_table(results, os.path.join(args.output, "replications.csv"))
+    table = os.path.join(args.output, "replication-summary.csv")
+    for s in stats:
+        s["confidence"] = args.confidence
+        s["precision"] = args.precision
+    handover_jobs.write_table(stats, table)
+    print(
+        "%s after %d runs (%d failed), written to %s"
+        % ("Converged" if converged else "Budget exhausted", len(results), failed, table)
+    )
+    return 0 if converged else 2
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
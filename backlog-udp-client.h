@@ -0,0 +1,224 @@
+#ifndef BACKLOG_UDP_CLIENT_H
+#define BACKLOG_UDP_CLIENT_H
+
+/**
+ * @file backlog-udp-client.h
+ * @brief Full-buffer UDP source that only sends while the downlink backlog is small.
+ *
+ * A UdpClient at a fixed interval far above the cell capacity keeps the cell busy but
+ * fills the RLC queue and the event list with packets that are dropped later. This
+ * client keeps at most MaxInFlight packets between itself and the UdpServer sink.
+ * It tracks the sequence number of every packet in flight: a packet leaves the window
+ * when the sink receives it (its "Rx" trace), or when it is LossWindow packets behind
+ * the newest one received, the point where the UdpServer counts it lost. Every packet
+ * out of the window lets a new one out, so the source follows the rate the cell
+ * actually serves and the queues and pending events stay bounded.
+ *
+ * If nothing reaches the sink for StallTimeout (e.g. packets lost in a handover), the
+ * packets in flight are written off and the window is refilled. A written-off packet
+ * that arrives late or is counted lost later does not leave the window a second time.
+ *
+ * The window covers the whole path, so it is the bandwidth-delay product of the path
+ * plus the backlog wanted in the RLC queue; GetBdpWindow sizes it.
+ *
+ * Packets carry a SeqTsHeader like UdpClient, so the UdpServer loss and the FlowMonitor
+ * statistics work unchanged.
+ */
+
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <set>
+
+namespace ns3
+{
+
+class BacklogUdpClient : public Application
+{
+  public:
+    static TypeId GetTypeId()
+    {
+        static TypeId tid =
+            TypeId("ns3::BacklogUdpClient")
+                .SetParent<Application>()
+                .AddConstructor<BacklogUdpClient>()
+                .AddAttribute("PacketSize",
+                              "Size of the UDP payload including the 12 byte SeqTsHeader",
+                              UintegerValue(1500),
+                              MakeUintegerAccessor(&BacklogUdpClient::m_size),
+                              MakeUintegerChecker<uint32_t>(12, 65507))
+                .AddAttribute("MaxInFlight",
+                              "Packets sent and not yet received or lost at the sink",
+                              UintegerValue(200),
+                              MakeUintegerAccessor(&BacklogUdpClient::m_maxInFlight),
+                              MakeUintegerChecker<uint32_t>(1))
+                .AddAttribute("LossWindow",
+                              "Packets received after a missing one before it is lost, as "
+                              "the PacketWindowSize of the UdpServer",
+                              UintegerValue(32),
+                              MakeUintegerAccessor(&BacklogUdpClient::m_lossWindow),
+                              MakeUintegerChecker<uint32_t>(1))
+                .AddAttribute("StallTimeout",
+                              "Time without any packet at the sink after which the packets "
+                              "in flight are written off",
+                              TimeValue(MilliSeconds(100)),
+                              MakeTimeAccessor(&BacklogUdpClient::m_stallTimeout),
+                              MakeTimeChecker());
+        return tid;
+    }
+
+    /**
+     * @brief Set the destination of the flow.
+     * @param address the UE address
+     * @param port the port of the UdpServer
+     */
+    void SetRemote(Ipv4Address address, uint16_t port)
+    {
+        m_peerAddress = address;
+        m_peerPort = port;
+    }
+
+    /// @brief Set the UdpServer that receives the flow and clocks the source.
+    void SetSink(Ptr<UdpServer> sink)
+    {
+        m_sink = sink;
+    }
+
+    /**
+     * @brief Window that keeps a cell busy for a packet size.
+     *
+     * The peak cell rate is taken as 5.5 bit/s/Hz (64-QAM, rank 1, after overhead).
+     * @param bandwidth cell bandwidth in Hz
+     * @param pathDelay one-way delay from the source to the UE sink
+     * @param queueTarget RLC backlog to keep, as time at the peak rate
+     * @param packetSize UDP payload size in bytes
+     * @return packets in flight covering the path and the backlog
+     */
+    static uint32_t GetBdpWindow(double bandwidth,
+                                 Time pathDelay,
+                                 Time queueTarget,
+                                 uint32_t packetSize)
+    {
+        const double bytes = bandwidth * 5.5 / 8 * (pathDelay + queueTarget).GetSeconds();
+        return std::max<uint32_t>(1, static_cast<uint32_t>(std::ceil(bytes / packetSize)));
+    }
+
+    /// @return packets sent so far
+    uint64_t GetSent() const
+    {
+        return m_sent;
+    }
+
+    /// @return packets written off after a stall
+    uint64_t GetWrittenOff() const
+    {
+        return m_writtenOff;
+    }
+
+  protected:
+    void DoDispose() override
+    {
+        m_socket = nullptr;
+        m_sink = nullptr;
+        Application::DoDispose();
+    }
+
+  private:
+    void StartApplication() override
+    {
+        NS_ABORT_MSG_UNLESS(m_sink, "BacklogUdpClient needs SetSink before it starts");
+        if (!m_socket)
+        {
+            m_socket = Socket::CreateSocket(GetNode(), UdpSocketFactory::GetTypeId());
+            m_socket->Bind();
+            m_socket->Connect(InetSocketAddress(m_peerAddress, m_peerPort));
+        }
+        m_sink->TraceConnectWithoutContext("Rx", MakeCallback(&BacklogUdpClient::SinkRx, this));
+        m_running = true;
+        Fill();
+    }
+
+    void StopApplication() override
+    {
+        m_running = false;
+        m_sink->TraceDisconnectWithoutContext("Rx",
+                                              MakeCallback(&BacklogUdpClient::SinkRx, this));
+        m_stallEvent.Cancel();
+    }
+
+    void Fill()
+    {
+        m_fillPending = false;
+        if (!m_running)
+        {
+            return;
+        }
+        while (m_inFlight.size() < m_maxInFlight)
+        {
+            SeqTsHeader seqTs;
+            seqTs.SetSeq(static_cast<uint32_t>(m_sent));
+            Ptr<Packet> p = Create<Packet>(m_size - seqTs.GetSerializedSize());
+            p->AddHeader(seqTs);
+            if (m_socket->Send(p) < 0)
+            {
+                break;
+            }
+            m_inFlight.insert(static_cast<uint32_t>(m_sent));
+            ++m_sent;
+        }
+        m_stallEvent.Cancel();
+        m_stallEvent = Simulator::Schedule(m_stallTimeout, &BacklogUdpClient::Stall, this);
+    }
+
+    /// Called at the sink node; the refill runs at this node, once per time step
+    void SinkRx(Ptr<const Packet> packet)
+    {
+        SeqTsHeader seqTs;
+        packet->PeekHeader(seqTs);
+        const uint32_t seq = seqTs.GetSeq();
+        // packets written off are no longer in the window and are ignored here
+        m_inFlight.erase(seq);
+        while (!m_inFlight.empty() && *m_inFlight.begin() + m_lossWindow < seq)
+        {
+            m_inFlight.erase(m_inFlight.begin());
+        }
+        if (m_running && !m_fillPending)
+        {
+            m_fillPending = true;
+            Simulator::ScheduleWithContext(GetNode()->GetId(),
+                                           Time(0),
+                                           &BacklogUdpClient::Fill,
+                                           this);
+        }
+    }
+
+    void Stall()
+    {
+        m_writtenOff += m_inFlight.size();
+        m_inFlight.clear();
+        Fill();
+    }
+
+    Ptr<Socket> m_socket;          //!< UDP socket towards the UE
+    Ptr<UdpServer> m_sink;         //!< Sink clocking the source
+    Ipv4Address m_peerAddress;     //!< UE address
+    uint16_t m_peerPort{0};        //!< Sink port
+    uint32_t m_size{1500};         //!< UDP payload size
+    uint32_t m_maxInFlight{200};   //!< Window in packets
+    uint32_t m_lossWindow{32};     //!< Reordering allowed before a packet is lost
+    std::set<uint32_t> m_inFlight; //!< Sequence numbers in the window
+    Time m_stallTimeout;           //!< Write-off timeout
+    uint64_t m_sent{0};            //!< Packets sent, also the next sequence number
+    uint64_t m_writtenOff{0};      //!< Packets given up after stalls
+    bool m_running{false};         //!< Between start and stop
+    bool m_fillPending{false};     //!< A refill is scheduled
+    EventId m_stallEvent;          //!< Pending stall check
+};
+
+} // namespace ns3
+
+#endif // BACKLOG_UDP_CLIENT_H
@@ -0,0 +1,94 @@
+"""! Check that a configuration run in a --batch gives the results of a standalone run.
+
+Runs nr-handover once with a two-line batch file (--first, then --second) and once
+with the --second arguments alone, and compares the KPI columns of row 2 of the
+batch summary with the summary.csv of the standalone run. Global ns-3 state left
+over from the first configuration (attribute defaults, IP addresses handed out,
+automatic random stream numbers) shows up as a difference. Exits with 1 on any
+difference or failed run.
+
+Example:
+    python3 scratch/batch-check.py -p simTime=1.5 --second "--speed=20 --RngRun=3"
+"""
+
+import argparse
+import csv
+import os
+import sys
+
+import handover_jobs
+
+DEFAULT_COLUMNS = (
+    "events,rxPackets,lostPackets,rxBitrateKbps,meanDelayMs,packetLossPercent,"
+    "handovers,meanInterruptionMs,pingPongs,radioLinkFailures"
+)
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--output", default="batch-check", help="directory of the runs")
+    parser.add_argument("--ns3-dir", default=".", help="root of the ns-3 tree")
+    parser.add_argument("--binary", help="built nr-handover program, instead of ./ns3 run")
+    parser.add_argument(
+        "-p",
+        "--param",
+        action="append",
+        default=["simTime=1.5"],
+        metavar="KEY=VALUE",
+        help="argument of both runs",
+    )
+    parser.add_argument("--first", default="--speed=10 --RngRun=1", help="batch line 1")
+    parser.add_argument("--second", default="--speed=20 --RngRun=2", help="batch line 2")
+    parser.add_argument("--columns", default=DEFAULT_COLUMNS, help="summary columns compared")
+    args = parser.parse_args(argv[1:])
+
+    params = dict(p.split("=", 1) for p in args.param)
+    os.makedirs(args.output, exist_ok=True)
+    batch_file = os.path.abspath(os.path.join(args.output, "configs.txt"))
+    with open(batch_file, "w", encoding="utf-8") as f:
+        f.write("%s\n%s\n" % (args.first, args.second))
+
+    batch = handover_jobs.Job("batch", "nr-handover", params, args.output)
+    batch.params["batch"] = batch_file
+    alone = handover_jobs.Job("alone", "nr-handover", params, args.output)
+    for word in args.second.split():
+        key, _, value = word.lstrip("-").partition("=")
+        alone.params[key] = value or "true"
+    table = os.path.splitext(batch_file)[0] + "-summary.csv"
+    if os.path.exists(table):
+        os.remove(table)
+    for job in (batch, alone):
+        # only the exit code counts: the batch run writes a table, not a summary.csv
+        result = handover_jobs.run_job(job, args.ns3_dir, args.binary)
+        if result["returncode"] != 0:
+            print(
+                "%s run failed with exit code %d, see %s/stdout.log"
+                % (job.name, result["returncode"], job.outdir)
+            )
+            return 1
+
+    rows = []
+    if os.path.exists(table):
+        with open(table, newline="", encoding="utf-8") as f:
+            rows = list(csv.DictReader(f))
+    standalone = handover_jobs.read_summary(os.path.join(alone.outdir, "summary.csv"))
+    if len(rows) != 2 or standalone is None:
+        print(
+            "Missing results: %d batch rows in %s, standalone summary %s"
+            % (len(rows), table, "found" if standalone else "missing")
+        )
+        return 1
+    differences = 0
+    for column in args.columns.split(","):
+        if column not in standalone and column not in rows[1]:
+            continue
+        batched, single = rows[1].get(column), standalone.get(column)
+        if batched != single:
+            differences += 1
+            print("DIFFERENT %s: batch row 2 %s, standalone %s" % (column, batched, single))
+    print("%d of the compared columns differ" % differences)
+    return 1 if differences else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
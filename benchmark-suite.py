@@ -0,0 +1,216 @@
+"""! Performance benchmark suite of the handover scenarios.
+
+Runs a fixed matrix of configurations (scenario x UEs x gNBs x UDP interval) of
+nr-handover or ex005 with fixed seeds and records, per configuration, the wall
+time, events per second, simulated seconds per wall second and peak RSS into a
+CSV named after a version label. Given a baseline CSV of an earlier version, it
+reports every metric that got worse by more than the threshold and exits with 1;
+a baseline of another suite version or without a common configuration exits with 2.
+
+gNB counts map to layouts: 2 is the two-gNB layout, 7 one ring of omni sites and
+21 one ring of 3-sector sites (--hexRings/--sectors).
+
+Example:
+    python3 scratch/benchmark-suite.py --label nr-4.1 --binary build/scratch/nr-handover
+    python3 scratch/benchmark-suite.py --label nr-4.2 --baseline bench/benchmark-nr-4.1.csv
+"""
+
+import argparse
+import csv
+import datetime
+import os
+import platform
+import subprocess
+import sys
+
+import handover_jobs
+
+## Bump when the matrix or the recorded metrics change; baselines of another
+## suite version are not comparable
+SUITE_VERSION = 1
+
+SCENARIOS = ["RMa", "UMa", "UMi-StreetCanyon", "InH-OfficeMixed"]
+UES = [1, 10, 100]
+GNBS = {
+    2: {"hexRings": 0},
+    7: {"hexRings": 1, "sectors": 1},
+    21: {"hexRings": 1, "sectors": 3},
+}
+INTERVALS = [1, 100, 1000]
+
+## Reduced matrix for a quick check
+QUICK = {"scenario": ["UMa"], "ues": [1, 10], "gnbs": [2, 7], "udpInterval": [100]}
+
+## metric -> True if higher is better
+METRICS = {
+    "wallSeconds": False,
+    "peakRssKb": False,
+    "eventsPerSecond": True,
+    "simSecondsPerWallSecond": True,
+}
+
+KEY = ["program", "scenario", "ues", "gnbs", "udpInterval"]
+
+
+def matrix(quick):
+    """! Configurations of the suite, as dicts of the KEY columns except program."""
+    axes = QUICK if quick else {
+        "scenario": SCENARIOS,
+        "ues": UES,
+        "gnbs": list(GNBS),
+        "udpInterval": INTERVALS,
+    }
+    return handover_jobs.expand_grid(axes)
+
+
+def ns3_version(ns3_dir):
+    """! git describe of the ns-3 tree, or 'unknown'."""
+    try:
+        return subprocess.run(
+            ["git", "-C", ns3_dir, "describe", "--always", "--dirty"],
+            capture_output=True,
+            text=True,
+            check=True,
+        ).stdout.strip()
+    except (OSError, subprocess.CalledProcessError):
+        return "unknown"
+
+
+def metrics(result, sim_time):
+    """! Benchmark metrics of one run_job result, or None if the run failed."""
+    if result["status"] != "ok":
+        return None
+    run_wall = float(result.get("runWallSeconds", result["wallSeconds"]))
+    events = float(result.get("events", 0))
+    return {
+        "wallSeconds": float(result["wallSeconds"]),
+        "peakRssKb": int(result["peakRssKb"]),
+        "eventsPerSecond": events / run_wall if run_wall > 0 else 0.0,
+        "simSecondsPerWallSecond": sim_time / run_wall if run_wall > 0 else 0.0,
+    }
+
+
+def compare(rows, baseline_path, threshold):
+    """! Print the metrics worse than the baseline by more than threshold.
+    @return number of regressions, None if the baseline cannot be compared with (other
+        suite version, no common configuration)
+    """
+    with open(baseline_path, newline="", encoding="utf-8") as f:
+        baseline = {tuple(r[k] for k in KEY): r for r in csv.DictReader(f)}
+    regressions = 0
+    compared = 0
+    for row in rows:
+        base = baseline.get(tuple(str(row[k]) for k in KEY))
+        if base is None or row["status"] != "ok" or base.get("status") != "ok":
+            continue
+        if base.get("suiteVersion") != str(SUITE_VERSION):
+            print(
+                "Baseline has suite version %s, expected %d"
+                % (base.get("suiteVersion"), SUITE_VERSION)
+            )
+            return None
+        compared += 1
+        for metric, higher_is_better in METRICS.items():
+            old = float(base[metric])
+            new = float(row[metric])
+            if old <= 0:
+                continue
+            change = (new - old) / old
+            worse = -change if higher_is_better else change
+            if worse > threshold:
+                regressions += 1
+                print(
+                    "REGRESSION %s: %s %.4g -> %.4g (%+.1f%%)"
+                    % (" ".join(str(row[k]) for k in KEY), metric, old, new, 100 * change)
+                )
+    print(
+        "Compared %d configurations with %s: %d regressions"
+        % (compared, baseline_path, regressions)
+    )
+    return regressions if compared else None
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--program", default="nr-handover", help="scratch program to run")
+    parser.add_argument("--output", default="bench", help="directory of the runs and the CSV")
+    parser.add_argument("--label", help="version label of the CSV (default: ns-3 git describe)")
+    parser.add_argument("--quick", action="store_true", help="run the reduced matrix")
+    parser.add_argument("--sim-time", type=float, default=2.0, help="simulated seconds per run")
+    parser.add_argument("--repeat", type=int, default=1, help="runs per configuration, best kept")
+    parser.add_argument("--baseline", help="CSV of an earlier version to compare with")
+    parser.add_argument(
+        "--threshold", type=float, default=0.10, help="relative change reported as regression"
+    )
+    parser.add_argument("--jobs", type=int, default=1, help="parallel runs (1 for stable timings)")
+    parser.add_argument("--ns3-dir", default=".", help="root of the ns-3 tree")
+    parser.add_argument("--binary", help="built program to run instead of ./ns3 run")
+    args = parser.parse_args(argv[1:])
+
+    version = ns3_version(args.ns3_dir)
+    label = args.label or version
+    jobs = []
+    configs = {}
+    for i, config in enumerate(matrix(args.quick)):
+        params = {
+            "scenario": config["scenario"],
+            "numUes": config["ues"],
+            "udpInterval": config["udpInterval"],
+            "simTime": args.sim_time,
+            "RngRun": 1,
+            "traceMode": "off",
+            "logging": 0,
+        }
+        params.update(GNBS[config["gnbs"]])
+        for r in range(args.repeat):
+            name = "%s/config%03d-rep%d" % (label, i, r)
+            jobs.append(handover_jobs.Job(name, args.program, params, args.output))
+            configs[name] = config
+
+    print("%d runs of %s (%s) on %d workers" % (len(jobs), args.program, label, args.jobs))
+    best = {}
+    for result in handover_jobs.run_jobs(jobs, args.jobs, args.ns3_dir, args.binary):
+        config = configs[result["job"]]
+        key = tuple(config[k] for k in KEY[1:])
+        values = metrics(result, args.sim_time)
+        print("%s %s (%s s)" % (result["job"], result["status"], result["wallSeconds"]))
+        sys.stdout.flush()
+        if values is None:
+            best.setdefault(key, None)
+        elif best.get(key) is None or values["wallSeconds"] < best[key]["wallSeconds"]:
+            best[key] = values
+
+    stamp = datetime.datetime.now().isoformat(timespec="seconds")
+    rows = []
+    for config in matrix(args.quick):
+        key = tuple(config[k] for k in KEY[1:])
+        row = {
+            "suiteVersion": SUITE_VERSION,
+            "label": label,
+            "ns3Version": version,
+            "host": platform.node(),
+            "date": stamp,
+            "program": args.program,
+        }
+        row.update(config)
+        values = best.get(key)
+        row["status"] = "ok" if values else "failed"
+        for metric in METRICS:
+            row[metric] = ("%.6g" % values[metric]) if values else ""
+        rows.append(row)
+
+    os.makedirs(args.output, exist_ok=True)
+    table = os.path.join(args.output, "benchmark-%s.csv" % label.replace("/", "_"))
+    handover_jobs.write_table(rows, table)
+    print("Wrote %s" % table)
+
+    failed = sum(1 for r in rows if r["status"] != "ok")
+    regressions = compare(rows, args.baseline, args.threshold) if args.baseline else 0
+    if regressions is None:
+        # a baseline that cannot be compared must not let a CI job pass
+        return 2
+    return 1 if failed or regressions else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
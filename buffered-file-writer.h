@@ -0,0 +1,141 @@
+#ifndef BUFFERED_FILE_WRITER_H
+#define BUFFERED_FILE_WRITER_H
+
+/**
+ * @file buffered-file-writer.h
+ * @brief Block-buffered output file shared by the recorders of the handover scenarios.
+ *
+ * Data is accumulated in memory and handed to the operating system in large blocks,
+ * so a recorder that produces one small record every few milliseconds of simulated
+ * time does not pay an open/write/flush/close cycle per record. The file is only
+ * created on the first flush, which means an idle writer never touches the disk.
+ *
+ * HoldFlushes keeps the data of every writer in memory, e.g. during the warm-up
+ * shared by forked replicas, so each replica can still set its own paths and writes
+ * the warm-up records into its own files.
+ */
+
+#include "ns3/core-module.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+class BufferedFileWriter
+{
+  public:
+    /**
+     * @brief Create a writer that is not yet bound to any file.
+     * @param blockSize number of bytes kept in memory before they are written out
+     */
+    explicit BufferedFileWriter(std::size_t blockSize = 1 << 20)
+        : m_blockSize(blockSize)
+    {
+        m_buffer.reserve(m_blockSize);
+    }
+
+    ~BufferedFileWriter()
+    {
+        Close();
+    }
+
+    BufferedFileWriter(const BufferedFileWriter&) = delete;
+    BufferedFileWriter& operator=(const BufferedFileWriter&) = delete;
+
+    /**
+     * @brief Set the path of the output file.
+     *
+     * The path can be changed as long as nothing was flushed yet.
+     * @param path the file to create (truncated if it already exists)
+     */
+    void SetPath(const std::string& path)
+    {
+        NS_ABORT_MSG_IF(m_file, "Cannot change the path of " << m_path << " after it was opened");
+        m_path = path;
+    }
+
+    /**
+     * @brief Hold back or release the block flushes of all writers.
+     *
+     * While held, Write only buffers, so no file is created and every path can still
+     * be changed. Close still writes the file.
+     * @param hold true to hold, false to flush again at the block size
+     */
+    static void HoldFlushes(bool hold)
+    {
+        s_hold = hold;
+    }
+
+    /// @return the path of the output file
+    const std::string& GetPath() const
+    {
+        return m_path;
+    }
+
+    /**
+     * @brief Append raw bytes, flushing the buffer whenever it reaches the block size.
+     * @param data the bytes to append
+     * @param size number of bytes
+     */
+    void Write(const void* data, std::size_t size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        m_buffer.insert(m_buffer.end(), bytes, bytes + size);
+        if (m_buffer.size() >= m_blockSize && !s_hold)
+        {
+            Flush();
+        }
+    }
+
+    /// @brief Append a string without its terminating null character.
+    void Write(const std::string& text)
+    {
+        Write(text.data(), text.size());
+    }
+
+    /// @brief Write everything buffered so far to the file, creating it if needed.
+    void Flush()
+    {
+        if (m_buffer.empty())
+        {
+            return;
+        }
+        if (!m_file)
+        {
+            NS_ABORT_MSG_IF(m_path.empty(), "BufferedFileWriter flushed without a path");
+            m_file = std::fopen(m_path.c_str(), "wb");
+            NS_ABORT_MSG_UNLESS(m_file, "Unable to open " << m_path);
+            // we already write in large blocks, stdio buffering would only add a copy
+            std::setvbuf(m_file, nullptr, _IONBF, 0);
+        }
+        std::size_t written = std::fwrite(m_buffer.data(), 1, m_buffer.size(), m_file);
+        NS_ABORT_MSG_IF(written != m_buffer.size(), "Short write on " << m_path);
+        m_buffer.clear();
+    }
+
+    /// @brief Flush the remaining data and close the file. Safe to call more than once.
+    void Close()
+    {
+        Flush();
+        if (m_file)
+        {
+            std::fclose(m_file);
+            m_file = nullptr;
+        }
+    }
+
+  private:
+    std::string m_path;         //!< Output file
+    std::FILE* m_file{nullptr}; //!< Open handle, created on the first flush
+    std::size_t m_blockSize;    //!< Flush threshold in bytes
+    std::vector<char> m_buffer; //!< Pending bytes
+
+    static inline bool s_hold{false}; //!< Block flushes held back by HoldFlushes
+};
+
+} // namespace ns3
+
+#endif // BUFFERED_FILE_WRITER_H
@@ -0,0 +1,167 @@
+"""! Accuracy/speed benchmark of the channel update policies.
+
+Runs a scenario once per channel update period (and per RNG run) and compares
+each run with the reference period of the same RNG run: wall time, and the
+deviation of the per-UE RSRP and SINR samples in measurements.txt (same time and
+node). Period 0 is the ns-3 default (channel never regenerated); the reference
+defaults to the shortest period, the most often refreshed channel.
+
+Different periods draw different fading realizations, so part of the deviation
+is the fading itself; compare the periods with each other rather than with 0.
+
+Example:
+    python3 scratch/channel-update-benchmark.py --periods 0,1,5,20,100 --runs 1:3 \\
+        -p scenario=UMa -p speed=15
+"""
+
+import argparse
+import csv
+import math
+import os
+import sys
+
+import handover_jobs
+
+
+def read_measurements(path):
+    """! measurements.txt -> {(time ns, nodeId): (cellId, rsrp, sinr)}."""
+    samples = {}
+    with open(path, newline="", encoding="utf-8") as f:
+        reader = csv.DictReader(f, delimiter="\t")
+        for row in reader:
+            key = (round(float(row["time"]) * 1e9), int(row["nodeId"]))
+            samples[key] = (int(row["cellId"]), float(row["RSRP"]), float(row["SINR"]))
+    return samples
+
+
+def percentile(values, q):
+    """! Nearest-rank percentile of a list, NaN when empty."""
+    if not values:
+        return math.nan
+    values = sorted(values)
+    return values[min(len(values) - 1, int(math.ceil(q * len(values))) - 1)]
+
+
+def deviation(samples, reference):
+    """! Compare two measurement sets on their common (time, node) keys.
+    @return dict of mean/p95 absolute RSRP and SINR deviation in dB and the
+    fraction of samples with a different serving cell
+    """
+    rsrp = []
+    sinr = []
+    cells = 0
+    common = 0
+    for key, (cell, r, s) in samples.items():
+        ref = reference.get(key)
+        if ref is None:
+            continue
+        common += 1
+        cells += cell != ref[0]
+        rsrp.append(abs(r - ref[1]))
+        if not math.isnan(s) and not math.isnan(ref[2]):
+            sinr.append(abs(s - ref[2]))
+    mean = lambda v: sum(v) / len(v) if v else math.nan
+    return {
+        "samples": common,
+        "rsrpMeanAbsDb": "%.4f" % mean(rsrp),
+        "rsrpP95AbsDb": "%.4f" % percentile(rsrp, 0.95),
+        "sinrMeanAbsDb": "%.4f" % mean(sinr),
+        "sinrP95AbsDb": "%.4f" % percentile(sinr, 0.95),
+        "cellMismatch": "%.4f" % (cells / common if common else math.nan),
+    }
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--program", default="nr-handover", help="scratch program to run")
+    parser.add_argument("--output", default="channel-benchmark", help="root of the job outputs")
+    parser.add_argument("--periods", default="0,1,5,20,100", help="update periods in ms")
+    parser.add_argument("--reference", type=float, help="reference period (default: shortest > 0)")
+    parser.add_argument("--runs", default="1", help="RngRun values, 'a,b' or 'start:stop'")
+    parser.add_argument(
+        "-p",
+        "--param",
+        action="append",
+        default=[],
+        metavar="NAME=VALUE",
+        help="fixed command line value of every run",
+    )
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="parallel processes")
+    parser.add_argument("--ns3-dir", default=".", help="root of the ns-3 tree")
+    parser.add_argument("--binary", help="built program to run instead of ./ns3 run")
+    args = parser.parse_args(argv[1:])
+
+    periods = [float(p) for p in handover_jobs.parse_values(args.periods)]
+    reference = args.reference
+    if reference is None:
+        reference = min(p for p in periods if p > 0)
+    if reference not in periods:
+        periods.append(reference)
+
+    fixed = dict(item.partition("=")[::2] for item in args.param)
+    fixed.update(measurementFormat="text", traceMode="off", flowSampleInterval=0)
+    jobs = []
+    for run in handover_jobs.parse_values(args.runs):
+        for period in periods:
+            params = dict(fixed)
+            if period > 0:
+                params.update(channelUpdate="period", channelUpdatePeriod="%g" % period)
+            else:
+                params.update(channelUpdate="static")
+            params["RngRun"] = run
+            name = "period%g-run%s" % (period, run)
+            jobs.append(handover_jobs.Job(name, args.program, params, args.output))
+
+    print("%d runs on %d workers, reference period %g ms" % (len(jobs), args.jobs, reference))
+    results = {}
+    for result in handover_jobs.run_jobs(jobs, args.jobs, args.ns3_dir, args.binary):
+        results[result["job"]] = result
+        print("%s %s (%s s)" % (result["job"], result["status"], result["wallSeconds"]))
+        sys.stdout.flush()
+
+    rows = []
+    for job in jobs:
+        result = results[job.name]
+        period = float(job.params.get("channelUpdatePeriod", 0))
+        run = job.params["RngRun"]
+        row = {
+            "periodMs": "%g" % period,
+            "RngRun": run,
+            "status": result["status"],
+            "wallSeconds": result["wallSeconds"],
+            "handovers": result.get("handovers", ""),
+        }
+        ref_job = "period%g-run%s" % (reference, run)
+        measurements = os.path.join(job.outdir, "measurements.txt")
+        ref_measurements = os.path.join(args.output, ref_job, "measurements.txt")
+        if result["status"] == "ok" and results[ref_job]["status"] == "ok":
+            row.update(
+                deviation(read_measurements(measurements), read_measurements(ref_measurements))
+            )
+        rows.append(row)
+
+    table = os.path.join(args.output, "channel-update-benchmark.csv")
+    handover_jobs.write_table(rows, table)
+
+    # mean over the runs, one line per period
+    print(
+        "%10s %12s %14s %14s %13s"
+        % ("period ms", "wall s", "RSRP dev dB", "SINR dev dB", "cell mismatch")
+    )
+    for period in sorted(periods):
+        group = [r for r in rows if float(r["periodMs"]) == period and "samples" in r]
+        if not group:
+            print("%10g %12s" % (period, "failed"))
+            continue
+        mean = lambda k: sum(float(r[k]) for r in group) / len(group)
+        print(
+            "%10g %12.2f %14.3f %14.3f %13.3f"
+            % (period, mean("wallSeconds"), mean("rsrpMeanAbsDb"), mean("sinrMeanAbsDb"),
+               mean("cellMismatch"))
+        )
+    print("Wrote %s" % table)
+    return 0 if all(r["status"] == "ok" for r in rows) else 1
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
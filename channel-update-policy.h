@@ -0,0 +1,67 @@
+#ifndef CHANNEL_UPDATE_POLICY_H
+#define CHANNEL_UPDATE_POLICY_H
+
+/**
+ * @file channel-update-policy.h
+ * @brief How often the 3GPP channel matrices and channel conditions are regenerated.
+ *
+ * ThreeGppChannelModel keeps the channel matrix of a link (and its long-term
+ * beamforming components) until UpdatePeriod has passed, or until the channel
+ * condition of the link changes. ThreeGppChannelConditionModel keeps the LOS/NLOS state
+ * for its own UpdatePeriod. The ns-3 default of 0 never regenerates either, so a moving
+ * UE keeps the fading of its first position. The policies:
+ *
+ * - "static": the ns-3 default, no regeneration
+ * - "period": both are regenerated every periodMs
+ * - "distance": every time a UE at the configured speed has moved distance meters
+ *
+ * Must be applied before the channel helper creates the models.
+ */
+
+#include "ns3/core-module.h"
+
+#include <string>
+
+namespace ns3
+{
+
+/**
+ * @brief Set the UpdatePeriod defaults of the 3GPP channel and channel condition models.
+ * @param policy "static", "period" or "distance"
+ * @param periodMs update period of the "period" policy, in ms
+ * @param distance distance moved between updates of the "distance" policy, in m
+ * @param speed UE speed in m/s, 0 for static UEs
+ * @return the update period applied, 0 for never
+ */
+inline Time
+ConfigureChannelUpdates(const std::string& policy, double periodMs, double distance, double speed)
+{
+    Time period;
+    if (policy == "period")
+    {
+        NS_ABORT_MSG_UNLESS(periodMs > 0, "channelUpdatePeriod must be positive");
+        // MilliSeconds() takes an integer: sub-ms periods would become 0, i.e. never
+        period = Seconds(periodMs * 1e-3);
+        NS_ABORT_MSG_IF(period.IsZero(), "channelUpdatePeriod " << periodMs << " ms rounds to 0");
+    }
+    else if (policy == "distance")
+    {
+        NS_ABORT_MSG_UNLESS(distance > 0, "channelUpdateDistance must be positive");
+        // static UEs never move the distance, keep the channel
+        period = speed > 0 ? Seconds(distance / speed) : Time(0);
+        NS_ABORT_MSG_IF(speed > 0 && period.IsZero(),
+                        "channelUpdateDistance " << distance << " m rounds to a 0 period");
+    }
+    else
+    {
+        NS_ABORT_MSG_UNLESS(policy == "static",
+                            "channelUpdate must be static, period or distance");
+    }
+    Config::SetDefault("ns3::ThreeGppChannelModel::UpdatePeriod", TimeValue(period));
+    Config::SetDefault("ns3::ThreeGppChannelConditionModel::UpdatePeriod", TimeValue(period));
+    return period;
+}
+
+} // namespace ns3
+
+#endif // CHANNEL_UPDATE_POLICY_H
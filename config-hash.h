@@ -0,0 +1,217 @@
+#ifndef CONFIG_HASH_H
+#define CONFIG_HASH_H
+
+/**
+ * @file config-hash.h
+ * @brief Canonical text and hash of the effective configuration of a run.
+ *
+ * Two runs with the same configuration give the same results, however the
+ * configuration was spelled on the command line. The canonical text has one sorted
+ * "key=value" line per setting:
+ *
+ * - every program option registered through HashedCommandLine, at its parsed value,
+ *   printed from the variable itself so that "15.0" and "15", "1" and "true" are equal
+ * - the size and modification time of the input files added with AddFile, so that a
+ *   trajectory rewritten under the same name is another configuration
+ * - every attribute default that differs from the ns-3 one, whether it was set by
+ *   --ns3::Type::Attribute or Config::SetDefault
+ * - the global values that change the model, RngSeed and RngRun among them
+ *
+ * and the hash is its 64-bit FNV-1a. Options that only change where and how the output
+ * is written (output directory, logging, profiling) can be left out with Ignore.
+ * The hash does not cover the code itself: a store of results is only valid for the
+ * build that wrote it.
+ */
+
+#include "ns3/core-module.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <initializer_list>
+#include <map>
+#include <set>
+#include <sstream>
+#include <string>
+#include <sys/stat.h>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+/// CommandLine that remembers its program options, to hash their parsed values
+class HashedCommandLine : public CommandLine
+{
+  public:
+    using CommandLine::AddValue;
+    using CommandLine::CommandLine;
+
+    /**
+     * @brief Register a program option, as CommandLine::AddValue does.
+     * @param name option name
+     * @param help help text
+     * @param value variable set by Parse, must outlive the ConfigHash::AddCommandLine call
+     */
+    template <typename T>
+    void AddValue(const std::string& name, const std::string& help, T& value)
+    {
+        CommandLine::AddValue(name, help, value);
+        m_options.emplace_back(name, [&value]() { return ToText(value); });
+    }
+
+    /// @return name and current value of every program option, in registration order
+    std::vector<std::pair<std::string, std::string>> GetOptions() const
+    {
+        std::vector<std::pair<std::string, std::string>> options;
+        for (const auto& [name, text] : m_options)
+        {
+            options.emplace_back(name, text());
+        }
+        return options;
+    }
+
+  private:
+    /// Same text for the same number or boolean, whatever was typed
+    template <typename T>
+    static std::string ToText(const T& value)
+    {
+        if constexpr (std::is_same_v<T, bool>)
+        {
+            return value ? "true" : "false";
+        }
+        else if constexpr (std::is_floating_point_v<T>)
+        {
+            char text[32];
+            std::snprintf(text, sizeof(text), "%.17g", static_cast<double>(value));
+            return text;
+        }
+        else if constexpr (std::is_integral_v<T>)
+        {
+            return std::to_string(value);
+        }
+        else
+        {
+            std::ostringstream text;
+            text << value;
+            return text.str();
+        }
+    }
+
+    /// Option name and printer of its variable
+    std::vector<std::pair<std::string, std::function<std::string()>>> m_options;
+};
+
+class ConfigHash
+{
+  public:
+    /// @brief Leave these program options out of the hash.
+    void Ignore(std::initializer_list<std::string> options)
+    {
+        m_ignored.insert(options.begin(), options.end());
+    }
+
+    /**
+     * @brief Add the program options at their parsed values; call it after Parse.
+     * @param cmd the parsed command line
+     */
+    void AddCommandLine(const HashedCommandLine& cmd)
+    {
+        for (const auto& [name, value] : cmd.GetOptions())
+        {
+            if (!m_ignored.count(name))
+            {
+                Add("option:" + name, value);
+            }
+        }
+    }
+
+    /**
+     * @brief Add an input file by its path, size and modification time.
+     *
+     * Reading the content would cost as much as a pass over a large trajectory; a file
+     * copied elsewhere only hashes differently, it never matches stale results.
+     * @param key setting name
+     * @param path input file, nothing is added for an empty path
+     */
+    void AddFile(const std::string& key, const std::string& path)
+    {
+        if (path.empty())
+        {
+            return;
+        }
+        struct stat st;
+        NS_ABORT_MSG_IF(stat(path.c_str(), &st) != 0, "Unable to read " << path);
+        Add("file:" + key,
+            std::to_string(st.st_size) + " bytes, modified " +
+                std::to_string(st.st_mtim.tv_sec) + "." + std::to_string(st.st_mtim.tv_nsec));
+    }
+
+    /// @brief Add the attribute defaults changed from ns-3's and the model global values.
+    void AddAttributeDefaults()
+    {
+        for (uint16_t i = 0; i < TypeId::GetRegisteredN(); ++i)
+        {
+            TypeId tid = TypeId::GetRegistered(i);
+            for (std::size_t a = 0; a < tid.GetAttributeN(); ++a)
+            {
+                TypeId::AttributeInformation info = tid.GetAttribute(a);
+                const std::string value = info.initialValue->SerializeToString(info.checker);
+                if (value != info.originalInitialValue->SerializeToString(info.checker))
+                {
+                    Add("attribute:" + tid.GetName() + "::" + info.name, value);
+                }
+            }
+        }
+        for (auto it = GlobalValue::Begin(); it != GlobalValue::End(); ++it)
+        {
+            // the scheduler and the simulator implementation do not change the results
+            const std::string name = (*it)->GetName();
+            if (name != "SchedulerType" && name != "SimulatorImplementationType")
+            {
+                StringValue value;
+                (*it)->GetValue(value);
+                Add("global:" + name, value.Get());
+            }
+        }
+    }
+
+    /// @brief Add a setting that is neither an option nor an attribute.
+    void Add(const std::string& key, const std::string& value)
+    {
+        m_settings[key] = value;
+    }
+
+    /// @return the canonical text, one sorted "key=value" line per setting
+    std::string GetText() const
+    {
+        std::string text;
+        for (const auto& [key, value] : m_settings)
+        {
+            text += key + "=" + value + "\n";
+        }
+        return text;
+    }
+
+    /// @return FNV-1a of the canonical text, as 16 hexadecimal digits
+    std::string GetHash() const
+    {
+        uint64_t hash = 14695981039346656037ULL;
+        for (unsigned char c : GetText())
+        {
+            hash = (hash ^ c) * 1099511628211ULL;
+        }
+        char hex[17];
+        std::snprintf(hex, sizeof(hex), "%016llx", static_cast<unsigned long long>(hash));
+        return hex;
+    }
+
+  private:
+    std::set<std::string> m_ignored;                //!< Options left out
+    std::map<std::string, std::string> m_settings; //!< Canonical settings, sorted
+};
+
+} // namespace ns3
+
+#endif // CONFIG_HASH_H
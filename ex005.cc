@@ -30,7 +30,32 @@
 #include "ns3/nr-module.h"
 #include "ns3/nr-point-to-point-epc-helper.h"
 #include "ns3/point-to-point-helper.h"
-
+#include "backlog-udp-client.h"
+#include "channel-update-policy.h"
+#include "config-hash.h"
+#include "flow-sampler.h"
+#include "flow-summary-exporter.h"
+#include "handover-event-log.h"
+#include "handover-kpi.h"
+#include "handover-options.h"
+#include "instrumented-scheduler.h"
+#include "kpi-convergence.h"
+#include "log-ring-sink.h"
+#include "hex-topology.h"
+#include "nr-trace-output.h"
+#include "replica-fork.h"
+#include "results-store.h"
+#include "rsrp-prescreen.h"
+#include "run-summary.h"
+#include "scenario-table.h"
+#include "spatial-attachment.h"
+#include "telemetry-sampler.h"
+#include "trajectory-mobility.h"
+
+#include <chrono>
+#include <cstdlib>
+#include <sstream>
+#include <fstream>
 #include <filesystem> // Quero mover os arquivos de trace depois de gerados
 namespace fs = std::filesystem; // apelido pra digitar menos
 
@@ -46,36 +71,69 @@ main(int argc, char* argv[])
     //desativar rrc ideal, se não desabilita handover
     //Config::SetDefault("ns3::LteHelper::UseIdealRrc", BooleanValue(false));
 
-    std::string scenario = "UMa"; // scenario
-    double frequency = 28e9;      // central frequency
-    double bandwidth = 100e6;     // bandwidth
-    double mobility = true;      // whether to enable mobility
-    double simTime = 5;           // in second
-    double speed = 20;             // in m/s for walking UT.
-    bool logging = true; // whether to enable logging from the simulation, another option is by
-                         // exporting the NS_LOG environment variable
+    HandoverOptions options;
+    options.simTime = 5;
+    options.speed = 20;
+    options.outputDir = "scratch/results/ex005/"; // all files written by this run
+    options.warmup = 1.4;
+    options.handoverAlgorithm = "ns3::NrA3RsrpHandoverAlgorithm";
+    options.hysteresis = 0.5;
+    options.timeToTrigger = 10;
+    options.udpInterval = 100;
     double hBS;          // base station antenna height in meters
     double hUT;          // user antenna height in meters
-    double txPower = 40; // txPower
-
-    //std::string tr_name("/home/christhian/5g/ns-3-dev/scratch/results/ex005");
-    std::string tr_name("CAMINHO PARA RESULTADOS");
-
-    CommandLine cmd(__FILE__);
-    cmd.AddValue("scenario",
-                 "The scenario for the simulation. Choose among 'RMa', 'UMa', 'UMi', "
-                 "'InH-OfficeMixed', 'InH-OfficeOpen'.",
-                 scenario);
-    cmd.AddValue("frequency", "The central carrier frequency in Hz.", frequency);
-    cmd.AddValue("mobility",
-                 "If set to 1 UEs will be mobile, when set to 0 UE will be static. By default, "
-                 "they are mobile.",
-                 mobility);
-    cmd.AddValue("logging", "If set to 0, log components will be disabled.", logging);
+
+    HashedCommandLine cmd(__FILE__);
+    options.AddTo(cmd);
     cmd.Parse(argc, argv);
 
+    fs::create_directories(options.outputDir);
+
+    // hash of the effective configuration; one already in the results store is not run
+    RunSummary summary;
+    const std::string hash = options.Hash(cmd, "ex005");
+    if (options.FindCached(hash, summary))
+    {
+        return EXIT_SUCCESS;
+    }
+    if (options.profile)
+    {
+        ProfilingMapScheduler::Install();
+    }
+    std::string tr_name(options.outputDir + "/ex005");
+
+    // log output: text on stderr, or binary entries in outputDir/log-ring.bin
+    NS_ABORT_MSG_UNLESS(options.logSink == "stderr" || options.logSink == "ring",
+                        "logSink must be stderr or ring");
+    LogRingSink logRing;
+    if (options.logging && options.logSink == "ring")
+    {
+        logRing.Open(options.outputDir + "/log-ring.bin", options.logRingEntries);
+        std::istringstream components(options.logComponents);
+        for (std::string c; std::getline(components, c, ',');)
+        {
+            logRing.AddComponentFilter(c);
+        }
+        std::istringstream nodes(options.logNodes);
+        for (std::string n; std::getline(nodes, n, ',');)
+        {
+            logRing.AddNodeFilter(std::stoul(n));
+        }
+        logRing.Install();
+    }
+    auto enableLog = [&options, &logRing](const char* component, LogLevel level) {
+        if (options.logSink == "ring")
+        {
+            logRing.Enable(component, level);
+        }
+        else
+        {
+            LogComponentEnable(component, level);
+        }
+    };
+
     // enable logging
-    if (logging)
+    if (options.logging)
     {
 
         /**
@@ -88,95 +146,141 @@ main(int argc, char* argv[])
         //LogComponentEnable("NrHandoverAlgorithmA3", LOG_LEVEL_INFO);
         //LogComponentEnable("NrGnbRrc", LOG_LEVEL_INFO);
 
-        LogComponentEnable("LteUeRrc", LOG_LEVEL_ALL);
-        LogComponentEnable("LteEnbRrc", LOG_LEVEL_ALL);  
-        LogComponentEnable("NrA3RsrpHandoverAlgorithm", LOG_LEVEL_ALL);
-        LogComponentEnable("NrUePhy", LOG_LEVEL_INFO);
-        LogComponentEnable("NrGnbPhy", LOG_LEVEL_INFO);
-        LogComponentEnable("UdpClient", LOG_LEVEL_INFO);
+        enableLog("LteUeRrc", LOG_LEVEL_ALL);
+        enableLog("LteEnbRrc", LOG_LEVEL_ALL);  
+        enableLog("NrA3RsrpHandoverAlgorithm", LOG_LEVEL_ALL);
+        enableLog("NrUePhy", LOG_LEVEL_INFO);
+        enableLog("NrGnbPhy", LOG_LEVEL_INFO);
+        enableLog("UdpClient", LOG_LEVEL_INFO);
     }
 
     /*
      * Default values for the simulation. We are progressively removing all
      * the instances of SetDefault, but we need it for legacy code (LTE)
      */
-    Config::SetDefault("ns3::NrRlcUm::MaxTxBufferSize", UintegerValue(999999999));
-
-    // set mobile device and base station antenna heights in meters, according to the chosen
-    // scenario
-    if (scenario == "RMa")
-    {
-        hBS = 35;
-        hUT = 1.8;
-    }
-    else if (scenario == "UMa")
+    // the backlog source never has more than backlogPackets queued, leave room for two windows
+    NS_ABORT_MSG_UNLESS(options.trafficMode == "udp" || options.trafficMode == "backlog",
+                        "trafficMode must be udp or backlog");
+    if (options.backlogPackets == 0)
     {
-        hBS = 25;
-        hUT = 1.5;
+        // remote host link (10 ms) plus about 5 ms of EPC, RLC and scheduling
+        options.backlogPackets = BacklogUdpClient::GetBdpWindow(options.bandwidth,
+                                                                MilliSeconds(15),
+                                                                MilliSeconds(5),
+                                                                1500);
     }
-    else if (scenario == "UMi-StreetCanyon")
+    Config::SetDefault("ns3::NrRlcUm::MaxTxBufferSize",
+                       UintegerValue(options.trafficMode == "backlog"
+                                         ? 2 * options.backlogPackets * 1600
+                                         : 999999999));
+
+    // set mobile device and base station antenna heights in meters, the inter-site distance
+    // of the hexagonal layout and the carrier frequency according to the chosen scenario
+    const ScenarioParameters& deployment = GetScenarioParameters(options.scenario);
+    hBS = deployment.hBS;
+    hUT = deployment.hUT;
+    if (options.frequency <= 0)
     {
-        hBS = 10;
-        hUT = 1.5;
+        options.frequency = deployment.frequency;
     }
-    else if (scenario == "InH-OfficeMixed" || scenario == "InH-OfficeOpen")
+    if (options.isd <= 0)
     {
-        hBS = 3;
-        hUT = 1;
+        options.isd = deployment.isd;
     }
-    else
+
+    // layout: the two gNBs below, or hexRings rings of sites with one gNB per cell
+    HexTopology hex(options.hexRings, options.isd, options.sectors);
+    const double legacyArea = 80.0 * 80.0; // x in [-40, 40], y in [0, 80]
+    if (options.ueDensity > 0)
     {
-        NS_ABORT_MSG("Scenario not supported. Choose among 'RMa', 'UMa', 'UMi', "
-                     "'InH-OfficeMixed', and 'InH-OfficeOpen'.");
+        double area = options.hexRings > 0 ? hex.GetArea() : legacyArea;
+        options.numUes = std::max<uint32_t>(1, std::lround(options.ueDensity * area * 1e-6));
     }
 
     // create base stations and mobile terminals
     NodeContainer gnbNodes;
     NodeContainer ueNodes;
-    //ueNodes.Create(2);
-    ueNodes.Create(1);
-    gnbNodes.Create(2);
+    ueNodes.Create(options.numUes);
+    gnbNodes.Create(options.hexRings > 0 ? hex.GetNumCells() : 2);
 
 
 
     // position the base stations
     Ptr<ListPositionAllocator> gnbPositionAlloc = CreateObject<ListPositionAllocator>();
-    gnbPositionAlloc->Add(Vector(0.0, 0.0, hBS));
-    gnbPositionAlloc->Add(Vector(0.0, 80.0, hBS));
+    if (options.hexRings > 0)
+    {
+        for (uint32_t c = 0; c < gnbNodes.GetN(); ++c)
+        {
+            gnbPositionAlloc->Add(hex.GetCellPosition(c, hBS));
+        }
+    }
+    else
+    {
+        gnbPositionAlloc->Add(Vector(0.0, 0.0, hBS));
+        gnbPositionAlloc->Add(Vector(0.0, 80.0, hBS));
+    }
 
     MobilityHelper gnbMobility;
     gnbMobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
     gnbMobility.SetPositionAllocator(gnbPositionAlloc);
     gnbMobility.Install(gnbNodes);
 
-    // position the mobile terminals and enable the mobility
-    MobilityHelper uemobility;
-    uemobility.SetMobilityModel("ns3::ConstantVelocityMobilityModel");
-    uemobility.Install(ueNodes);
-
-    if (mobility)
+    // UE mobility: replayed from a trajectory file, or constant velocity
+    if (!options.mobilityTrace.empty())
     {
-        ueNodes.Get(0)->GetObject<MobilityModel>()->SetPosition(
-            Vector(0, 0, hUT)); // (x, y, z) in m
-        ueNodes.Get(0)->GetObject<ConstantVelocityMobilityModel>()->SetVelocity(
-            Vector(0, speed, 0)); // move UE1 along the y axis
-
-        /*   
-        ueNodes.Get(1)->GetObject<MobilityModel>()->SetPosition(
-            Vector(30, 50.0, hUT)); // (x, y, z) in m
-        ueNodes.Get(1)->GetObject<ConstantVelocityMobilityModel>()->SetVelocity(
-            Vector(-speed, 0, 0)); // move UE2 along the x axis
-        */
+        TrajectoryMobilityModel::Install(Create<TrajectoryFile>(options.mobilityTrace), ueNodes);
     }
     else
     {
-        ueNodes.Get(0)->GetObject<MobilityModel>()->SetPosition(Vector(90, 15, hUT));
-        ueNodes.Get(0)->GetObject<ConstantVelocityMobilityModel>()->SetVelocity(Vector(0, 0, 0));
-        /*
-        ueNodes.Get(1)->GetObject<MobilityModel>()->SetPosition(Vector(30, 50.0, hUT));
-        ueNodes.Get(1)->GetObject<ConstantVelocityMobilityModel>()->SetVelocity(Vector(0, 0, 0));
-        */
-        
+        // position the mobile terminals and enable the mobility
+        MobilityHelper uemobility;
+        uemobility.SetMobilityModel("ns3::ConstantVelocityMobilityModel");
+        uemobility.Install(ueNodes);
+
+        if (options.mobility)
+        {
+            ueNodes.Get(0)->GetObject<MobilityModel>()->SetPosition(
+                Vector(0, 0, hUT)); // (x, y, z) in m
+            ueNodes.Get(0)->GetObject<ConstantVelocityMobilityModel>()->SetVelocity(
+                Vector(0, options.speed, 0)); // move UE1 along the y axis
+
+            /*   
+            ueNodes.Get(1)->GetObject<MobilityModel>()->SetPosition(
+                Vector(30, 50.0, hUT)); // (x, y, z) in m
+            ueNodes.Get(1)->GetObject<ConstantVelocityMobilityModel>()->SetVelocity(
+                Vector(-speed, 0, 0)); // move UE2 along the x axis
+            */
+        }
+        else
+        {
+            ueNodes.Get(0)->GetObject<MobilityModel>()->SetPosition(Vector(90, 15, hUT));
+            ueNodes.Get(0)->GetObject<ConstantVelocityMobilityModel>()->SetVelocity(Vector(0, 0, 0));
+            /*
+            ueNodes.Get(1)->GetObject<MobilityModel>()->SetPosition(Vector(30, 50.0, hUT));
+            ueNodes.Get(1)->GetObject<ConstantVelocityMobilityModel>()->SetVelocity(Vector(0, 0, 0));
+            */
+
+        }
+
+        // other UEs (all of them in the hexagonal layout): uniform drop, random heading
+        Ptr<UniformRandomVariable> uePlacement = CreateObject<UniformRandomVariable>();
+        for (uint32_t u = (options.hexRings > 0 ? 0 : 1); u < ueNodes.GetN(); ++u)
+        {
+            Vector position = options.hexRings > 0 ? hex.GetRandomPosition(uePlacement, hUT)
+                                                   : Vector(uePlacement->GetValue(-40, 40),
+                                                            uePlacement->GetValue(0, 80),
+                                                            hUT);
+            double heading = uePlacement->GetValue(0, 2 * M_PI);
+            auto ueMobilityModel = ueNodes.Get(u)->GetObject<ConstantVelocityMobilityModel>();
+            ueMobilityModel->SetPosition(position);
+            if (options.mobility)
+            {
+                ueMobilityModel->SetVelocity(
+                    Vector(options.speed * std::cos(heading),
+                           options.speed * std::sin(heading),
+                           0));
+            }
+        }
     }
 
     /*
@@ -199,13 +303,24 @@ main(int argc, char* argv[])
     // configuração de parâmetros
 
     // Define o algoritmo baseado em RSRP (Potência)
-        nrHelper->SetHandoverAlgorithmType("ns3::NrA3RsrpHandoverAlgorithm");
+        nrHelper->SetHandoverAlgorithmType(options.handoverAlgorithm);
 
-    // Define a "Histerese" (Margem de segurança) de 3.0 dB
-        nrHelper->SetHandoverAlgorithmAttribute("Hysteresis", DoubleValue(0.5));
+    if (options.handoverAlgorithm.find("A3") != std::string::npos)
+    {
+        // Define a "Histerese" (Margem de segurança) em dB
+        nrHelper->SetHandoverAlgorithmAttribute("Hysteresis", DoubleValue(options.hysteresis));
 
-    // Define o tempo para disparar (evita trocas por ruído momentâneo)
-        nrHelper->SetHandoverAlgorithmAttribute("TimeToTrigger", TimeValue(MilliSeconds(10)));
+        // Define o tempo para disparar (evita trocas por ruído momentâneo)
+        nrHelper->SetHandoverAlgorithmAttribute("TimeToTrigger",
+                                                TimeValue(Seconds(options.timeToTrigger * 1e-3)));
+    }
+    else if (options.handoverAlgorithm.find("A2A4") != std::string::npos)
+    {
+        nrHelper->SetHandoverAlgorithmAttribute("ServingCellThreshold",
+                                                UintegerValue(options.servingCellThreshold));
+        nrHelper->SetHandoverAlgorithmAttribute("NeighbourCellOffset",
+                                                UintegerValue(options.neighbourCellOffset));
+    }
 
     // Force RRC to REAL mode (not IDEAL)
     //Config::SetDefault("ns3::LteHelper::UseIdealRrc", BooleanValue(false)); 
@@ -234,17 +349,33 @@ main(int argc, char* argv[])
      * |---------------CC-----------------|
      * |---------------BWP----------------|
      */
-    CcBwpCreator::SimpleOperationBandConf bandConf(frequency, bandwidth, numCcPerBand);
+    CcBwpCreator::SimpleOperationBandConf bandConf(options.frequency,
+                                                   options.bandwidth,
+                                                   numCcPerBand);
     OperationBandInfo band = ccBwpCreator.CreateOperationBandContiguousCc(bandConf);
+    // how often the channel matrices are regenerated, before the models are created
+    Time channelPeriod = ConfigureChannelUpdates(options.channelUpdate,
+                                                 options.channelUpdatePeriod,
+                                                 options.channelUpdateDistance,
+                                                 options.mobility ? options.speed : 0);
+
     // Create the channel helper
     Ptr<NrChannelHelper> channelHelper = CreateObject<NrChannelHelper>();
     // Set and configure the channel to the current band
     channelHelper->ConfigureFactories(
-        scenario,
+        options.scenario,
         "Default",
         "ThreeGpp"); // Configure the spectrum channel with the scenario
     channelHelper->AssignChannelsToBands({band});
     allBwps = CcBwpCreator::GetAllBwps({band});
+    if (options.profile)
+    {
+        // time the channel matrices and fast fading apart from the PHY events running them
+        for (const auto& bwp : allBwps)
+        {
+            ProfilingMapScheduler::TimeChannel(bwp.get()->m_channel);
+        }
+    }
 
     // Configure ideal beamforming method
 
@@ -267,26 +398,59 @@ main(int argc, char* argv[])
     // Antennas for the gNbs
     nrHelper->SetGnbAntennaAttribute("NumRows", UintegerValue(8));
     nrHelper->SetGnbAntennaAttribute("NumColumns", UintegerValue(8));
-    nrHelper->SetGnbAntennaAttribute("AntennaElement",
-                                     PointerValue(CreateObject<IsotropicAntennaModel>()));
-
-    // install nr net devices
-
-
+    if (options.sectors == 3)
+    {
+        nrHelper->SetGnbAntennaAttribute("AntennaElement",
+                                         PointerValue(CreateObject<ThreeGppAntennaModel>()));
+    }
+    else
+    {
+        nrHelper->SetGnbAntennaAttribute("AntennaElement",
+                                         PointerValue(CreateObject<IsotropicAntennaModel>()));
+    }
 
+    // RSRP-only pre-screen: same nodes, mobility and channel, trigger applied offline
+    if (options.prescreen)
+    {
+        summary.Set("program", "ex005");
+        RunPrescreen(options,
+                     allBwps[0].get()->m_channel->GetPropagationLossModel(),
+                     hex,
+                     gnbNodes,
+                     ueNodes,
+                     summary);
+        options.WriteSummary(summary, hash);
+        Simulator::Destroy();
+        return EXIT_SUCCESS;
+    }
 
-    NetDeviceContainer gnbNetDev = nrHelper->InstallGnbDevice(gnbNodes, allBwps);
+    // install nr net devices, one at a time when each sector needs its own bearing
+    NetDeviceContainer gnbNetDev;
+    if (options.sectors == 3 && options.hexRings > 0)
+    {
+        for (uint32_t c = 0; c < gnbNodes.GetN(); ++c)
+        {
+            nrHelper->SetGnbAntennaAttribute("BearingAngle", DoubleValue(hex.GetCellBearing(c)));
+            gnbNetDev.Add(nrHelper->InstallGnbDevice(NodeContainer(gnbNodes.Get(c)), allBwps));
+        }
+    }
+    else
+    {
+        gnbNetDev = nrHelper->InstallGnbDevice(gnbNodes, allBwps);
+    }
     NetDeviceContainer ueNetDev = nrHelper->InstallUeDevice(ueNodes, allBwps);
 
     checaNode(gnbNetDev, ueNetDev);
 
 
-    int64_t randomStream = 1;
+    int64_t randomStream = options.firstStream;
     randomStream += nrHelper->AssignStreams(gnbNetDev, randomStream);
     randomStream += nrHelper->AssignStreams(ueNetDev, randomStream);
 
-    NrHelper::GetGnbPhy(gnbNetDev.Get(0), 0)->SetTxPower(txPower);
-    NrHelper::GetGnbPhy(gnbNetDev.Get(1), 0)->SetTxPower(txPower);
+    for (uint32_t i = 0; i < gnbNetDev.GetN(); ++i)
+    {
+        NrHelper::GetGnbPhy(gnbNetDev.Get(i), 0)->SetTxPower(options.txPower);
+    }
 
     // create the internet and install the IP stack on the UEs
     // get SGW/PGW and create a single RemoteHost
@@ -309,8 +473,25 @@ main(int argc, char* argv[])
         UdpServerHelper dlPacketSinkHelper(dlPort);
         serverApps.Add(dlPacketSinkHelper.Install(ueNodes.Get(u)));
 
+        if (options.trafficMode == "backlog")
+        {
+            // full buffer that only sends what the cell drains
+            Ptr<BacklogUdpClient> dlClient = CreateObject<BacklogUdpClient>();
+            dlClient->SetAttribute("PacketSize", UintegerValue(1500));
+            dlClient->SetAttribute("MaxInFlight", UintegerValue(options.backlogPackets));
+            dlClient->SetRemote(ueIpIface.GetAddress(u), dlPort);
+            dlClient->SetSink(DynamicCast<UdpServer>(serverApps.Get(u)));
+            remoteHost->AddApplication(dlClient);
+            clientApps.Add(dlClient);
+            continue;
+        }
+
         UdpClientHelper dlClient(ueIpIface.GetAddress(u), dlPort);
-        dlClient.SetAttribute("Interval", TimeValue(MicroSeconds(100)));
+        // MicroSeconds() takes an integer, a sub-us interval would become 0
+        const Time interval = Seconds(options.udpInterval * 1e-6);
+        NS_ABORT_MSG_UNLESS(interval.IsStrictlyPositive(),
+                            "udpInterval must be positive, got " << options.udpInterval << " us");
+        dlClient.SetAttribute("Interval", TimeValue(interval));
         dlClient.SetAttribute ("MaxPackets", UintegerValue(0xFFFFFFFF));
         //dlClient.SetAttribute("MaxPackets", UintegerValue(3612));
         dlClient.SetAttribute("PacketSize", UintegerValue(1500));
@@ -324,13 +505,54 @@ main(int argc, char* argv[])
      * trocando
      * 
      * NOTA: a função espera 2 gnodes como argumento
+     *
+     * No layout hexagonal só os vizinhos são ligados, a malha completa cresce com o
+     * quadrado do número de células
      */
-
-    nrEpcHelper->AddX2Interface(gnbNodes.Get(0), gnbNodes.Get(1));
+    if (options.hexRings > 0)
+    {
+        for (const auto& [a, b] : hex.GetNeighbourCellPairs())
+        {
+            nrEpcHelper->AddX2Interface(gnbNodes.Get(a), gnbNodes.Get(b));
+        }
+    }
+    else
+    {
+        nrEpcHelper->AddX2Interface(gnbNodes.Get(0), gnbNodes.Get(1));
+    }
 
 
-    // attach UEs to the closest gNB
-    nrHelper->AttachToClosestGnb(ueNetDev, gnbNetDev);
+    // attach UEs to the closest gNB, timed to compare the grid search with the full scan
+    double attachSeconds;
+    if (options.attachMode == "closest")
+    {
+        auto attachStart = std::chrono::steady_clock::now();
+        nrHelper->AttachToClosestGnb(ueNetDev, gnbNetDev);
+        attachSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                      attachStart)
+                            .count();
+    }
+    else
+    {
+        NS_ABORT_MSG_UNLESS(options.attachMode == "grid" || options.attachMode == "rsrp",
+                            "attachMode must be closest, grid or rsrp");
+        SpatialAttachment attachment;
+        if (options.attachMode == "rsrp")
+        {
+            attachment.SetCandidates(options.attachCandidates);
+            attachment.SetPropagationLossModel(
+                allBwps[0].get()->m_channel->GetPropagationLossModel());
+        }
+        else
+        {
+            attachment.SetCandidates(1);
+        }
+        attachment.Attach(nrHelper, ueNetDev, gnbNetDev);
+        attachSeconds = attachment.GetIndexSeconds() + attachment.GetAttachSeconds();
+    }
+    std::cout << "Attached " << ueNetDev.GetN() << " UEs to " << gnbNetDev.GetN()
+              << " gNBs (" << options.attachMode << ") in " << attachSeconds * 1e3 << " ms"
+              << std::endl;
 
 
 
@@ -338,11 +560,35 @@ main(int argc, char* argv[])
 
     serverApps.Start(Seconds(1.4));
     clientApps.Start(Seconds(1.4));
-    serverApps.Stop(Seconds(simTime));
-    clientApps.Stop(Seconds(simTime - 0.2));
+    serverApps.Stop(Seconds(options.simTime));
+    clientApps.Stop(Seconds(options.simTime - 0.2));
 
-    // enable the traces provided by the nr module
-    nrHelper->EnableTraces();
+    // enable the NR traces, written straight into outputDir unless the legacy traces of the
+    // nr module are asked for
+    NrTraceOutput traceOutput;
+    if (options.traceMode == "text" || options.traceMode == "binary")
+    {
+        traceOutput.Open(options.outputDir, options.traceMode == "binary");
+        if (options.traceCapture)
+        {
+            traceOutput.SetCapture(Seconds(options.capturePre * 1e-3),
+                                   Seconds(options.capturePost * 1e-3),
+                                   options.captureSinr);
+        }
+        traceOutput.Install(ueNetDev, gnbNetDev);
+    }
+    else if (options.traceMode == "legacy")
+    {
+        nrHelper->EnableTraces();
+    }
+    else
+    {
+        NS_ABORT_MSG_UNLESS(options.traceMode == "off",
+                            "traceMode must be text, binary, legacy or off");
+    }
+    NS_ABORT_MSG_IF(options.traceCapture && options.traceMode != "text" &&
+                        options.traceMode != "binary",
+                    "traceCapture needs traceMode text or binary");
 
         // Anexe o UE inicialmente à torre mais próxima (gNB 0)
         //nrHelper->AttachToClosestGnb(ueNetDev, gnbNetDev);
@@ -356,30 +602,147 @@ main(int argc, char* argv[])
     Ptr<FlowMonitor> monitor = flowmon.InstallAll();
     monitor->CheckForLostPackets();
 
+    // rx bytes/packets, losses and delay of each downlink flow per interval
+    FlowSampler flowSampler;
+    if (options.flowSampleInterval > 0)
+    {
+        flowSampler.SetInterval(Seconds(options.flowSampleInterval * 1e-3));
+        flowSampler.SetOutputFile(options.outputDir + "/flow-timeseries.txt");
+        flowSampler.SetFlowMonitor(monitor,
+                                   DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier()));
+        for (uint32_t u = 0; u < ueNodes.GetN(); ++u)
+        {
+            flowSampler.AddFlow(serverApps.Get(u)->GetObject<UdpServer>(),
+                                ueIpIface.GetAddress(u),
+                                dlPort);
+        }
+        flowSampler.Start(Seconds(1.4), Seconds(options.simTime));
+    }
+
     //funções em agendamento
 
     //Simulator::Schedule(Seconds(0.1), &ondeTa, ueNodes);
 
+    // handover/RRC events with their exact timestamps, written to
+    // handover-events.txt at Simulator::Destroy (replaces the polled checaNode calls)
+    HandoverEventLog handoverLog;
+    handoverLog.SetOutputFile(options.outputDir + "/handover-events.txt");
+    handoverLog.Install(ueNetDev, gnbNetDev);
+
+    // handover KPIs updated online from the traces, one record in summary.csv
+    HandoverKpiEngine kpis;
+    kpis.SetPingPongWindow(Seconds(options.pingPongWindow));
+    kpis.SetSinrThreshold(options.sinrThreshold);
+    kpis.Install(ueNetDev);
+
+    // batch means of the data flows, stopping the run once they have converged
+    KpiConvergence convergence;
+    if (options.earlyStop)
+    {
+        convergence.SetBatch(Seconds(options.earlyStopBatch * 1e-3));
+        convergence.SetPrecision(options.earlyStopPrecision);
+        convergence.SetMinBatches(options.earlyStopMinBatches);
+        convergence.SetHandoverKpis(&kpis, options.earlyStopHandovers);
+        convergence.SetFlowMonitor(monitor,
+                                   DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier()),
+                                   dlPort);
+        convergence.Start(Seconds(1.4));
+    }
 
-    Simulator::Schedule(Seconds(0.6), &checaNode, gnbNetDev, ueNetDev);
-    Simulator::Schedule(Seconds(1.6), &checaNode, gnbNetDev, ueNetDev);
-    Simulator::Schedule(Seconds(2.6), &checaNode, gnbNetDev, ueNetDev);
-    Simulator::Schedule(Seconds(3.6), &checaNode, gnbNetDev, ueNetDev);
-    Simulator::Schedule(Seconds(4.6), &checaNode, gnbNetDev, ueNetDev);
-
-
-
+    // memory, event list, RLC buffers and wall time, to see where a slow run goes
+    TelemetrySampler telemetry;
+    if (options.telemetryInterval > 0)
+    {
+        telemetry.SetInterval(Seconds(options.telemetryInterval * 1e-3));
+        telemetry.SetOutputDirectory(options.outputDir);
+        telemetry.TrackRlc(gnbNetDev);
+        telemetry.Start(Seconds(options.telemetryInterval * 1e-3));
+    }
 
+    // Replicas: setup and warm-up once, then each forked child continues with its own
+    // random run (or backlog window) and output directory
+    auto retarget = [&]() {
+        handoverLog.SetOutputFile(options.outputDir + "/handover-events.txt");
+        traceOutput.SetDirectory(options.outputDir);
+        flowSampler.SetOutputFile(options.outputDir + "/flow-timeseries.txt");
+        telemetry.SetOutputDirectory(options.outputDir);
+        if (options.logging && options.logSink == "ring")
+        {
+            logRing.Open(options.outputDir + "/log-ring.bin", options.logRingEntries);
+        }
+    };
+    const uint32_t replica =
+        RunReplicas(options, nrHelper, gnbNetDev, ueNetDev, allBwps, clientApps, retarget);
 
-    Simulator::Stop(Seconds(simTime));
+    Simulator::Stop(Seconds(options.simTime) - Simulator::Now());
+    auto runStart = std::chrono::steady_clock::now();
     Simulator::Run();
+    const double runWallSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+    traceOutput.Close();
+    if (options.flowSampleInterval > 0)
+    {
+        flowSampler.Finish();
+    }
+    if (options.telemetryInterval > 0)
+    {
+        telemetry.Finish();
+    }
+    if (options.profile)
+    {
+        std::ofstream profileFile(options.outputDir + "/profile.txt");
+        ProfilingMapScheduler::Report(profileFile);
+        ProfilingMapScheduler::Report(std::cout);
+    }
 
 
-    monitor->SerializeToXmlFile(tr_name + ".xml", true, true);
+    // per-flow bitrate/delay/loss straight from the flow stats, no XML round trip
+    auto classifier = DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
+    FlowSummaryExporter flowExporter;
+    flowExporter.SetFirstFlowId(options.flowFirstId);
+    FlowSummaryExporter::Write(flowExporter.Collect(monitor, classifier),
+                               options.outputDir + "/flows.csv");
+    FlowSummaryExporter dataFlowFilter;
+    dataFlowFilter.SetDestinationPort(dlPort);
+    FlowSummary dataFlows =
+        FlowSummaryExporter::Aggregate(dataFlowFilter.Collect(monitor, classifier));
+    if (options.flowmonXml)
+    {
+        monitor->SerializeToXmlFile(tr_name + ".xml", true, true);
+    }
 
     Ptr<UdpServer> serverApp = serverApps.Get(0)->GetObject<UdpServer>();
     uint64_t receivedPackets = serverApp->GetReceived();
 
+    // one-row summary of this run, merged across runs by sweep-handover.py
+    summary.Set("program", "ex005");
+    options.AddToSummary(summary);
+    summary.Set("gnbs", gnbNodes.GetN());
+    summary.Set("ues", ueNodes.GetN());
+    summary.Set("attachSeconds", attachSeconds);
+    summary.Set("channelUpdatePeriodMs", channelPeriod.GetSeconds() * 1e3);
+    if (options.telemetryInterval > 0)
+    {
+        telemetry.AddToSummary(summary);
+    }
+    summary.Set("rngRun", RngSeedManager::GetRun());
+    summary.Set("replica", replica);
+    summary.Set("events", Simulator::GetEventCount());
+    summary.Set("runWallSeconds", runWallSeconds);
+    if (options.traceCapture)
+    {
+        traceOutput.AddToSummary(summary);
+    }
+    summary.Set("rxPackets", receivedPackets);
+    summary.Set("lostPackets", serverApp->GetLost());
+    kpis.AddToSummary(summary);
+    if (options.earlyStop)
+    {
+        convergence.AddToSummary(summary);
+    }
+    FlowSummaryExporter::AddToSummary(dataFlows, summary);
+    options.WriteSummary(summary, hash);
+
     Simulator::Destroy();
 
 
@@ -387,7 +750,10 @@ main(int argc, char* argv[])
 
     if (receivedPackets >= 10)
     {
-        organizar("scratch/results/ex005/");
+        if (options.traceMode == "legacy")
+        {
+            organizar(options.outputDir);
+        }
         return EXIT_SUCCESS;
     }
     else
@@ -429,7 +795,7 @@ void organizar(std::string caminho_res){
     std::string outputDir = caminho_res;
 
     // Cria o diretório se não existir
-    try {656175
+    try {
         if (!fs::exists(outputDir)) {
             fs::create_directories(outputDir);
         }
@@ -437,7 +803,7 @@ void organizar(std::string caminho_res){
         // Loop para mover cada arquivo
         for (const auto& filename : traceFiles) {
             fs::path sourcePath = filename;              // Arquivo na raiz
-            fs::path destPath = outputDir + filename;    // Destino
+            fs::path destPath = fs::path(outputDir) / filename; // Destino
 
             if (fs::exists(sourcePath)) {
                 // Sobrescreve se já existir lá dentro
@@ -0,0 +1,217 @@
+#ifndef FLOW_SAMPLER_H
+#define FLOW_SAMPLER_H
+
+/**
+ * @file flow-sampler.h
+ * @brief Time series of the downlink flows, to be aligned with the handover events.
+ *
+ * Every sampling interval the sampler reads the cumulative counters of each tracked
+ * flow (FlowMonitor rx bytes, rx packets and delay sum, UdpServer lost packets) and
+ * stores the increments since the previous sample in an array preallocated for the
+ * whole run. A sample costs one flow-stats lookup per tracked flow; the in-flight
+ * packet scan of FlowMonitor::CheckForLostPackets is never run, losses come from
+ * the sequence numbers seen by the UdpServer sinks.
+ */
+
+#include "buffered-file-writer.h"
+
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+#include "ns3/flow-monitor-module.h"
+#include "ns3/internet-module.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/// Increments of one flow over one sampling interval
+struct FlowSample
+{
+    int64_t timeNs;       //!< End of the interval
+    uint32_t flowIndex;   //!< Index of the flow in the order it was added
+    uint32_t rxPackets;   //!< Packets received in the interval
+    uint64_t rxBytes;     //!< Bytes received in the interval
+    uint32_t lostPackets; //!< Packets found lost by the sink in the interval
+    uint32_t flowId;      //!< FlowMonitor flow id, 0 until the flow is seen
+    double meanDelay;     //!< Mean delay (s) of the interval, NaN if nothing was received
+};
+
+static_assert(sizeof(FlowSample) == 40, "FlowSample must stay packed");
+
+class FlowSampler
+{
+  public:
+    /// @brief Set the sampling interval (default 10 ms).
+    void SetInterval(Time interval)
+    {
+        NS_ABORT_MSG_UNLESS(interval.IsStrictlyPositive(),
+                            "FlowSampler interval must be positive, got " << interval);
+        m_interval = interval;
+    }
+
+    /// @brief Set the output file written by Finish (default flow-timeseries.txt).
+    void SetOutputFile(const std::string& path)
+    {
+        m_writer.SetPath(path);
+    }
+
+    /**
+     * @brief Set the FlowMonitor the flows are read from.
+     * @param monitor the monitor returned by FlowMonitorHelper::InstallAll
+     * @param classifier the classifier of the same helper
+     */
+    void SetFlowMonitor(Ptr<FlowMonitor> monitor, Ptr<Ipv4FlowClassifier> classifier)
+    {
+        m_monitor = monitor;
+        m_classifier = classifier;
+    }
+
+    /**
+     * @brief Track the downlink flow towards a UE.
+     * @param sink the UdpServer receiving the flow
+     * @param address the UE address
+     * @param port the destination port of the flow
+     */
+    void AddFlow(Ptr<UdpServer> sink, Ipv4Address address, uint16_t port)
+    {
+        Series series;
+        series.sink = sink;
+        series.address = address;
+        series.port = port;
+        m_series.push_back(series);
+    }
+
+    /**
+     * @brief Preallocate the time series and schedule the first sample.
+     * @param start time of the first sample
+     * @param stop time after which no sample is taken
+     */
+    void Start(Time start, Time stop)
+    {
+        NS_ABORT_MSG_UNLESS(m_monitor, "FlowSampler needs SetFlowMonitor before Start");
+        m_stop = stop;
+        std::size_t steps = static_cast<std::size_t>((stop - start) / m_interval) + 1;
+        m_samples.reserve(steps * m_series.size());
+        m_event = Simulator::Schedule(start - Simulator::Now(), &FlowSampler::Sample, this);
+    }
+
+    /// @return the samples taken so far
+    const std::vector<FlowSample>& GetSamples() const
+    {
+        return m_samples;
+    }
+
+    /// @brief Stop sampling and write the time series.
+    void Finish()
+    {
+        m_event.Cancel();
+        if (m_writer.GetPath().empty())
+        {
+            m_writer.SetPath("flow-timeseries.txt");
+        }
+        const double seconds = m_interval.GetSeconds();
+        std::ostringstream text;
+        text << "time\tflow\tflowId\trxPackets\trxBytes\tlostPackets\tthroughputMbps\tdelayMs\n";
+        char time[32];
+        for (const auto& s : m_samples)
+        {
+            std::snprintf(time, sizeof(time), "%.9f", s.timeNs * 1e-9);
+            text << time << "\t" << s.flowIndex << "\t" << s.flowId << "\t"
+                 << s.rxPackets << "\t" << s.rxBytes << "\t" << s.lostPackets << "\t"
+                 << s.rxBytes * 8e-6 / seconds << "\t" << s.meanDelay * 1e3 << "\n";
+        }
+        m_writer.Write(text.str());
+        m_writer.Close();
+    }
+
+  private:
+    /// One tracked flow and its counters at the previous sample
+    struct Series
+    {
+        Ptr<UdpServer> sink;
+        Ipv4Address address;
+        uint16_t port{0};
+        FlowId flowId{0};
+        uint32_t rxPackets{0};
+        uint64_t rxBytes{0};
+        uint32_t lost{0};
+        Time delaySum;
+    };
+
+    /// Find the flow id of a series once FlowMonitor has seen its first packet
+    void Resolve(Series& series)
+    {
+        for (const auto& entry : m_monitor->GetFlowStats())
+        {
+            Ipv4FlowClassifier::FiveTuple t = m_classifier->FindFlow(entry.first);
+            if (t.destinationAddress == series.address && t.destinationPort == series.port)
+            {
+                series.flowId = entry.first;
+                return;
+            }
+        }
+    }
+
+    void Sample()
+    {
+        const auto& stats = m_monitor->GetFlowStats();
+        for (uint32_t i = 0; i < m_series.size(); ++i)
+        {
+            Series& series = m_series[i];
+            FlowSample sample{Simulator::Now().GetNanoSeconds(),
+                              i,
+                              0,
+                              0,
+                              0,
+                              0,
+                              std::numeric_limits<double>::quiet_NaN()};
+            if (series.flowId == 0)
+            {
+                Resolve(series);
+            }
+            auto it = series.flowId ? stats.find(series.flowId) : stats.end();
+            if (it != stats.end())
+            {
+                const FlowMonitor::FlowStats& st = it->second;
+                sample.flowId = series.flowId;
+                sample.rxPackets = st.rxPackets - series.rxPackets;
+                sample.rxBytes = st.rxBytes - series.rxBytes;
+                if (sample.rxPackets)
+                {
+                    sample.meanDelay = (st.delaySum - series.delaySum).GetSeconds() /
+                                       sample.rxPackets;
+                }
+                series.rxPackets = st.rxPackets;
+                series.rxBytes = st.rxBytes;
+                series.delaySum = st.delaySum;
+            }
+            uint32_t lost = series.sink->GetLost();
+            sample.lostPackets = lost - series.lost;
+            series.lost = lost;
+            m_samples.push_back(sample);
+        }
+        if (Simulator::Now() + m_interval <= m_stop)
+        {
+            m_event = Simulator::Schedule(m_interval, &FlowSampler::Sample, this);
+        }
+    }
+
+    Ptr<FlowMonitor> m_monitor;           //!< Source of the rx counters
+    Ptr<Ipv4FlowClassifier> m_classifier; //!< Maps flow ids to 5-tuples
+    std::vector<Series> m_series;         //!< Tracked flows
+    std::vector<FlowSample> m_samples;    //!< Preallocated time series
+    BufferedFileWriter m_writer;          //!< Output file
+    Time m_interval{MilliSeconds(10)};    //!< Sampling interval
+    Time m_stop;                          //!< No samples after this time
+    EventId m_event;                      //!< Next sampling event
+};
+
+} // namespace ns3
+
+#endif // FLOW_SAMPLER_H
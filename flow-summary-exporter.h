@@ -0,0 +1,193 @@
+#ifndef FLOW_SUMMARY_EXPORTER_H
+#define FLOW_SUMMARY_EXPORTER_H
+
+/**
+ * @file flow-summary-exporter.h
+ * @brief End-of-run FlowMonitor summary written directly as CSV.
+ *
+ * Computes, for every flow, the same metrics flowmon-parse-results.py derives from
+ * the FlowMonitor XML (TX/RX bitrate, mean delay, packet loss ratio) together with
+ * the 5-tuple, in a single pass over FlowMonitor::GetFlowStats(). Flows can be
+ * filtered by flow id so that the control flows created by the EPC setup are left
+ * out.
+ */
+
+#include "buffered-file-writer.h"
+#include "run-summary.h"
+
+#include "ns3/core-module.h"
+#include "ns3/flow-monitor-module.h"
+#include "ns3/internet-module.h"
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/// Metrics of one flow, as printed by flowmon-parse-results.py
+struct FlowSummary
+{
+    FlowId flowId;                       //!< FlowMonitor flow id
+    Ipv4FlowClassifier::FiveTuple tuple; //!< Addresses, ports and protocol
+    uint32_t txPackets;                  //!< Transmitted packets
+    uint32_t rxPackets;                  //!< Received packets
+    uint32_t lostPackets;                //!< Packets declared lost
+    uint64_t rxBytes;                    //!< Received bytes
+    double txBitrate;                    //!< bit/s over the TX period, NaN if undefined
+    double rxBitrate;                    //!< bit/s over the RX period, NaN if undefined
+    double delayMean;                    //!< seconds, NaN without received packets
+    double packetLossRatio;              //!< lost / (rx + lost), NaN without received packets
+};
+
+class FlowSummaryExporter
+{
+  public:
+    /**
+     * @brief Keep only flows with an id >= firstFlowId.
+     *
+     * In these scenarios flows 1-4 are control traffic of the EPC setup and the
+     * downlink data flow comes next, so 5 keeps only the data flows.
+     */
+    void SetFirstFlowId(FlowId firstFlowId)
+    {
+        m_firstFlowId = firstFlowId;
+    }
+
+    /// @brief Keep only flows towards this destination port (0 keeps every port).
+    void SetDestinationPort(uint16_t port)
+    {
+        m_destinationPort = port;
+    }
+
+    /**
+     * @brief Compute the summaries of the flows that pass the filters.
+     * @param monitor the installed FlowMonitor, after Simulator::Run
+     * @param classifier the classifier of the FlowMonitorHelper
+     * @return one entry per flow, in flow id order
+     */
+    std::vector<FlowSummary> Collect(Ptr<FlowMonitor> monitor,
+                                     Ptr<Ipv4FlowClassifier> classifier) const
+    {
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        std::vector<FlowSummary> flows;
+        monitor->CheckForLostPackets();
+        for (const auto& [flowId, st] : monitor->GetFlowStats())
+        {
+            Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow(flowId);
+            if (flowId < m_firstFlowId ||
+                (m_destinationPort && t.destinationPort != m_destinationPort))
+            {
+                continue;
+            }
+            double txDuration = (st.timeLastTxPacket - st.timeFirstTxPacket).GetSeconds();
+            double rxDuration = (st.timeLastRxPacket - st.timeFirstRxPacket).GetSeconds();
+            FlowSummary f;
+            f.flowId = flowId;
+            f.tuple = t;
+            f.txPackets = st.txPackets;
+            f.rxPackets = st.rxPackets;
+            f.lostPackets = st.lostPackets;
+            f.rxBytes = st.rxBytes;
+            f.txBitrate = txDuration > 0 ? st.txBytes * 8.0 / txDuration : nan;
+            f.rxBitrate = rxDuration > 0 ? st.rxBytes * 8.0 / rxDuration : nan;
+            f.delayMean = st.rxPackets ? st.delaySum.GetSeconds() / st.rxPackets : nan;
+            f.packetLossRatio =
+                st.rxPackets ? double(st.lostPackets) / (st.rxPackets + st.lostPackets) : nan;
+            flows.push_back(f);
+        }
+        return flows;
+    }
+
+    /**
+     * @brief Write the flow summaries as CSV (bitrates in kbit/s, delay in ms, loss in %).
+     * @param flows the output of Collect
+     * @param path the CSV file to create
+     */
+    static void Write(const std::vector<FlowSummary>& flows, const std::string& path)
+    {
+        BufferedFileWriter writer;
+        writer.SetPath(path);
+        std::ostringstream text;
+        text << "flowId,protocol,sourceAddress,sourcePort,destinationAddress,destinationPort,"
+                "txPackets,rxPackets,lostPackets,txBitrateKbps,rxBitrateKbps,meanDelayMs,"
+                "packetLossPercent\n";
+        for (const auto& f : flows)
+        {
+            text << f.flowId << ",";
+            if (f.tuple.protocol == 6 || f.tuple.protocol == 17)
+            {
+                text << (f.tuple.protocol == 6 ? "TCP" : "UDP");
+            }
+            else
+            {
+                text << static_cast<unsigned>(f.tuple.protocol);
+            }
+            text << ","
+                 << f.tuple.sourceAddress << "," << f.tuple.sourcePort << ","
+                 << f.tuple.destinationAddress << "," << f.tuple.destinationPort << ","
+                 << f.txPackets << "," << f.rxPackets << "," << f.lostPackets << ","
+                 << f.txBitrate * 1e-3 << "," << f.rxBitrate * 1e-3 << "," << f.delayMean * 1e3
+                 << "," << f.packetLossRatio * 100 << "\n";
+        }
+        writer.Write(text.str());
+        writer.Close();
+    }
+
+    /**
+     * @brief Combine several flows into one entry.
+     *
+     * Bitrates are added, the mean delay is weighted by the received packets and the
+     * loss ratio is computed over the packets of all flows. The 5-tuple is left empty.
+     * @param flows the output of Collect
+     * @return the aggregate, with flowId set to the number of flows
+     */
+    static FlowSummary Aggregate(const std::vector<FlowSummary>& flows)
+    {
+        const double nan = std::numeric_limits<double>::quiet_NaN();
+        FlowSummary total{};
+        total.flowId = flows.size();
+        double delaySum = 0;
+        for (const auto& f : flows)
+        {
+            total.txPackets += f.txPackets;
+            total.rxPackets += f.rxPackets;
+            total.lostPackets += f.lostPackets;
+            total.rxBytes += f.rxBytes;
+            total.txBitrate += std::isnan(f.txBitrate) ? 0 : f.txBitrate;
+            total.rxBitrate += std::isnan(f.rxBitrate) ? 0 : f.rxBitrate;
+            delaySum += f.rxPackets ? f.delayMean * f.rxPackets : 0;
+        }
+        total.delayMean = total.rxPackets ? delaySum / total.rxPackets : nan;
+        total.packetLossRatio =
+            total.rxPackets ? double(total.lostPackets) / (total.rxPackets + total.lostPackets)
+                            : nan;
+        return total;
+    }
+
+    /**
+     * @brief Add an aggregate to the summary of a run.
+     * @param flows the output of Aggregate
+     * @param summary summary of the run
+     */
+    static void AddToSummary(const FlowSummary& flows, RunSummary& summary)
+    {
+        summary.Set("dataFlows", flows.flowId);
+        summary.Set("txBitrateKbps", flows.txBitrate * 1e-3);
+        summary.Set("rxBitrateKbps", flows.rxBitrate * 1e-3);
+        summary.Set("meanDelayMs", flows.delayMean * 1e3);
+        summary.Set("packetLossPercent", flows.packetLossRatio * 100);
+    }
+
+  private:
+    FlowId m_firstFlowId{0};       //!< Lowest flow id kept
+    uint16_t m_destinationPort{0}; //!< Destination port filter, 0 disables it
+};
+
+} // namespace ns3
+
+#endif // FLOW_SUMMARY_EXPORTER_H
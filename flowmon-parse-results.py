@@ -1,3 +1,24 @@
+"""! Parser of the FlowMonitor XML files written with --flowmonXml.
+
+With one XML file, prints the TX/RX bitrate, mean delay and packet loss ratio
+of every flow. With several files or directories (searched recursively for
+*.xml) or with --csv, parses the files in --jobs worker processes and writes one
+CSV row per flow: the run identifiers (directory of the file relative to the
+common input directory, file name, FlowMonitor index and, when the run left a
+summary.csv next to the XML, its configHash and rngRun), the five-tuple and the
+--metrics. Each file is streamed: a flow element is summarised into the
+requested metrics and dropped as soon as it is complete. The histogram bins and
+probe statistics are still parsed into elements, but only those of the current
+Flow or FlowProbe are held: they are dropped as soon as each Flow ends.
+
+Example:
+    python3 scratch/flowmon-parse-results.py sweep/ --csv flows-all.csv --jobs 8 \\
+        --metrics rxBitrateKbps,meanDelayMs,packetLossPercent
+"""
+
+import argparse
+import concurrent.futures
+import csv
 import os
 import sys
 
@@ -205,8 +226,158 @@ class Simulation(object):
                 flow_map[flowId].probe_stats_unsorted.append(s)
 
 
-def main(argv):
-    with open(argv[1], encoding="utf-8") as file_obj:
+def _flow_values(flow_el):
+    """! Numeric attributes of a FlowStats/Flow element, times in ns."""
+    values = {}
+    for key, text in flow_el.attrib.items():
+        values[key] = float(text[:-2] if text.endswith("ns") else text)
+    return values
+
+
+def _ratio(num, den, scale=1.0):
+    return num / den * scale if den > 0 else None
+
+
+## Metrics of a flow computed from its FlowStats attributes, by CSV column
+METRICS = {
+    "txPackets": lambda v: int(v["txPackets"]),
+    "rxPackets": lambda v: int(v["rxPackets"]),
+    "lostPackets": lambda v: int(v["lostPackets"]),
+    "txBytes": lambda v: int(v["txBytes"]),
+    "rxBytes": lambda v: int(v["rxBytes"]),
+    "txBitrateKbps": lambda v: _ratio(
+        v["txBytes"] * 8, v["timeLastTxPacket"] - v["timeFirstTxPacket"], 1e6
+    ),
+    "rxBitrateKbps": lambda v: _ratio(
+        v["rxBytes"] * 8, v["timeLastRxPacket"] - v["timeFirstRxPacket"], 1e6
+    ),
+    "meanDelayMs": lambda v: _ratio(v["delaySum"], v["rxPackets"], 1e-6),
+    "meanJitterMs": lambda v: _ratio(v["jitterSum"], v["rxPackets"] - 1, 1e-6),
+    "packetLossPercent": lambda v: _ratio(
+        v["lostPackets"], v["rxPackets"] + v["lostPackets"], 100
+    ),
+    "meanPacketSize": lambda v: _ratio(v["rxBytes"], v["rxPackets"]),
+    "hopCount": lambda v: _ratio(v["timesForwarded"] + v["rxPackets"], v["rxPackets"]),
+    "firstTxSeconds": lambda v: v["timeFirstTxPacket"] * 1e-9,
+    "lastRxSeconds": lambda v: v["timeLastRxPacket"] * 1e-9,
+}
+
+DEFAULT_METRICS = "txBitrateKbps,rxBitrateKbps,meanDelayMs,packetLossPercent"
+
+## Run identifiers read from the summary.csv next to an XML file
+SUMMARY_FIELDS = ("configHash", "rngRun")
+
+
+def summarise_file(path, metrics):
+    """! Stream one FlowMonitor XML file.
+    @param path XML file
+    @param metrics names of METRICS to compute
+    @return list of (FlowMonitor index, flowId, five-tuple, metric values), by flowId
+    """
+    rows = []
+    flows = {}
+    tuples = {}
+    monitor = 0
+    stack = []
+    for event, elem in ElementTree.iterparse(path, events=("start", "end")):
+        if event == "start":
+            stack.append(elem)
+            continue
+        stack.pop()
+        parent = stack[-1] if stack else None
+        if elem.tag == "Flow" and parent is not None:
+            flowId = int(elem.get("flowId"))
+            if parent.tag == "FlowStats":
+                values = _flow_values(elem)
+                flows[flowId] = [METRICS[m](values) for m in metrics]
+            elif parent.tag.endswith("FlowClassifier"):
+                tuples[flowId] = (
+                    {6: "TCP", 17: "UDP"}.get(int(elem.get("protocol")), elem.get("protocol")),
+                    elem.get("sourceAddress"),
+                    elem.get("sourcePort"),
+                    elem.get("destinationAddress"),
+                    elem.get("destinationPort"),
+                )
+            # the flow is summarised: drop it, with the histogram bins parsed under it
+            parent.remove(elem)
+        elif elem.tag == "FlowProbe" and parent is not None:
+            parent.remove(elem)
+        elif elem.tag == "FlowMonitor":
+            for flowId in sorted(flows):
+                rows.append((monitor, flowId, tuples.get(flowId, ("",) * 5), flows[flowId]))
+            flows = {}
+            tuples = {}
+            monitor += 1
+            elem.clear()
+    return rows
+
+
+def _run_fields(path):
+    """! configHash and rngRun of the summary.csv next to an XML file, if any."""
+    summary = os.path.join(os.path.dirname(path), "summary.csv")
+    if not os.path.exists(summary):
+        return [""] * len(SUMMARY_FIELDS)
+    with open(summary, newline="", encoding="utf-8") as f:
+        rows = list(csv.reader(f))
+    fields = dict(zip(rows[0], rows[1])) if len(rows) >= 2 else {}
+    return [fields.get(k, "") for k in SUMMARY_FIELDS]
+
+
+def _format(value):
+    if value is None:
+        return ""
+    return str(value) if isinstance(value, int) else "%.6g" % value
+
+
+def _parse_job(path, metrics):
+    """! Worker process: summarised flows and run identifiers of one file."""
+    return summarise_file(path, metrics), _run_fields(path)
+
+
+def find_files(paths):
+    """! XML files given, and those under the directories given, sorted."""
+    files = []
+    for path in paths:
+        if not os.path.isdir(path):
+            files.append(path)
+            continue
+        for dirpath, _, names in os.walk(path):
+            files.extend(os.path.join(dirpath, n) for n in names if n.endswith(".xml"))
+    return sorted(files)
+
+
+def write_csv(files, metrics, output, jobs):
+    """! Parse files in worker processes, one CSV row per flow, in file order.
+    @return number of flows written
+    """
+    root = os.path.commonpath([os.path.dirname(os.path.abspath(f)) for f in files])
+    writer = csv.writer(output)
+    writer.writerow(
+        ["run", "file", "monitor"]
+        + list(SUMMARY_FIELDS)
+        + ["flowId", "protocol", "source", "sourcePort", "destination", "destinationPort"]
+        + metrics
+    )
+    n = 0
+    with concurrent.futures.ProcessPoolExecutor(max_workers=jobs) as pool:
+        results = pool.map(_parse_job, files, [metrics] * len(files))
+        for path, (rows, run_fields) in zip(files, results):
+            run = os.path.relpath(os.path.dirname(os.path.abspath(path)), root)
+            for monitor, flowId, five_tuple, values in rows:
+                writer.writerow(
+                    [run, os.path.basename(path), monitor]
+                    + run_fields
+                    + [flowId]
+                    + list(five_tuple)
+                    + [_format(v) for v in values]
+                )
+                n += 1
+    return n
+
+
+def print_flows(path):
+    """! Print the flows of one XML file."""
+    with open(path, encoding="utf-8") as file_obj:
         print("Reading XML file ", end=" ")
 
         sys.stdout.flush()
@@ -258,5 +429,38 @@ def main(argv):
                 print("\tPacket Loss Ratio: %.2f %%" % (flow.packetLossRatio * 100))
 
 
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("paths", nargs="+", help="FlowMonitor XML files or directories")
+    parser.add_argument("--csv", help="CSV output file ('-' for standard output)")
+    parser.add_argument(
+        "--metrics",
+        default=DEFAULT_METRICS,
+        help="comma separated metrics of the CSV, among %s" % ", ".join(METRICS),
+    )
+    parser.add_argument(
+        "--jobs", type=int, default=os.cpu_count(), help="worker processes (default: all CPUs)"
+    )
+    args = parser.parse_args(argv[1:])
+
+    files = find_files(args.paths)
+    if not files:
+        raise SystemExit("No XML files in %s" % " ".join(args.paths))
+    if len(files) == 1 and args.csv is None and not os.path.isdir(args.paths[0]):
+        print_flows(files[0])
+        return 0
+    metrics = args.metrics.split(",")
+    for m in metrics:
+        if m not in METRICS:
+            raise SystemExit("Unknown metric %s, use %s" % (m, ", ".join(METRICS)))
+    if args.csv in (None, "-"):
+        n = write_csv(files, metrics, sys.stdout, args.jobs)
+    else:
+        with open(args.csv, "w", newline="", encoding="utf-8") as output:
+            n = write_csv(files, metrics, output, args.jobs)
+    sys.stderr.write("%d flows from %d files\n" % (n, len(files)))
+    return 0
+
+
 if __name__ == "__main__":
-    main(sys.argv)
+    sys.exit(main(sys.argv))
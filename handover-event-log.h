@@ -0,0 +1,243 @@
+#ifndef HANDOVER_EVENT_LOG_H
+#define HANDOVER_EVENT_LOG_H
+
+/**
+ * @file handover-event-log.h
+ * @brief Event-driven log of the RRC connection and handover procedures.
+ *
+ * The log connects to the trace sources of the UE and gNB RRC entities and stores
+ * every event as a fixed-size HandoverEvent in a preallocated vector. Nothing is
+ * formatted while the simulation runs; the whole log is written once, when
+ * Simulator::Destroy is called.
+ */
+
+#include "buffered-file-writer.h"
+
+#include "ns3/core-module.h"
+#include "ns3/nr-module.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/// One RRC event as stored in memory
+struct HandoverEvent
+{
+    int64_t timeNs;        //!< Simulation time of the event
+    uint64_t imsi;         //!< UE IMSI
+    uint16_t rnti;         //!< RNTI in the source cell
+    uint16_t cellId;       //!< Source (or serving) cell
+    uint16_t targetCellId; //!< Target cell of a handover start, otherwise the serving cell
+    uint8_t type;          //!< HandoverEventLog::EventType
+    uint8_t gnbSide;       //!< 1 if reported by the gNB RRC, 0 if by the UE RRC
+};
+
+static_assert(sizeof(HandoverEvent) == 24, "HandoverEvent must stay packed");
+
+class HandoverEventLog
+{
+  public:
+    /// RRC events recorded by the log
+    enum EventType : uint8_t
+    {
+        CONNECTION_ESTABLISHED,
+        CONNECTION_RECONFIGURATION,
+        HANDOVER_START,
+        HANDOVER_END_OK,
+        HANDOVER_END_ERROR,
+        MEASUREMENT_REPORT,
+        RADIO_LINK_FAILURE,
+    };
+
+    /**
+     * @brief Create an empty log.
+     * @param capacity number of events preallocated; the log still grows past it
+     */
+    explicit HandoverEventLog(std::size_t capacity = 4096)
+    {
+        m_events.reserve(capacity);
+    }
+
+    /// @brief Set the file written at Simulator::Destroy (default handover-events.txt).
+    void SetOutputFile(const std::string& path)
+    {
+        m_writer.SetPath(path);
+    }
+
+    /**
+     * @brief Connect to the RRC trace sources of the given devices.
+     *
+     * Also schedules the dump of the log at Simulator::Destroy, so it must be
+     * called before the simulation is destroyed.
+     * @param ueDevices the NrUeNetDevice instances
+     * @param gnbDevices the NrGnbNetDevice instances
+     */
+    void Install(const NetDeviceContainer& ueDevices, const NetDeviceContainer& gnbDevices)
+    {
+        for (uint32_t i = 0; i < ueDevices.GetN(); ++i)
+        {
+            auto rrc = DynamicCast<NrUeNetDevice>(ueDevices.Get(i))->GetRrc();
+            Connect(rrc, "ConnectionEstablished", CONNECTION_ESTABLISHED, false);
+            Connect(rrc, "ConnectionReconfiguration", CONNECTION_RECONFIGURATION, false);
+            Connect(rrc, "HandoverEndOk", HANDOVER_END_OK, false);
+            Connect(rrc, "HandoverEndError", HANDOVER_END_ERROR, false);
+            Connect(rrc, "RadioLinkFailure", RADIO_LINK_FAILURE, false);
+            ConnectHandoverStart(rrc, false);
+        }
+        for (uint32_t i = 0; i < gnbDevices.GetN(); ++i)
+        {
+            auto rrc = DynamicCast<NrGnbNetDevice>(gnbDevices.Get(i))->GetRrc();
+            Connect(rrc, "ConnectionEstablished", CONNECTION_ESTABLISHED, true);
+            Connect(rrc, "ConnectionReconfiguration", CONNECTION_RECONFIGURATION, true);
+            Connect(rrc, "HandoverEndOk", HANDOVER_END_OK, true);
+            ConnectHandoverStart(rrc, true);
+            bool ok = rrc->TraceConnectWithoutContext(
+                "RecvMeasurementReport",
+                MakeBoundCallback(&HandoverEventLog::MeasurementReport, this));
+            NS_ABORT_MSG_UNLESS(ok, "No RecvMeasurementReport trace source on the gNB RRC");
+        }
+        if (!m_dumpScheduled)
+        {
+            Simulator::ScheduleDestroy(&HandoverEventLog::Dump, this);
+            m_dumpScheduled = true;
+        }
+    }
+
+    /// @return the events recorded so far, in time order
+    const std::vector<HandoverEvent>& GetEvents() const
+    {
+        return m_events;
+    }
+
+    /// @return a printable name of an event type
+    static const char* GetTypeName(uint8_t type)
+    {
+        static const char* names[] = {"ConnectionEstablished",
+                                      "ConnectionReconfiguration",
+                                      "HandoverStart",
+                                      "HandoverEndOk",
+                                      "HandoverEndError",
+                                      "MeasurementReport",
+                                      "RadioLinkFailure"};
+        return type <= RADIO_LINK_FAILURE ? names[type] : "Unknown";
+    }
+
+  private:
+    template <class Rrc>
+    void Connect(Ptr<Rrc> rrc, const std::string& source, EventType type, bool gnbSide)
+    {
+        bool ok = rrc->TraceConnectWithoutContext(
+            source,
+            MakeBoundCallback(gnbSide ? &HandoverEventLog::GnbEvent : &HandoverEventLog::UeEvent,
+                              this,
+                              type));
+        NS_ABORT_MSG_UNLESS(ok, "No " << source << " trace source on the RRC");
+    }
+
+    template <class Rrc>
+    void ConnectHandoverStart(Ptr<Rrc> rrc, bool gnbSide)
+    {
+        bool ok = rrc->TraceConnectWithoutContext(
+            "HandoverStart",
+            MakeBoundCallback(gnbSide ? &HandoverEventLog::GnbHandoverStart
+                                      : &HandoverEventLog::UeHandoverStart,
+                              this));
+        NS_ABORT_MSG_UNLESS(ok, "No HandoverStart trace source on the RRC");
+    }
+
+    void Record(EventType type,
+                bool gnbSide,
+                uint64_t imsi,
+                uint16_t cellId,
+                uint16_t rnti,
+                uint16_t targetCellId)
+    {
+        m_events.push_back({Simulator::Now().GetNanoSeconds(),
+                            imsi,
+                            rnti,
+                            cellId,
+                            targetCellId,
+                            type,
+                            static_cast<uint8_t>(gnbSide)});
+    }
+
+    static void UeEvent(HandoverEventLog* log,
+                        EventType type,
+                        uint64_t imsi,
+                        uint16_t cellId,
+                        uint16_t rnti)
+    {
+        log->Record(type, false, imsi, cellId, rnti, cellId);
+    }
+
+    static void GnbEvent(HandoverEventLog* log,
+                         EventType type,
+                         uint64_t imsi,
+                         uint16_t cellId,
+                         uint16_t rnti)
+    {
+        log->Record(type, true, imsi, cellId, rnti, cellId);
+    }
+
+    static void UeHandoverStart(HandoverEventLog* log,
+                                uint64_t imsi,
+                                uint16_t cellId,
+                                uint16_t rnti,
+                                uint16_t targetCellId)
+    {
+        log->Record(HANDOVER_START, false, imsi, cellId, rnti, targetCellId);
+    }
+
+    static void GnbHandoverStart(HandoverEventLog* log,
+                                 uint64_t imsi,
+                                 uint16_t cellId,
+                                 uint16_t rnti,
+                                 uint16_t targetCellId)
+    {
+        log->Record(HANDOVER_START, true, imsi, cellId, rnti, targetCellId);
+    }
+
+    static void MeasurementReport(HandoverEventLog* log,
+                                  uint64_t imsi,
+                                  uint16_t cellId,
+                                  uint16_t rnti,
+                                  NrRrcSap::MeasurementReport report)
+    {
+        log->Record(MEASUREMENT_REPORT, true, imsi, cellId, rnti, cellId);
+    }
+
+    void Dump()
+    {
+        if (m_writer.GetPath().empty())
+        {
+            m_writer.SetPath("handover-events.txt");
+        }
+        std::ostringstream text;
+        text << "time\tside\tevent\timsi\trnti\tcellId\ttargetCellId\n";
+        char time[32];
+        for (const auto& e : m_events)
+        {
+            std::snprintf(time, sizeof(time), "%.9f", e.timeNs * 1e-9);
+            text << time << "\t" << (e.gnbSide ? "gNB" : "UE") << "\t"
+                 << GetTypeName(e.type) << "\t" << e.imsi << "\t" << e.rnti << "\t" << e.cellId
+                 << "\t" << e.targetCellId << "\n";
+        }
+        m_writer.Write(text.str());
+        m_writer.Close();
+        std::cout << "Handover event log: " << m_events.size() << " events -> "
+                  << m_writer.GetPath() << std::endl;
+    }
+
+    std::vector<HandoverEvent> m_events; //!< Recorded events
+    BufferedFileWriter m_writer;         //!< Output file
+    bool m_dumpScheduled{false};         //!< Whether Dump is already scheduled at destroy
+};
+
+} // namespace ns3
+
+#endif // HANDOVER_EVENT_LOG_H
@@ -0,0 +1,259 @@
+#ifndef HANDOVER_KPI_H
+#define HANDOVER_KPI_H
+
+/**
+ * @file handover-kpi.h
+ * @brief Handover KPIs kept up to date from trace callbacks while the simulation runs.
+ *
+ * Instead of reconstructing handovers from the cell changes in RxPacketTrace after the
+ * run, the engine keeps a few counters per UE and updates them from the UE RRC and PHY
+ * trace sources:
+ *
+ * - handovers and handover failures (HandoverEndOk / HandoverEndError)
+ * - ping-pongs: a handover back to the cell of the previous handover within the window
+ * - interruption: from the last downlink TB received from the source cell to the first
+ *   one received from the target cell
+ * - time below a SINR threshold, with the downlink data SINR held between reports
+ * - radio link failures
+ *
+ * The whole run reduces to one record, added to the run summary.
+ */
+
+#include "run-summary.h"
+
+#include "ns3/core-module.h"
+#include "ns3/nr-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+namespace ns3
+{
+
+class HandoverKpiEngine
+{
+  public:
+    /// @brief Set the window of a ping-pong, from the end of a handover (default 1 s).
+    void SetPingPongWindow(Time window)
+    {
+        m_pingPongWindowNs = window.GetNanoSeconds();
+    }
+
+    /// @brief Set the SINR threshold of the time below SINR (default -5 dB).
+    void SetSinrThreshold(double sinrDb)
+    {
+        m_sinrThresholdDb = sinrDb;
+    }
+
+    /**
+     * @brief Connect to the RRC and first bandwidth part PHY trace sources of the UEs.
+     * @param ueDevices the NrUeNetDevice instances
+     */
+    void Install(const NetDeviceContainer& ueDevices)
+    {
+        for (uint32_t i = 0; i < ueDevices.GetN(); ++i)
+        {
+            auto ue = std::make_unique<UeState>();
+            ue->engine = this;
+            auto rrc = DynamicCast<NrUeNetDevice>(ueDevices.Get(i))->GetRrc();
+            Ptr<NrUePhy> phy = NrHelper::GetUePhy(ueDevices.Get(i), 0);
+            bool ok =
+                rrc->TraceConnectWithoutContext("HandoverStart",
+                                                MakeBoundCallback(&HandoverStart, ue.get())) &&
+                rrc->TraceConnectWithoutContext("HandoverEndOk",
+                                                MakeBoundCallback(&HandoverEndOk, ue.get())) &&
+                rrc->TraceConnectWithoutContext("HandoverEndError",
+                                                MakeBoundCallback(&HandoverEndError, ue.get())) &&
+                rrc->TraceConnectWithoutContext("RadioLinkFailure",
+                                                MakeBoundCallback(&RadioLinkFailure, ue.get())) &&
+                phy->GetSpectrumPhy()->TraceConnectWithoutContext(
+                    "RxPacketTraceUe",
+                    MakeBoundCallback(&RxPacket, ue.get())) &&
+                phy->TraceConnectWithoutContext("DlDataSinr",
+                                                MakeBoundCallback(&DlDataSinr, ue.get()));
+            NS_ABORT_MSG_UNLESS(ok, "Missing UE trace source for the handover KPIs");
+            m_ues.push_back(std::move(ue));
+        }
+    }
+
+    /// @return interruptions measured so far, over all UEs
+    uint64_t GetInterruptions() const
+    {
+        uint64_t interruptions = 0;
+        for (const auto& ue : m_ues)
+        {
+            interruptions += ue->interruptions;
+        }
+        return interruptions;
+    }
+
+    /**
+     * @brief Close the SINR intervals at the current time and add the KPIs to a summary.
+     * @param summary run summary receiving the KPI fields
+     */
+    void AddToSummary(RunSummary& summary)
+    {
+        const int64_t now = Simulator::Now().GetNanoSeconds();
+        uint64_t handovers = 0;
+        uint64_t failures = 0;
+        uint64_t pingPongs = 0;
+        uint64_t rlfs = 0;
+        uint64_t interruptions = 0;
+        int64_t interruptionNs = 0;
+        int64_t maxInterruptionNs = 0;
+        int64_t belowNs = 0;
+        int64_t observedNs = 0;
+        for (const auto& ue : m_ues)
+        {
+            ue->UpdateSinrTime(now);
+            handovers += ue->handovers;
+            failures += ue->failures;
+            pingPongs += ue->pingPongs;
+            rlfs += ue->rlfs;
+            interruptions += ue->interruptions;
+            interruptionNs += ue->interruptionNs;
+            maxInterruptionNs = std::max(maxInterruptionNs, ue->maxInterruptionNs);
+            belowNs += ue->belowNs;
+            observedNs += ue->observedNs;
+        }
+        summary.Set("handovers", handovers);
+        summary.Set("handoverFailures", failures);
+        summary.Set("pingPongs", pingPongs);
+        summary.Set("radioLinkFailures", rlfs);
+        summary.Set("interruptions", interruptions);
+        summary.Set("meanInterruptionMs",
+                    interruptions ? interruptionNs * 1e-6 / interruptions : 0.0);
+        summary.Set("maxInterruptionMs", maxInterruptionNs * 1e-6);
+        summary.Set("sinrThresholdDb", m_sinrThresholdDb);
+        summary.Set("sinrBelowSeconds", belowNs * 1e-9);
+        summary.Set("sinrBelowFraction", observedNs ? double(belowNs) / observedNs : 0.0);
+        std::cout << "Handover KPIs: " << handovers << " handovers, " << pingPongs
+                  << " ping-pongs, " << rlfs << " RLFs, mean interruption "
+                  << (interruptions ? interruptionNs * 1e-6 / interruptions : 0.0) << " ms"
+                  << std::endl;
+    }
+
+  private:
+    /// Counters and handover state of one UE, heap allocated for the bound callbacks
+    struct UeState
+    {
+        HandoverKpiEngine* engine{nullptr}; //!< Owner, for the settings
+        uint16_t servingCell{0};            //!< Cell of the last TB received
+        int64_t lastRxNs{-1};               //!< Time of the last TB received
+        uint16_t sourceCell{0};             //!< Source cell of the ongoing handover
+        uint16_t targetCell{0};             //!< Target cell of the ongoing handover, 0 if none
+        int64_t interruptionStartNs{0};     //!< Last TB from the source cell
+        uint16_t lastSourceCell{0};         //!< Source cell of the previous handover
+        uint16_t lastTargetCell{0};         //!< Target cell of the previous handover
+        int64_t lastHandoverNs{-1};         //!< End of the previous handover
+        double sinrDb{NAN};                 //!< Last downlink data SINR
+        int64_t sinrSinceNs{0};             //!< Time of the last SINR report
+        uint64_t handovers{0};              //!< Completed handovers
+        uint64_t failures{0};               //!< Failed handovers
+        uint64_t pingPongs{0};              //!< Handovers back within the window
+        uint64_t rlfs{0};                   //!< Radio link failures
+        uint64_t interruptions{0};          //!< Interruptions measured
+        int64_t interruptionNs{0};          //!< Sum of the interruptions
+        int64_t maxInterruptionNs{0};       //!< Longest interruption
+        int64_t belowNs{0};                 //!< Time spent below the SINR threshold
+        int64_t observedNs{0};              //!< Time since the first SINR report
+
+        /// Account the time since the last SINR report to the held SINR
+        void UpdateSinrTime(int64_t now)
+        {
+            if (std::isnan(sinrDb))
+            {
+                return;
+            }
+            observedNs += now - sinrSinceNs;
+            if (sinrDb < engine->m_sinrThresholdDb)
+            {
+                belowNs += now - sinrSinceNs;
+            }
+            sinrSinceNs = now;
+        }
+    };
+
+    static void HandoverStart(UeState* ue,
+                              uint64_t imsi,
+                              uint16_t cellId,
+                              uint16_t rnti,
+                              uint16_t targetCellId)
+    {
+        ue->sourceCell = cellId;
+        ue->targetCell = targetCellId;
+        // nothing received from the source yet: the interruption starts with the handover
+        ue->interruptionStartNs = (ue->servingCell == cellId && ue->lastRxNs >= 0)
+                                      ? ue->lastRxNs
+                                      : Simulator::Now().GetNanoSeconds();
+    }
+
+    static void HandoverEndOk(UeState* ue, uint64_t imsi, uint16_t cellId, uint16_t rnti)
+    {
+        const int64_t now = Simulator::Now().GetNanoSeconds();
+        ++ue->handovers;
+        if (ue->lastHandoverNs >= 0 && ue->lastSourceCell == cellId &&
+            ue->lastTargetCell == ue->sourceCell &&
+            now - ue->lastHandoverNs <= ue->engine->m_pingPongWindowNs)
+        {
+            ++ue->pingPongs;
+        }
+        ue->lastSourceCell = ue->sourceCell;
+        ue->lastTargetCell = cellId;
+        ue->lastHandoverNs = now;
+    }
+
+    static void HandoverEndError(UeState* ue, uint64_t imsi, uint16_t cellId, uint16_t rnti)
+    {
+        ++ue->failures;
+        ue->targetCell = 0;
+    }
+
+    static void RadioLinkFailure(UeState* ue, uint64_t imsi, uint16_t cellId, uint16_t rnti)
+    {
+        ++ue->rlfs;
+    }
+
+    static void RxPacket(UeState* ue, RxPacketTraceParams params)
+    {
+        if (params.m_corrupt)
+        {
+            return;
+        }
+        const int64_t now = Simulator::Now().GetNanoSeconds();
+        if (ue->targetCell != 0 && params.m_cellId == ue->targetCell)
+        {
+            const int64_t interruption = now - ue->interruptionStartNs;
+            ++ue->interruptions;
+            ue->interruptionNs += interruption;
+            ue->maxInterruptionNs = std::max(ue->maxInterruptionNs, interruption);
+            ue->targetCell = 0;
+        }
+        ue->servingCell = params.m_cellId;
+        ue->lastRxNs = now;
+    }
+
+    static void DlDataSinr(UeState* ue,
+                           uint16_t cellId,
+                           uint16_t rnti,
+                           double avgSinr,
+                           uint16_t bwpId)
+    {
+        const int64_t now = Simulator::Now().GetNanoSeconds();
+        ue->UpdateSinrTime(now);
+        ue->sinrDb = 10 * std::log10(avgSinr);
+        ue->sinrSinceNs = now;
+    }
+
+    std::vector<std::unique_ptr<UeState>> m_ues; //!< Tracked UEs
+    int64_t m_pingPongWindowNs{1000000000};      //!< Ping-pong window
+    double m_sinrThresholdDb{-5};                //!< Threshold of the time below SINR
+};
+
+} // namespace ns3
+
+#endif // HANDOVER_KPI_H
@@ -0,0 +1,328 @@
+#ifndef HANDOVER_OPTIONS_H
+#define HANDOVER_OPTIONS_H
+
+/**
+ * @file handover-options.h
+ * @brief Program options shared by the handover scenarios, with their hash and summary.
+ *
+ * nr-handover and ex005 build the same scenario and take the same options; each
+ * program only changes some defaults (output directory, simulation time, handover
+ * algorithm) before AddTo registers them. The options also give the configuration
+ * hash of a run, the cached summary of a configuration already in the results store,
+ * and the option columns of summary.csv.
+ */
+
+#include "config-hash.h"
+#include "results-store.h"
+#include "run-summary.h"
+
+#include "ns3/core-module.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <thread>
+
+namespace ns3
+{
+
+struct HandoverOptions
+{
+    std::string scenario = "UMa";            //!< 3GPP scenario
+    double frequency = 0;                    //!< central frequency, 0 uses the scenario default
+    double bandwidth = 100e6;                //!< bandwidth in Hz
+    double mobility = true;                  //!< enable mobility
+    double simTime = 7;                      //!< in second
+    double speed = 15;                       //!< UE speed in m/s
+    double txPower = 40;                     //!< gNB TX power in dBm
+    bool logging = true;                     //!< enable the log components of the program
+    std::string outputDir;                   //!< all files written by the run
+    bool flowmonXml = false;                 //!< flows.csv replaces the XML unless asked for
+    uint32_t flowFirstId = 1;                //!< lowest flow id in flows.csv
+    double flowSampleInterval = 10;          //!< ms, 0 disables flow-timeseries.txt
+    double telemetryInterval = 0;            //!< ms, 0 disables telemetry.txt
+    bool profile = false;                    //!< wall time per event category in profile.txt
+    std::string channelUpdate = "static";    //!< static, period or distance
+    double channelUpdatePeriod = 100;        //!< ms, period policy
+    double channelUpdateDistance = 1;        //!< m moved between updates, distance policy
+    uint32_t replicas = 0;                   //!< forked after the warm-up, 0 runs normally
+    double warmup = 0.4;                     //!< s, shared part of the replicas
+    uint32_t replicaJobs = std::max(1u, std::thread::hardware_concurrency()); //!< at once
+    std::string replicaWindows;              //!< backlog window of each replica, e.g. "50,100"
+    std::string traceMode = "text";          //!< text, binary, legacy (EnableTraces) or off
+    bool traceCapture = false;               //!< only write the traces around the triggers
+    double capturePre = 100;                 //!< ms of traces written before a trigger
+    double capturePost = 100;                //!< ms of traces written after a trigger
+    double captureSinr = -5;                 //!< dB, a UE SINR falling below it triggers
+    int64_t firstStream = 1;                 //!< first random stream of the devices
+    std::string handoverAlgorithm = "ns3::A2A4RsrqHandoverAlgorithm"; //!< TypeId
+    uint32_t servingCellThreshold = 30;      //!< A2-A4 only
+    uint32_t neighbourCellOffset = 5;        //!< A2-A4 only
+    double hysteresis = 3.0;                 //!< A3 only, in dB
+    double timeToTrigger = 100;              //!< A3 only, in ms
+    uint32_t hexRings = 0;                   //!< 0 keeps the two hand-placed gNBs
+    double isd = 0;                          //!< inter-site distance, 0 uses the scenario one
+    uint32_t sectors = 1;                    //!< cells per hexagonal site, 1 or 3
+    uint32_t numUes = 1;                     //!< UEs, unless ueDensity is set
+    double ueDensity = 0;                    //!< UEs per km2, overrides numUes when > 0
+    std::string attachMode = "closest";      //!< closest (AttachToClosestGnb), grid or rsrp
+    uint32_t attachCandidates = 4;           //!< nearest gNBs compared per UE in rsrp mode
+    std::string trafficMode = "udp";         //!< udp (fixed interval) or backlog
+    uint32_t backlogPackets = 0;             //!< packets in flight per UE, 0 for the BDP
+    double udpInterval = 1;                  //!< us between packets in udp mode
+    double pingPongWindow = 1;               //!< s, handover back within it is a ping-pong
+    double sinrThreshold = -5;               //!< dB, KPI time below this SINR
+    std::string logSink = "stderr";          //!< stderr (text) or ring (log-ring.bin)
+    uint64_t logRingEntries = 1 << 18;       //!< entries of log-ring.bin, 128 bytes each
+    std::string logComponents;               //!< components enabled with logSink=ring
+    std::string logNodes;                    //!< nodes kept in log-ring.bin, empty for all
+    std::string mobilityTrace;               //!< trajectory file, empty for constant velocity
+    bool earlyStop = false;                  //!< stop once throughput and delay converged
+    double earlyStopPrecision = 0.05;        //!< relative half-width of the 95% intervals
+    double earlyStopBatch = 200;             //!< ms per batch of the batch means
+    uint32_t earlyStopMinBatches = 10;       //!< batches before the first test
+    uint32_t earlyStopHandovers = 1;         //!< handover interruptions before a stop
+    bool prescreen = false;                  //!< RSRP-only walk, no NR devices
+    double prescreenStep = 10;               //!< ms between two RSRP evaluations
+    std::string resultsStore;                //!< append-only store of summaries, empty disables
+
+    /// @brief Register every option on the command line, at its current value as default.
+    void AddTo(HashedCommandLine& cmd)
+    {
+        cmd.AddValue("scenario",
+                     "The scenario for the simulation. Choose among 'RMa', 'UMa', 'UMi', "
+                     "'InH-OfficeMixed', 'InH-OfficeOpen'.",
+                     scenario);
+        cmd.AddValue("frequency",
+                     "The central carrier frequency in Hz (0 uses the scenario default).",
+                     frequency);
+        cmd.AddValue("mobility", "Enable UE mobility (1) or static UEs (0)", mobility);
+        cmd.AddValue("speed", "UE speed in m/s", speed);
+        cmd.AddValue("simTime", "Simulation time in seconds", simTime);
+        cmd.AddValue("logging", "Enable logging (1) or disable (0)", logging);
+        cmd.AddValue("outputDir", "Directory for every file written by this run", outputDir);
+        cmd.AddValue("flowmonXml",
+                     "Also serialize the FlowMonitor XML (with histograms and probes)",
+                     flowmonXml);
+        cmd.AddValue("flowFirstId",
+                     "Lowest FlowMonitor flow id written to flows.csv (5 skips the control flows)",
+                     flowFirstId);
+        cmd.AddValue("flowSampleInterval",
+                     "Interval in ms of the per-flow throughput/delay time series (0 disables it)",
+                     flowSampleInterval);
+        cmd.AddValue("telemetryInterval",
+                     "Interval in ms of the RSS/pending events/RLC buffer/wall time samples in "
+                     "telemetry.txt and rlc-buffers.txt (0 disables them)",
+                     telemetryInterval);
+        cmd.AddValue("profile",
+                     "Time every simulator event and write a ranked histogram per category "
+                     "(PHY, MAC, channel, ...) to profile.txt",
+                     profile);
+        cmd.AddValue("channelUpdate",
+                     "Regeneration of the 3GPP channel matrices and conditions: 'static' (never, "
+                     "ns-3 default), 'period' (every channelUpdatePeriod) or 'distance' (every "
+                     "channelUpdateDistance moved at the UE speed)",
+                     channelUpdate);
+        cmd.AddValue("channelUpdatePeriod", "Channel update period in ms", channelUpdatePeriod);
+        cmd.AddValue("channelUpdateDistance",
+                     "Distance in m a UE moves between channel updates",
+                     channelUpdateDistance);
+        cmd.AddValue("replicas",
+                     "Run the setup and the warm-up once, then fork this many replicas that "
+                     "continue with RngRun, RngRun+1, ... (0 disables)",
+                     replicas);
+        cmd.AddValue("warmup", "Simulation time in s shared by the replicas", warmup);
+        cmd.AddValue("replicaJobs", "Replicas running at the same time", replicaJobs);
+        cmd.AddValue("replicaWindows",
+                     "Comma separated backlog windows, one replica per value with the same "
+                     "random run instead of re-seeded replicas (trafficMode=backlog)",
+                     replicaWindows);
+        cmd.AddValue("traceMode",
+                     "NR packet/SINR traces: 'text' or 'binary' written into outputDir, 'legacy' "
+                     "for NrHelper::EnableTraces in the working directory, or 'off'",
+                     traceMode);
+        cmd.AddValue("traceCapture",
+                     "Write the text/binary traces only around handover starts, RLFs and SINR "
+                     "drops, from capturePre before to capturePost after each",
+                     traceCapture);
+        cmd.AddValue("capturePre", "Trace capture window before a trigger, in ms", capturePre);
+        cmd.AddValue("capturePost", "Trace capture window after a trigger, in ms", capturePost);
+        cmd.AddValue("captureSinr", "SINR in dB below which a UE triggers a capture", captureSinr);
+        cmd.AddValue("randomStream", "First random stream assigned to the NR devices", firstStream);
+        cmd.AddValue("handoverAlgorithm", "TypeId of the handover algorithm", handoverAlgorithm);
+        cmd.AddValue("servingCellThreshold",
+                     "A2-A4 ServingCellThreshold (RSRQ range)",
+                     servingCellThreshold);
+        cmd.AddValue("neighbourCellOffset",
+                     "A2-A4 NeighbourCellOffset (RSRQ range)",
+                     neighbourCellOffset);
+        cmd.AddValue("hysteresis", "A3 Hysteresis in dB", hysteresis);
+        cmd.AddValue("timeToTrigger", "A3 TimeToTrigger in ms", timeToTrigger);
+        cmd.AddValue("hexRings",
+                     "Rings of hexagonal sites around a central one (0 keeps the 2 gNB layout)",
+                     hexRings);
+        cmd.AddValue("isd", "Inter-site distance in m (0 uses the scenario default)", isd);
+        cmd.AddValue("sectors", "Cells per hexagonal site, 1 or 3", sectors);
+        cmd.AddValue("numUes", "Number of UEs", numUes);
+        cmd.AddValue("ueDensity", "UEs per km2 over the layout, overrides numUes", ueDensity);
+        cmd.AddValue("attachMode",
+                     "Initial attachment: 'closest' (AttachToClosestGnb), 'grid' (closest gNB "
+                     "through a spatial grid) or 'rsrp' (strongest expected RSRP among the "
+                     "nearest attachCandidates gNBs)",
+                     attachMode);
+        cmd.AddValue("attachCandidates", "Nearest gNBs compared per UE with attachMode=rsrp",
+                     attachCandidates);
+        cmd.AddValue("trafficMode",
+                     "Downlink traffic: 'udp' (UdpClient at a fixed interval) or 'backlog' "
+                     "(full buffer clocked by the UE sink, at most backlogPackets in flight)",
+                     trafficMode);
+        cmd.AddValue("backlogPackets",
+                     "Packets in flight per UE with trafficMode=backlog, 0 for the "
+                     "bandwidth-delay product of the path plus 5 ms of RLC backlog",
+                     backlogPackets);
+        cmd.AddValue("udpInterval",
+                     "Interval in us between packets with trafficMode=udp",
+                     udpInterval);
+        cmd.AddValue("pingPongWindow",
+                     "Time in s after a handover within which a handover back counts as ping-pong",
+                     pingPongWindow);
+        cmd.AddValue("sinrThreshold", "SINR in dB of the time-below-SINR KPI", sinrThreshold);
+        cmd.AddValue("logSink",
+                     "Log output: 'stderr' as text, or 'ring' as binary entries in "
+                     "outputDir/log-ring.bin (decoded by log-ring-reader.py)",
+                     logSink);
+        cmd.AddValue("logRingEntries", "Entries kept in log-ring.bin", logRingEntries);
+        cmd.AddValue("logComponents",
+                     "Comma separated log components enabled with logSink=ring, empty for all",
+                     logComponents);
+        cmd.AddValue("logNodes",
+                     "Comma separated node ids stored with logSink=ring, empty for all",
+                     logNodes);
+        cmd.AddValue("mobilityTrace",
+                     "Trajectory file written by trajectory-converter.py replayed by the UEs, "
+                     "empty for the constant velocity mobility",
+                     mobilityTrace);
+        cmd.AddValue("earlyStop",
+                     "Stop before simTime once the batch means of the downlink throughput and "
+                     "delay reach earlyStopPrecision",
+                     earlyStop);
+        cmd.AddValue("earlyStopPrecision",
+                     "Relative half-width of the 95% confidence intervals that stops the run",
+                     earlyStopPrecision);
+        cmd.AddValue("earlyStopBatch", "Batch length in ms of the early stop test", earlyStopBatch);
+        cmd.AddValue("earlyStopMinBatches",
+                     "Batches kept before the first early stop test",
+                     earlyStopMinBatches);
+        cmd.AddValue("earlyStopHandovers",
+                     "Handover interruptions measured, over all UEs, before an early stop",
+                     earlyStopHandovers);
+        cmd.AddValue("prescreen",
+                     "Only predict the handovers from the RSRP of every cell, without the NR "
+                     "stack (prescreen.txt and summary.csv)",
+                     prescreen);
+        cmd.AddValue("prescreenStep", "Walk step in ms of the pre-screen", prescreenStep);
+        cmd.AddValue("resultsStore",
+                     "Results store file; a configuration already stored is not simulated again",
+                     resultsStore);
+    }
+
+    /**
+     * @brief Hash of the effective configuration, also written to outputDir/config.txt.
+     *
+     * The options that only change where and how the output is written are left out.
+     * @param cmd the parsed command line
+     * @param program name of the program, part of the configuration
+     * @return the configuration hash
+     */
+    std::string Hash(const HashedCommandLine& cmd, const std::string& program) const
+    {
+        ConfigHash configHash;
+        configHash.Ignore({"outputDir",
+                           "logging",
+                           "logSink",
+                           "logRingEntries",
+                           "logComponents",
+                           "logNodes",
+                           "profile",
+                           "telemetryInterval",
+                           "replicaJobs",
+                           "resultsStore"});
+        configHash.AddCommandLine(cmd);
+        configHash.AddFile("mobilityTrace", mobilityTrace);
+        configHash.AddAttributeDefaults();
+        configHash.Add("program", program);
+        std::ofstream(outputDir + "/config.txt") << configHash.GetText();
+        return configHash.GetHash();
+    }
+
+    /**
+     * @brief Look the configuration up in the results store.
+     *
+     * A stored summary is written to outputDir/summary.csv with cached=1.
+     * @param hash configuration hash
+     * @param summary set to the stored summary when found
+     * @return true if the configuration needs no simulation
+     */
+    bool FindCached(const std::string& hash, RunSummary& summary) const
+    {
+        if (resultsStore.empty())
+        {
+            return false;
+        }
+        NS_ABORT_MSG_IF(replicas > 0 || !replicaWindows.empty(),
+                        "replicas cannot use the results store");
+        if (!ResultsStore(resultsStore).Find(hash, summary))
+        {
+            return false;
+        }
+        summary.Set("cached", 1);
+        summary.Write(outputDir + "/summary.csv");
+        std::cout << "Configuration " << hash << " found in " << resultsStore << std::endl;
+        return true;
+    }
+
+    /// @brief Add the scenario, handover and traffic options to the summary.
+    void AddToSummary(RunSummary& summary) const
+    {
+        summary.Set("scenario", scenario);
+        summary.Set("frequency", frequency);
+        summary.Set("speed", speed);
+        summary.Set("simTime", simTime);
+        summary.Set("handoverAlgorithm", handoverAlgorithm);
+        summary.Set("servingCellThreshold", servingCellThreshold);
+        summary.Set("neighbourCellOffset", neighbourCellOffset);
+        summary.Set("hysteresis", hysteresis);
+        summary.Set("timeToTrigger", timeToTrigger);
+        summary.Set("hexRings", hexRings);
+        summary.Set("isd", isd);
+        summary.Set("sectors", sectors);
+        summary.Set("attachMode", attachMode);
+        summary.Set("trafficMode", trafficMode);
+        summary.Set("backlogPackets", backlogPackets);
+        summary.Set("channelUpdate", channelUpdate);
+        summary.Set("udpInterval", udpInterval);
+        summary.Set("randomStream", firstStream);
+    }
+
+    /**
+     * @brief Write outputDir/summary.csv and append it to the results store.
+     * @param summary the summary of the run, completed with the hash and outputDir
+     * @param hash configuration hash
+     */
+    void WriteSummary(RunSummary& summary, const std::string& hash) const
+    {
+        summary.Set("configHash", hash);
+        summary.Set("outputDir", outputDir);
+        summary.Write(outputDir + "/summary.csv");
+        if (!resultsStore.empty())
+        {
+            ResultsStore(resultsStore).Append(hash, summary);
+        }
+    }
+};
+
+} // namespace ns3
+
+#endif // HANDOVER_OPTIONS_H
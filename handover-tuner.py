@@ -0,0 +1,272 @@
+"""! Handover parameter tuner for nr-handover.cc and ex005.cc (successive halving).
+
+Samples candidate settings of the handover algorithms, i.e. the values passed to
+nrHelper->SetHandoverAlgorithmType / SetHandoverAlgorithmAttribute through the
+command line of the programs:
+
+- ns3::A2A4RsrqHandoverAlgorithm: servingCellThreshold, neighbourCellOffset
+- ns3::NrA3RsrpHandoverAlgorithm: hysteresis (dB), timeToTrigger (ms)
+
+and evaluates them by successive halving: every candidate is first run with a
+short simTime, only the best 1/eta of them go on to the next rung with eta times
+the simTime, until a single candidate remains or the full simTime is reached.
+All runs of a rung are spread over the local cores.
+
+A rung that ends before the handovers ranks the candidates on throughput noise, so
+every candidate is first run with --prescreen (the RSRP-only walk, a few ms) and the
+simTime of rung 0 is raised to cover the first predicted handover of all of them,
+plus --prescreen-margin.
+
+The objective is a weighted sum of summary.csv columns, maximised; the default
+rewards throughput and penalises interruption time, ping-pongs and RLFs. A run
+without one of the columns scores -inf.
+
+Writes tuner-trials.csv (one row per run) and best-config.txt, a line usable
+with --batch of nr-handover, in the output directory.
+
+Example:
+    python3 scratch/handover-tuner.py --program nr-handover --output tuning \\
+        -p scenario=UMa -p speed=20 --candidates 27 --eta 3 \\
+        --min-time 1.5 --max-time 7 --runs 2
+"""
+
+import argparse
+import math
+import os
+import random
+import sys
+
+import handover_jobs
+
+A2A4 = "ns3::A2A4RsrqHandoverAlgorithm"
+A3 = "ns3::NrA3RsrpHandoverAlgorithm"
+DEFAULT_OBJECTIVE = "rxBitrateKbps=0.001,meanInterruptionMs=-0.1,pingPongs=-1,radioLinkFailures=-5"
+# 3GPP TS 38.331 TimeToTrigger values
+TIME_TO_TRIGGER = "0,40,64,80,100,128,160,256,320,480,512,640"
+
+
+def parse_objective(text):
+    """! "column=weight,..." -> list of (column, weight)."""
+    terms = []
+    for item in text.split(","):
+        if item:
+            name, _, weight = item.partition("=")
+            terms.append((name, float(weight)))
+    return terms
+
+
+def score(result, objective):
+    """! Weighted sum of the summary columns of a run, -inf if one is missing."""
+    if result["status"] != "ok":
+        return -math.inf
+    total = 0.0
+    for name, weight in objective:
+        try:
+            value = float(result.get(name, ""))
+        except ValueError:
+            return -math.inf
+        if math.isnan(value):
+            return -math.inf
+        total += weight * value
+    return total
+
+
+def sample_candidates(space, n, rng):
+    """! Up to n distinct settings; space maps an algorithm to {parameter: values}.
+
+    The algorithms take turns, each drawing from its own shuffled grid; an algorithm
+    whose grid is used up drops out and the others fill the remaining places.
+    """
+    grids = []
+    for algorithm in sorted(space):
+        grid = handover_jobs.expand_grid(space[algorithm])
+        rng.shuffle(grid)
+        grids.append((algorithm, grid))
+    candidates = []
+    while len(candidates) < n and grids:
+        for algorithm, grid in grids:
+            if len(candidates) < n:
+                candidate = {"handoverAlgorithm": algorithm}
+                candidate.update(grid.pop())
+                candidates.append(candidate)
+        grids = [(algorithm, grid) for algorithm, grid in grids if grid]
+    return candidates
+
+
+def first_handovers(candidates, fixed, args):
+    """! Time of the first handover predicted by the pre-screen of every candidate.
+
+    @return list of seconds, None for a candidate without predicted handover
+    """
+    jobs = []
+    for c, candidate in enumerate(candidates):
+        params = dict(fixed)
+        params.update(candidate)
+        params["simTime"] = args.max_time
+        params["prescreen"] = "true"
+        jobs.append(handover_jobs.Job("prescreen/c%04d" % c, args.program, params, args.output))
+    first = [None] * len(candidates)
+    for result in handover_jobs.run_jobs(jobs, args.jobs, args.ns3_dir, args.binary):
+        c = int(result["job"].split("/c")[1])
+        if result["status"] != "ok":
+            raise SystemExit("Pre-screen %s failed, see its stdout.log" % result["job"])
+        path = os.path.join(args.output, result["job"], "prescreen.txt")
+        with open(path, encoding="utf-8") as f:
+            lines = f.read().splitlines()[1:]
+        if lines:
+            first[c] = float(lines[0].split("\t")[0])
+    return first
+
+
+def rung_times(min_time, max_time, eta, candidates):
+    """! simTime of every rung: min_time * eta^k, the last one max_time."""
+    times = []
+    t = min_time
+    while t < max_time and candidates > 1:
+        times.append(round(t, 3))
+        t *= eta
+        candidates = math.ceil(candidates / eta)
+    times.append(max_time)
+    return times
+
+
+def describe(candidate):
+    """! Short text of a candidate."""
+    return " ".join("%s=%s" % (k, v) for k, v in candidate.items())
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--program", default="nr-handover", help="scratch program to run")
+    parser.add_argument("--output", default="tuning", help="root directory of the job outputs")
+    parser.add_argument(
+        "-p",
+        "--param",
+        action="append",
+        default=[],
+        metavar="NAME=VALUE",
+        help="fixed command line value of every run",
+    )
+    parser.add_argument("--algorithms", default="a2a4,a3", help="a2a4, a3 or both")
+    parser.add_argument("--serving-cell-threshold", default="20:34", help="A2-A4 values")
+    parser.add_argument("--neighbour-cell-offset", default="1:10", help="A2-A4 values")
+    parser.add_argument("--hysteresis", default="0:6:0.5", help="A3 values in dB")
+    parser.add_argument("--time-to-trigger", default=TIME_TO_TRIGGER, help="A3 values in ms")
+    parser.add_argument("--objective", default=DEFAULT_OBJECTIVE, help="column=weight,...")
+    parser.add_argument("--candidates", type=int, default=27, help="candidates of rung 0")
+    parser.add_argument("--eta", type=float, default=3, help="1/eta candidates kept per rung")
+    parser.add_argument("--min-time", type=float, default=1.5, help="lowest simTime of rung 0 (s)")
+    parser.add_argument(
+        "--prescreen-margin",
+        type=float,
+        default=0.5,
+        help="simTime of rung 0 after the last first predicted handover (s)",
+    )
+    parser.add_argument(
+        "--no-prescreen",
+        action="store_true",
+        help="keep --min-time for rung 0, without the pre-screen runs",
+    )
+    parser.add_argument("--max-time", type=float, default=7, help="simTime of the last rung (s)")
+    parser.add_argument("--runs", type=int, default=1, help="RNG runs averaged per candidate")
+    parser.add_argument("--seed", type=int, default=1, help="seed of the candidate sampling")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="parallel processes")
+    parser.add_argument("--ns3-dir", default=".", help="root of the ns-3 tree")
+    parser.add_argument("--binary", help="built program to run instead of ./ns3 run")
+    args = parser.parse_args(argv[1:])
+
+    if args.eta <= 1:
+        parser.error("--eta must be greater than 1")
+    fixed = {}
+    for item in args.param:
+        name, _, value = item.partition("=")
+        fixed[name] = value
+    space = {}
+    for algorithm in args.algorithms.split(","):
+        if algorithm == "a2a4":
+            space[A2A4] = {
+                "servingCellThreshold": handover_jobs.parse_values(args.serving_cell_threshold),
+                "neighbourCellOffset": handover_jobs.parse_values(args.neighbour_cell_offset),
+            }
+        elif algorithm == "a3":
+            space[A3] = {
+                "hysteresis": handover_jobs.parse_values(args.hysteresis),
+                "timeToTrigger": handover_jobs.parse_values(args.time_to_trigger),
+            }
+        else:
+            parser.error("unknown algorithm %s" % algorithm)
+    objective = parse_objective(args.objective)
+
+    candidates = sample_candidates(space, args.candidates, random.Random(args.seed))
+    min_time = args.min_time
+    if not args.no_prescreen:
+        first = [t for t in first_handovers(candidates, fixed, args) if t is not None]
+        print(
+            "Pre-screen: %d of %d candidates hand over, the last first handover at %s"
+            % (len(first), len(candidates), "%g s" % max(first) if first else "-")
+        )
+        if first:
+            min_time = min(max(min_time, max(first) + args.prescreen_margin), args.max_time)
+    times = rung_times(min_time, args.max_time, args.eta, len(candidates))
+    alive = list(range(len(candidates)))
+    trials = []
+    runs_done = 0
+    scores = {}
+    for rung, sim_time in enumerate(times):
+        jobs = []
+        for c in alive:
+            for run in range(1, args.runs + 1):
+                params = dict(fixed)
+                params.update(candidates[c])
+                params["simTime"] = sim_time
+                params["RngRun"] = run
+                name = "rung%d/c%04d-run%d" % (rung, c, run)
+                jobs.append(handover_jobs.Job(name, args.program, params, args.output))
+        print(
+            "Rung %d: %d candidates x %d runs, simTime %g s"
+            % (rung, len(alive), args.runs, sim_time)
+        )
+        sys.stdout.flush()
+        totals = {c: [] for c in alive}
+        for result in handover_jobs.run_jobs(jobs, args.jobs, args.ns3_dir, args.binary):
+            c = int(result["job"].split("/c")[1].split("-")[0])
+            value = score(result, objective)
+            totals[c].append(value)
+            result["rung"] = rung
+            result["candidate"] = c
+            result["score"] = value
+            trials.append(result)
+        runs_done += len(jobs)
+        scores = {c: sum(v) / len(v) for c, v in totals.items()}
+        alive.sort(key=lambda c: scores[c], reverse=True)
+        for c in alive[:3]:
+            print("  %.4g  c%04d %s" % (scores[c], c, describe(candidates[c])))
+        if rung + 1 < len(times):
+            alive = alive[: max(1, math.ceil(len(alive) / args.eta))]
+
+    os.makedirs(args.output, exist_ok=True)
+    trials.sort(key=lambda r: r["job"])
+    handover_jobs.write_table(trials, os.path.join(args.output, "tuner-trials.csv"))
+    best = alive[0]
+    if scores[best] == -math.inf:
+        print("No candidate completed the last rung")
+        return 1
+    best_params = dict(fixed)
+    best_params.update(candidates[best])
+    best_params["simTime"] = times[-1]
+    line = " ".join("--%s=%s" % (k, v) for k, v in best_params.items())
+    with open(os.path.join(args.output, "best-config.txt"), "w", encoding="utf-8") as f:
+        f.write("# score %.6g after %d runs\n" % (scores[best], runs_done))
+        f.write(line + "\n")
+    # cost in runs of the full simTime, against every candidate run to the end
+    equivalent = sum(float(r["simTime"]) for r in trials) / times[-1]
+    print(
+        "Best: c%04d %s (score %.6g), cost %.1f full runs instead of %d"
+        % (best, describe(candidates[best]), scores[best], equivalent, len(candidates) * args.runs)
+    )
+    print(line)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
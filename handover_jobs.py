@@ -0,0 +1,182 @@
+"""! Helpers shared by the sweep tools of the handover scenarios.
+
+A job is one run of nr-handover or ex005 with its own output directory. Jobs are
+started as independent processes (either through ./ns3 run or straight from the
+built binary), at most N at a time, and each one leaves a summary.csv written
+by RunSummary in its directory.
+"""
+
+import concurrent.futures
+import csv
+import itertools
+import os
+import subprocess
+import time
+
+
+## Job
+class Job(object):
+    ## class variables
+    ## @var name
+    #  unique name, also the name of the output directory
+    ## @var program
+    #  scratch program (nr-handover or ex005)
+    ## @var params
+    #  dict of command line values passed as --key=value
+    ## @var outdir
+    #  absolute output directory of the run
+    __slots__ = ["name", "program", "params", "outdir"]
+
+    def __init__(self, name, program, params, root):
+        """! The initializer.
+        @param self The object pointer.
+        @param name Job name.
+        @param program Scratch program name.
+        @param params Dict of command line values.
+        @param root Directory where the job directory is created.
+        """
+        self.name = name
+        self.program = program
+        self.params = dict(params)
+        self.outdir = os.path.abspath(os.path.join(root, name))
+
+    def arguments(self):
+        """! Command line arguments of the program, including --outputDir."""
+        args = ["--%s=%s" % (k, v) for k, v in self.params.items()]
+        args.append("--outputDir=%s" % self.outdir)
+        return args
+
+
+def _numbers(parts):
+    """! The parts as floats, or None if one of them is not a number."""
+    try:
+        return [float(p) for p in parts]
+    except ValueError:
+        return None
+
+
+def parse_values(text):
+    """! Expand "a,b,c" or a numeric range "start:stop[:step]" (stop included).
+
+    A value with ':' that is not two or three numbers, such as a TypeId name, is kept
+    as a literal.
+    """
+    parts = _numbers(text.split(":")) if "," not in text else None
+    if parts is not None and len(parts) in (2, 3):
+        start, stop = parts[0], parts[1]
+        step = parts[2] if len(parts) > 2 else 1.0
+        if step <= 0:
+            raise ValueError("range %s needs a positive step" % text)
+        values = []
+        v = start
+        while v <= stop + 1e-9:
+            values.append(int(v) if float(v).is_integer() else round(v, 9))
+            v += step
+        return values
+    return [v for v in text.split(",") if v != ""]
+
+
+def expand_grid(grid):
+    """! Cartesian product of a dict name -> list of values, as a list of dicts."""
+    names = list(grid.keys())
+    return [dict(zip(names, combo)) for combo in itertools.product(*(grid[n] for n in names))]
+
+
+def command(job, ns3_dir, binary=None):
+    """! Command line that runs a job.
+    @param job The job.
+    @param ns3_dir Root of the ns-3 tree, used when no binary is given.
+    @param binary Path of the built program; skips the ns3 wrapper.
+    """
+    if binary:
+        return [binary] + job.arguments()
+    return [
+        os.path.join(ns3_dir, "ns3"),
+        "run",
+        "--no-build",
+        "--cwd=%s" % job.outdir,
+        "scratch/%s %s" % (job.program, " ".join(job.arguments())),
+    ]
+
+
+def read_summary(path):
+    """! Read the two-line CSV written by RunSummary, or None if it is missing."""
+    if not os.path.exists(path):
+        return None
+    with open(path, newline="", encoding="utf-8") as f:
+        rows = list(csv.reader(f))
+    if len(rows) < 2:
+        return None
+    return dict(zip(rows[0], rows[1]))
+
+
+def run_job(job, ns3_dir, binary=None):
+    """! Run one job to completion in its own directory.
+
+    The program runs with the job directory as working directory, so the NR text
+    traces of concurrent jobs cannot overwrite each other.
+    @return dict with the job name, exit code, wall time, peak RSS and summary fields
+    """
+    os.makedirs(job.outdir, exist_ok=True)
+    # a summary left by an earlier run of the same job must not pass for this one
+    summary_path = os.path.join(job.outdir, "summary.csv")
+    if os.path.exists(summary_path):
+        os.remove(summary_path)
+    start = time.monotonic()
+    with open(os.path.join(job.outdir, "stdout.log"), "wb") as log:
+        proc = subprocess.Popen(
+            command(job, ns3_dir, binary), cwd=job.outdir, stdout=log, stderr=subprocess.STDOUT
+        )
+        # wait4 also reports the peak RSS of the program started by ./ns3 run
+        _, status, usage = os.wait4(proc.pid, 0)
+        proc.returncode = os.waitstatus_to_exitcode(status)
+    result = {
+        "job": job.name,
+        "returncode": proc.returncode,
+        "wallSeconds": "%.3f" % (time.monotonic() - start),
+        "peakRssKb": usage.ru_maxrss,
+    }
+    for k, v in job.params.items():
+        result[k] = v
+    summary = read_summary(summary_path)
+    result["status"] = "ok" if proc.returncode == 0 and summary is not None else "failed"
+    result.update(summary or {})
+    return result
+
+
+def run_jobs(jobs, workers, ns3_dir, binary=None):
+    """! Run jobs on a bounded pool of worker processes.
+
+    At most 2 * workers jobs are queued at any time, so a large grid does not
+    create all its futures up front.
+    @return generator of run_job results, in completion order
+    """
+    pending = set()
+    jobs = iter(jobs)
+    with concurrent.futures.ThreadPoolExecutor(max_workers=workers) as pool:
+        while True:
+            for job in jobs:
+                pending.add(pool.submit(run_job, job, ns3_dir, binary))
+                if len(pending) >= 2 * workers:
+                    break
+            if not pending:
+                return
+            done, pending = concurrent.futures.wait(
+                pending, return_when=concurrent.futures.FIRST_COMPLETED
+            )
+            for future in done:
+                yield future.result()
+
+
+def write_table(rows, path):
+    """! Write dicts as CSV, with the union of their keys in order of first appearance."""
+    columns = []
+    for row in rows:
+        for k in row:
+            if k not in columns:
+                columns.append(k)
+    with open(path, "w", newline="", encoding="utf-8") as f:
+        writer = csv.DictWriter(f, fieldnames=columns, restval="")
+        writer.writeheader()
+        for row in rows:
+            writer.writerow(row)
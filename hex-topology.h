@@ -0,0 +1,180 @@
+#ifndef HEX_TOPOLOGY_H
+#define HEX_TOPOLOGY_H
+
+/**
+ * @file hex-topology.h
+ * @brief Hexagonal multi-cell layout with UE drop and neighbour X2 pairs.
+ *
+ * Sites are laid out in N rings around a central site (1, 7, 19, 37, ... sites) at a
+ * given inter-site distance; each site has 1 or 3 sectors (cells) pointing at 30,
+ * 150 and 270 degrees. UEs are dropped uniformly over the hexagons of the sites.
+ * Neighbour cells for X2 are found with a uniform grid of bucket size ISD, so only
+ * the sites in the 3x3 surrounding buckets are compared instead of all pairs.
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+
+#include <cmath>
+#include <cstdint>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+class HexTopology
+{
+  public:
+    /**
+     * @brief Build the site layout.
+     * @param rings number of rings around the central site (0 gives a single site)
+     * @param isd inter-site distance in meters
+     * @param sectors cells per site, 1 (omni) or 3
+     */
+    HexTopology(uint32_t rings, double isd, uint32_t sectors)
+        : m_isd(isd),
+          m_sectors(sectors)
+    {
+        NS_ABORT_MSG_UNLESS(sectors == 1 || sectors == 3, "Sites have 1 or 3 sectors");
+        const int n = rings;
+        // axial hex coordinates (q, r) with |q|, |r|, |q + r| <= rings
+        for (int q = -n; q <= n; ++q)
+        {
+            for (int r = std::max(-n, -q - n); r <= std::min(n, -q + n); ++r)
+            {
+                m_sites.emplace_back(isd * (q + r / 2.0), isd * r * std::sqrt(3.0) / 2, 0);
+            }
+        }
+    }
+
+    /// @return number of sites, 1 + 3 rings (rings + 1)
+    uint32_t GetNumSites() const
+    {
+        return m_sites.size();
+    }
+
+    /// @return number of cells, one gNB each
+    uint32_t GetNumCells() const
+    {
+        return m_sites.size() * m_sectors;
+    }
+
+    /// @return position of a cell (the position of its site) at the given height
+    Vector GetCellPosition(uint32_t cell, double height) const
+    {
+        Vector pos = m_sites.at(cell / m_sectors);
+        pos.z = height;
+        return pos;
+    }
+
+    /// @return boresight of a cell in radians, 0 for omni sites
+    double GetCellBearing(uint32_t cell) const
+    {
+        return m_sectors == 1 ? 0.0 : (30.0 + 120.0 * (cell % m_sectors)) * M_PI / 180.0;
+    }
+
+    /// @return covered area in square meters (one hexagon of inradius ISD/2 per site)
+    double GetArea() const
+    {
+        return m_sites.size() * std::sqrt(3.0) / 2 * m_isd * m_isd;
+    }
+
+    /**
+     * @brief Draw a position uniformly over the hexagons of the sites.
+     * @param rng uniform random variable used for the draw
+     * @param height the UE height
+     */
+    Vector GetRandomPosition(Ptr<UniformRandomVariable> rng, double height) const
+    {
+        const Vector& site = m_sites.at(rng->GetInteger(0, m_sites.size() - 1));
+        const double a = m_isd / 2; // inradius
+        const double b = a * 2 / std::sqrt(3.0); // circumradius
+        while (true)
+        {
+            double x = rng->GetValue(-a, a);
+            double y = rng->GetValue(-b, b);
+            if (std::abs(x) / 2 + std::abs(y) * std::sqrt(3.0) / 2 <= a)
+            {
+                return Vector(site.x + x, site.y + y, height);
+            }
+        }
+    }
+
+    /**
+     * @brief Cell pairs that need an X2 interface.
+     *
+     * All sectors of a site are linked with each other and with every sector of the
+     * adjacent sites (distance ISD).
+     * @return pairs (a, b) of cell indices with a < b
+     */
+    std::vector<std::pair<uint32_t, uint32_t>> GetNeighbourCellPairs() const
+    {
+        std::map<std::pair<int64_t, int64_t>, std::vector<uint32_t>> grid;
+        for (uint32_t s = 0; s < m_sites.size(); ++s)
+        {
+            grid[Bucket(m_sites[s])].push_back(s);
+        }
+        std::vector<std::pair<uint32_t, uint32_t>> sitePairs;
+        for (uint32_t s = 0; s < m_sites.size(); ++s)
+        {
+            auto [bx, by] = Bucket(m_sites[s]);
+            for (int64_t dx = -1; dx <= 1; ++dx)
+            {
+                for (int64_t dy = -1; dy <= 1; ++dy)
+                {
+                    auto it = grid.find({bx + dx, by + dy});
+                    if (it == grid.end())
+                    {
+                        continue;
+                    }
+                    for (uint32_t t : it->second)
+                    {
+                        if (t > s && CalculateDistance(m_sites[s], m_sites[t]) < 1.01 * m_isd)
+                        {
+                            sitePairs.emplace_back(s, t);
+                        }
+                    }
+                }
+            }
+        }
+        std::vector<std::pair<uint32_t, uint32_t>> pairs;
+        for (uint32_t s = 0; s < m_sites.size(); ++s)
+        {
+            for (uint32_t i = 0; i < m_sectors; ++i)
+            {
+                for (uint32_t j = i + 1; j < m_sectors; ++j)
+                {
+                    pairs.emplace_back(s * m_sectors + i, s * m_sectors + j);
+                }
+            }
+        }
+        for (const auto& [s, t] : sitePairs)
+        {
+            for (uint32_t i = 0; i < m_sectors; ++i)
+            {
+                for (uint32_t j = 0; j < m_sectors; ++j)
+                {
+                    pairs.emplace_back(s * m_sectors + i, t * m_sectors + j);
+                }
+            }
+        }
+        return pairs;
+    }
+
+  private:
+    std::pair<int64_t, int64_t> Bucket(const Vector& pos) const
+    {
+        return {static_cast<int64_t>(std::floor(pos.x / m_isd)),
+                static_cast<int64_t>(std::floor(pos.y / m_isd))};
+    }
+
+    std::vector<Vector> m_sites; //!< Site positions, z = 0
+    double m_isd;                //!< Inter-site distance
+    uint32_t m_sectors;          //!< Cells per site
+};
+
+} // namespace ns3
+
+#endif // HEX_TOPOLOGY_H
@@ -0,0 +1,424 @@
+#ifndef INSTRUMENTED_SCHEDULER_H
+#define INSTRUMENTED_SCHEDULER_H
+
+/**
+ * @file instrumented-scheduler.h
+ * @brief Event schedulers that count the pending events and profile the executed ones.
+ *
+ * The simulator does not expose the size of its event list. CountingMapScheduler is the
+ * default MapScheduler with a counter kept on insert and removal; cancelled events stay
+ * in the list (and in the count) until their time comes, as they do in memory.
+ *
+ * ProfilingMapScheduler also times the events. The simulator asks the scheduler for
+ * the next event right after running the previous one, so the steady clock time
+ * between two RemoveNext calls is the run time of the previous event. Events are
+ * classified once per event type by the demangled name of their EventImpl, which
+ * names the class of the scheduled member function (NrGnbPhy, NrMacSchedulerNs3, ...).
+ *
+ * The fast fading of the 3GPP channel, with the channel matrices it generates on
+ * demand, runs synchronously inside the PHY transmissions (SpectrumChannel::StartTx),
+ * so by event type it is charged to PHY. TimeChannel puts timing markers around the
+ * spectrum propagation loss chain of a channel; that time then moves from the events
+ * it ran in to the channel category. The pathloss of the PropagationLossModel, also
+ * computed in StartTx, stays with the PHY events.
+ *
+ * Install either before the simulation starts; the events already scheduled are moved
+ * over. Simulator::Destroy drops the scheduler, so a process running several simulations
+ * calls Reset after each one.
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/map-scheduler.h"
+#include "ns3/spectrum-module.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cxxabi.h>
+#include <iomanip>
+#include <ostream>
+#include <string>
+#include <typeinfo>
+#include <unordered_map>
+#include <vector>
+
+namespace ns3
+{
+
+class CountingMapScheduler : public MapScheduler
+{
+  public:
+    static TypeId GetTypeId()
+    {
+        static TypeId tid = TypeId("ns3::CountingMapScheduler")
+                                .SetParent<MapScheduler>()
+                                .AddConstructor<CountingMapScheduler>();
+        return tid;
+    }
+
+    /// @brief Make this the scheduler of the simulator.
+    static void Install()
+    {
+        ObjectFactory factory;
+        factory.SetTypeId(CountingMapScheduler::GetTypeId());
+        Simulator::SetScheduler(factory);
+        s_installed = true;
+    }
+
+    /// @return whether Install was called
+    static bool IsInstalled()
+    {
+        return s_installed;
+    }
+
+    /// @brief Forget the installation and the count, after Simulator::Destroy.
+    static void Reset()
+    {
+        s_pending = 0;
+        s_installed = false;
+    }
+
+    /// @return events in the list, including cancelled ones
+    static uint64_t GetPending()
+    {
+        return s_pending;
+    }
+
+    void Insert(const Event& ev) override
+    {
+        MapScheduler::Insert(ev);
+        ++s_pending;
+    }
+
+    Event RemoveNext() override
+    {
+        --s_pending;
+        return MapScheduler::RemoveNext();
+    }
+
+    void Remove(const Event& ev) override
+    {
+        MapScheduler::Remove(ev);
+        --s_pending;
+    }
+
+  protected:
+    static inline uint64_t s_pending{0};   //!< Events in the list
+    static inline bool s_installed{false}; //!< Set by Install
+};
+
+class ProfilingMapScheduler : public CountingMapScheduler
+{
+  public:
+    /// Event categories of the histogram
+    enum Category
+    {
+        CHANNEL,     //!< channel matrices, spectrum propagation, beamforming
+        PHY,         //!< PHY slots and symbols
+        MAC,         //!< MAC and schedulers
+        RLC_PDCP,    //!< RLC and PDCP
+        RRC_EPC,     //!< RRC, handover, X2 and core network
+        NETWORK,     //!< IP, UDP and point-to-point links
+        APPLICATION, //!< traffic sources and sinks
+        TRACING,     //!< recorders and samplers of these programs
+        OTHER,       //!< anything else (plain function events, Simulator::Stop)
+        CATEGORIES
+    };
+
+    static TypeId GetTypeId()
+    {
+        static TypeId tid = TypeId("ns3::ProfilingMapScheduler")
+                                .SetParent<CountingMapScheduler>()
+                                .AddConstructor<ProfilingMapScheduler>();
+        return tid;
+    }
+
+    /// @brief Make this the scheduler of the simulator.
+    static void Install()
+    {
+        ObjectFactory factory;
+        factory.SetTypeId(ProfilingMapScheduler::GetTypeId());
+        Simulator::SetScheduler(factory);
+        s_installed = true;
+    }
+
+    /// @brief Forget the installation and the profile, after Simulator::Destroy.
+    static void Reset()
+    {
+        CountingMapScheduler::Reset();
+        s_types.clear();
+        s_current = nullptr;
+        s_channel = Stats();
+        s_channelInEvent = 0;
+    }
+
+    /**
+     * @brief Time the spectrum propagation loss chain of a channel apart from its events.
+     * @param channel a channel whose 3GPP spectrum model is set, timed at most once
+     */
+    static void TimeChannel(Ptr<SpectrumChannel> channel);
+
+    /// @brief Called by the marker at the head of a timed chain.
+    static void ChannelStart()
+    {
+        s_channelStarted = std::chrono::steady_clock::now();
+    }
+
+    /// @brief Called by the marker at the end of a timed chain.
+    static void ChannelEnd()
+    {
+        const uint64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+                                std::chrono::steady_clock::now() - s_channelStarted)
+                                .count();
+        s_channel.nanoseconds += ns;
+        ++s_channel.count;
+        s_channelInEvent += ns;
+    }
+
+    /// @return name of a category
+    static const char* GetCategoryName(Category category)
+    {
+        static const char* names[] = {"channel/spectrum",
+                                      "PHY",
+                                      "MAC/scheduler",
+                                      "RLC/PDCP",
+                                      "RRC/EPC",
+                                      "IP/UDP/links",
+                                      "application",
+                                      "tracing",
+                                      "other"};
+        return names[category];
+    }
+
+    Event RemoveNext() override
+    {
+        Event ev = CountingMapScheduler::RemoveNext();
+        auto now = std::chrono::steady_clock::now();
+        if (s_current)
+        {
+            const uint64_t ns =
+                std::chrono::duration_cast<std::chrono::nanoseconds>(now - s_started).count();
+            // the timed channel calls of the event are in s_channel
+            s_current->nanoseconds += ns > s_channelInEvent ? ns - s_channelInEvent : 0;
+            ++s_current->count;
+        }
+        s_channelInEvent = 0;
+        s_current = &Lookup(typeid(*ev.impl));
+        s_started = now;
+        return ev;
+    }
+
+    /**
+     * @brief Print the categories ranked by wall time, then the most expensive event types.
+     * @param os output stream
+     * @param topTypes number of event types listed
+     */
+    static void Report(std::ostream& os, std::size_t topTypes = 15)
+    {
+        double total = 0;
+        Stats categories[CATEGORIES];
+        std::vector<const Stats*> types;
+        for (const auto& [type, stats] : s_types)
+        {
+            categories[stats.category].nanoseconds += stats.nanoseconds;
+            categories[stats.category].count += stats.count;
+            total += stats.nanoseconds;
+            types.push_back(&stats);
+        }
+        if (s_channel.count > 0)
+        {
+            categories[CHANNEL].nanoseconds += s_channel.nanoseconds;
+            categories[CHANNEL].count += s_channel.count;
+            total += s_channel.nanoseconds;
+            types.push_back(&s_channel);
+        }
+        std::vector<int> order;
+        for (int c = 0; c < CATEGORIES; ++c)
+        {
+            order.push_back(c);
+        }
+        std::sort(order.begin(), order.end(), [&categories](int a, int b) {
+            return categories[a].nanoseconds > categories[b].nanoseconds;
+        });
+        std::sort(types.begin(), types.end(), [](const Stats* a, const Stats* b) {
+            return a->nanoseconds > b->nanoseconds;
+        });
+
+        os << "Event profile (" << total * 1e-9 << " s in events)\n";
+        if (s_channel.count == 0)
+        {
+            os << "(channel matrices and fast fading are not timed apart: they run inside, "
+                  "and are counted with, the PHY events)\n";
+        }
+        if (total <= 0)
+        {
+            return;
+        }
+        os << std::left << std::setw(18) << "category" << std::right << std::setw(12) << "seconds"
+           << std::setw(8) << "%" << std::setw(14) << "events" << std::setw(10) << "ns/event"
+           << "\n";
+        for (int c : order)
+        {
+            const Stats& s = categories[c];
+            if (s.count == 0)
+            {
+                continue;
+            }
+            os << std::left << std::setw(18) << GetCategoryName(Category(c)) << std::right
+               << std::fixed << std::setprecision(3) << std::setw(12) << s.nanoseconds * 1e-9
+               << std::setprecision(1) << std::setw(8) << 100 * s.nanoseconds / total
+               << std::setw(14) << s.count << std::setprecision(0) << std::setw(10)
+               << double(s.nanoseconds) / s.count << "\n";
+        }
+        os << "Top event types\n";
+        for (std::size_t i = 0; i < std::min(topTypes, types.size()); ++i)
+        {
+            const Stats* s = types[i];
+            os << std::fixed << std::setprecision(3) << std::setw(10) << s->nanoseconds * 1e-9
+               << " s " << std::setw(12) << s->count << "  " << s->name << "\n";
+        }
+        os << std::defaultfloat;
+    }
+
+  private:
+    /// Run time and count of one event type (or category)
+    struct Stats
+    {
+        std::string name;
+        Category category{OTHER};
+        uint64_t nanoseconds{0};
+        uint64_t count{0};
+    };
+
+    static Stats& Lookup(const std::type_info& type)
+    {
+        auto it = s_types.find(&type);
+        if (it != s_types.end())
+        {
+            return it->second;
+        }
+        Stats& stats = s_types[&type];
+        int status = 0;
+        char* demangled = abi::__cxa_demangle(type.name(), nullptr, nullptr, &status);
+        stats.name = status == 0 ? demangled : type.name();
+        std::free(demangled);
+        stats.category = Classify(stats.name);
+        return stats;
+    }
+
+    /// The first matching group wins: NrSpectrumPhy is channel work, UdpClient an application
+    static Category Classify(const std::string& name)
+    {
+        static const std::vector<std::pair<Category, std::vector<const char*>>> keywords = {
+            {CHANNEL,
+             {"ChannelModel", "SpectrumChannel", "SpectrumPropagation", "SpectrumPhy",
+              "PropagationLoss", "ChannelCondition", "Beamforming", "Interference"}},
+            {PHY, {"Phy"}},
+            {MAC, {"Mac"}},
+            {RLC_PDCP, {"Rlc", "Pdcp"}},
+            {RRC_EPC, {"Rrc", "Handover", "X2", "Epc", "Pgw", "Sgw", "Mme", "Gtpu"}},
+            {APPLICATION, {"Application", "Client", "Server", "PacketSink"}},
+            {NETWORK, {"Ipv4", "Udp", "Tcp", "PointToPoint", "Arp", "Socket", "Queue"}},
+            {TRACING,
+             {"Recorder", "Sampler", "EventLog", "TraceOutput", "FlowMonitor", "Telemetry"}},
+        };
+        for (const auto& [category, words] : keywords)
+        {
+            for (const char* word : words)
+            {
+                if (name.find(word) != std::string::npos)
+                {
+                    return category;
+                }
+            }
+        }
+        return OTHER;
+    }
+
+    static inline std::unordered_map<const std::type_info*, Stats> s_types; //!< Per event type
+    static inline Stats* s_current{nullptr};                                //!< Event being run
+    static inline std::chrono::steady_clock::time_point s_started;          //!< Start of s_current
+    static Stats s_channel;                                                 //!< Timed channel calls
+    static inline uint64_t s_channelInEvent{0};                             //!< Of it in s_current
+    static inline std::chrono::steady_clock::time_point s_channelStarted;   //!< Timed call start
+};
+
+inline ProfilingMapScheduler::Stats ProfilingMapScheduler::s_channel;
+
+/**
+ * Pass-through spectrum propagation loss model marking the start (head of the chain) or
+ * the end (tail) of the loss computation of a channel for ProfilingMapScheduler.
+ */
+class ChannelTimingMarker : public PhasedArraySpectrumPropagationLossModel
+{
+  public:
+    static TypeId GetTypeId()
+    {
+        static TypeId tid = TypeId("ns3::ChannelTimingMarker")
+                                .SetParent<PhasedArraySpectrumPropagationLossModel>()
+                                .AddConstructor<ChannelTimingMarker>();
+        return tid;
+    }
+
+    /// @brief Mark the end of the chain instead of its start.
+    void SetEnd(bool end)
+    {
+        m_end = end;
+    }
+
+  private:
+    Ptr<SpectrumSignalParameters> DoCalcRxPowerSpectralDensity(
+        Ptr<const SpectrumSignalParameters> params,
+        Ptr<const MobilityModel> a,
+        Ptr<const MobilityModel> b,
+        Ptr<const PhasedArrayModel> aPhasedArrayModel,
+        Ptr<const PhasedArrayModel> bPhasedArrayModel) const override
+    {
+        if (m_end)
+        {
+            ProfilingMapScheduler::ChannelEnd();
+        }
+        else
+        {
+            ProfilingMapScheduler::ChannelStart();
+        }
+        // the channel passes its own copy of the parameters, hand it on unchanged
+        return ConstCast<SpectrumSignalParameters>(params);
+    }
+
+    int64_t DoAssignStreams(int64_t stream) override
+    {
+        return 0;
+    }
+
+    bool m_end{false}; //!< Marks the end of the chain
+};
+
+inline void
+ProfilingMapScheduler::TimeChannel(Ptr<SpectrumChannel> channel)
+{
+    Ptr<PhasedArraySpectrumPropagationLossModel> model =
+        channel->GetPhasedArraySpectrumPropagationLossModel();
+    NS_ABORT_MSG_UNLESS(model, "The channel has no spectrum propagation loss model to time");
+    if (DynamicCast<ChannelTimingMarker>(model))
+    {
+        return;
+    }
+    // the chain becomes: start marker -> 3GPP model (-> its next ones) -> end marker
+    Ptr<PhasedArraySpectrumPropagationLossModel> last = model;
+    while (last->GetNext())
+    {
+        last = last->GetNext();
+    }
+    s_channel.name = "3GPP spectrum propagation loss (timed inside the PHY events)";
+    s_channel.category = CHANNEL;
+    Ptr<ChannelTimingMarker> end = CreateObject<ChannelTimingMarker>();
+    end->SetEnd(true);
+    last->SetNext(end);
+    channel->AddPhasedArraySpectrumPropagationLossModel(CreateObject<ChannelTimingMarker>());
+}
+
+} // namespace ns3
+
+#endif // INSTRUMENTED_SCHEDULER_H
@@ -0,0 +1,241 @@
+#ifndef KPI_CONVERGENCE_H
+#define KPI_CONVERGENCE_H
+
+/**
+ * @file kpi-convergence.h
+ * @brief Stop a run once the downlink throughput and delay have stabilised.
+ *
+ * The run is cut into batches of fixed length. At the end of every batch the monitor
+ * reads the cumulative FlowMonitor counters of the data flows and keeps the batch
+ * throughput and mean delay. After the minimum number of batches it computes the
+ * 95% confidence interval of the mean of each KPI over the batch means, and stops the
+ * simulator when both half-widths are within the relative precision of their means and
+ * the handover KPI engine has measured the required number of interruptions. Without
+ * the last condition a run converges on the throughput before the UE reaches the cell
+ * edge and reports no handover at all.
+ *
+ * The first batch holds the start of the applications and is left out of the means.
+ * Batch means of a few hundred ms are close to independent for these scenarios;
+ * longer batches are safer with slow mobility.
+ */
+
+#include "handover-kpi.h"
+#include "run-summary.h"
+
+#include "ns3/core-module.h"
+#include "ns3/flow-monitor-module.h"
+#include "ns3/internet-module.h"
+
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+namespace ns3
+{
+
+class KpiConvergence
+{
+  public:
+    /// @brief Set the length of a batch (default 200 ms).
+    void SetBatch(Time batch)
+    {
+        NS_ABORT_MSG_UNLESS(batch.IsStrictlyPositive(), "The early stop batch must be positive");
+        m_batch = batch;
+    }
+
+    /// @brief Set the relative half-width of the confidence intervals to reach (default 0.05).
+    void SetPrecision(double precision)
+    {
+        m_precision = precision;
+    }
+
+    /// @brief Set the batches kept before the first test (default 10).
+    void SetMinBatches(uint32_t batches)
+    {
+        NS_ABORT_MSG_IF(batches < 2, "A confidence interval needs at least 2 batches");
+        m_minBatches = batches;
+    }
+
+    /**
+     * @brief Only stop once handovers have been measured.
+     * @param kpis engine counting the handover interruptions, must outlive the run
+     * @param interruptions interruptions measured before a stop, over all UEs (default 1)
+     */
+    void SetHandoverKpis(const HandoverKpiEngine* kpis, uint64_t interruptions)
+    {
+        m_kpis = kpis;
+        m_minInterruptions = interruptions;
+    }
+
+    /**
+     * @brief Set the flows the KPIs are computed on.
+     * @param monitor the monitor returned by FlowMonitorHelper::InstallAll
+     * @param classifier the classifier of the same helper
+     * @param port destination port of the data flows
+     */
+    void SetFlowMonitor(Ptr<FlowMonitor> monitor,
+                        Ptr<Ipv4FlowClassifier> classifier,
+                        uint16_t port)
+    {
+        m_monitor = monitor;
+        m_classifier = classifier;
+        m_port = port;
+    }
+
+    /// @brief Start the first batch, normally at the start of the applications.
+    void Start(Time start)
+    {
+        NS_ABORT_MSG_UNLESS(m_monitor, "KpiConvergence needs SetFlowMonitor before Start");
+        NS_ABORT_MSG_IF(m_minInterruptions > 0 && !m_kpis,
+                        "KpiConvergence needs SetHandoverKpis to wait for handovers");
+        m_event = Simulator::Schedule(start + m_batch - Simulator::Now(),
+                                      &KpiConvergence::EndBatch,
+                                      this);
+    }
+
+    /// @return true if the simulator was stopped because the KPIs converged
+    bool HasConverged() const
+    {
+        return m_converged;
+    }
+
+    /**
+     * @brief Add the stop time and the batch-means intervals to a summary.
+     * @param summary run summary receiving the convergence fields
+     */
+    void AddToSummary(RunSummary& summary) const
+    {
+        double mean = 0;
+        double halfWidth = 0;
+        summary.Set("earlyStopped", m_converged ? 1 : 0);
+        summary.Set("stopTime", Simulator::Now().GetSeconds());
+        summary.Set("kpiBatches", m_throughput.size());
+        Interval(m_throughput, mean, halfWidth);
+        summary.Set("batchThroughputMbps", mean);
+        summary.Set("batchThroughputHalfWidth", halfWidth);
+        Interval(m_delay, mean, halfWidth);
+        summary.Set("batchDelayMs", mean * 1e3);
+        summary.Set("batchDelayHalfWidthMs", halfWidth * 1e3);
+    }
+
+  private:
+    /// Sum the counters of the data flows and keep the means of the batch just ended
+    void EndBatch()
+    {
+        uint64_t rxBytes = 0;
+        uint64_t rxPackets = 0;
+        double delaySum = 0;
+        for (const auto& entry : m_monitor->GetFlowStats())
+        {
+            if (m_classifier->FindFlow(entry.first).destinationPort != m_port)
+            {
+                continue;
+            }
+            rxBytes += entry.second.rxBytes;
+            rxPackets += entry.second.rxPackets;
+            delaySum += entry.second.delaySum.GetSeconds();
+        }
+        if (m_batches++ > 0)
+        {
+            m_throughput.push_back((rxBytes - m_rxBytes) * 8e-6 / m_batch.GetSeconds());
+            if (rxPackets > m_rxPackets)
+            {
+                m_delay.push_back((delaySum - m_delaySum) / (rxPackets - m_rxPackets));
+            }
+        }
+        m_rxBytes = rxBytes;
+        m_rxPackets = rxPackets;
+        m_delaySum = delaySum;
+
+        const uint64_t interruptions = m_kpis ? m_kpis->GetInterruptions() : 0;
+        if (m_throughput.size() >= m_minBatches && interruptions >= m_minInterruptions &&
+            Converged(m_throughput) && Converged(m_delay))
+        {
+            m_converged = true;
+            std::cout << "KPIs converged after " << m_throughput.size() << " batches and "
+                      << interruptions << " interruptions, stopping at "
+                      << Simulator::Now().GetSeconds() << " s" << std::endl;
+            Simulator::Stop();
+            return;
+        }
+        m_event = Simulator::Schedule(m_batch, &KpiConvergence::EndBatch, this);
+    }
+
+    bool Converged(const std::vector<double>& values) const
+    {
+        double mean = 0;
+        double halfWidth = 0;
+        if (values.size() < m_minBatches)
+        {
+            return false;
+        }
+        Interval(values, mean, halfWidth);
+        return halfWidth <= m_precision * std::abs(mean);
+    }
+
+    /// Mean and half-width of the 95% confidence interval of the mean
+    static void Interval(const std::vector<double>& values, double& mean, double& halfWidth)
+    {
+        mean = 0;
+        halfWidth = 0;
+        if (values.empty())
+        {
+            return;
+        }
+        for (double v : values)
+        {
+            mean += v;
+        }
+        mean /= values.size();
+        if (values.size() < 2)
+        {
+            return;
+        }
+        double squares = 0;
+        for (double v : values)
+        {
+            squares += (v - mean) * (v - mean);
+        }
+        const std::size_t n = values.size();
+        halfWidth = StudentT975(n - 1) * std::sqrt(squares / (n - 1) / n);
+    }
+
+    /// 0.975 quantile of the Student t distribution
+    static double StudentT975(std::size_t dof)
+    {
+        static const double table[] = {12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365,
+                                       2.306,  2.262, 2.228, 2.201, 2.179, 2.160, 2.145,
+                                       2.131,  2.120, 2.110, 2.101, 2.093, 2.086, 2.080,
+                                       2.074,  2.069, 2.064, 2.060, 2.056, 2.052, 2.048,
+                                       2.045,  2.042};
+        if (dof <= 30)
+        {
+            return table[dof - 1];
+        }
+        // first Cornish-Fisher term, within 0.001 beyond 30 degrees of freedom
+        const double z = 1.959964;
+        return z + (z * z * z + z) / (4.0 * dof);
+    }
+
+    Ptr<FlowMonitor> m_monitor;               //!< Source of the rx counters
+    Ptr<Ipv4FlowClassifier> m_classifier;     //!< Maps flow ids to 5-tuples
+    const HandoverKpiEngine* m_kpis{nullptr}; //!< Source of the interruption count
+    uint64_t m_minInterruptions{1};           //!< Interruptions measured before a stop
+    uint16_t m_port{0};                       //!< Destination port of the data flows
+    Time m_batch{MilliSeconds(200)};          //!< Batch length
+    double m_precision{0.05};                 //!< Relative half-width to reach
+    uint32_t m_minBatches{10};                //!< Batches kept before the first test
+    uint32_t m_batches{0};                    //!< Batches ended, including the first one
+    uint64_t m_rxBytes{0};                    //!< Bytes received at the end of the last batch
+    uint64_t m_rxPackets{0};                  //!< Packets received at the end of the last batch
+    double m_delaySum{0};                     //!< Delay sum (s) at the end of the last batch
+    std::vector<double> m_throughput;         //!< Throughput (Mbit/s) of each batch
+    std::vector<double> m_delay;              //!< Mean delay (s) of each batch with packets
+    bool m_converged{false};                  //!< Stopped by the test
+    EventId m_event;                          //!< End of the current batch
+};
+
+} // namespace ns3
+
+#endif // KPI_CONVERGENCE_H
@@ -0,0 +1,119 @@
+"""! Decoder of the log ring files written by the handover scenarios.
+
+Reads a log-ring.bin written by log-ring-sink.h (logSink=ring) and prints its
+entries in time order as tab separated text. The filters are applied to the
+binary entries, so only the entries kept are formatted.
+
+Example:
+    python3 scratch/log-ring-reader.py results/log-ring.bin --component LteUeRrc --node 2
+    python3 scratch/log-ring-reader.py results/log-ring.bin --stats
+"""
+
+import argparse
+import collections
+import math
+import mmap
+import struct
+import sys
+
+HEADER = struct.Struct("<4sIIIQQII24x")
+ENTRY = struct.Struct("<qIHBB112s")
+NAME_SIZE = 48
+LEVELS = ["ERROR", "WARN", "DEBUG", "INFO", "FUNCT", "LOGIC"]
+NO_NODE = 0xFFFFFFFF
+
+
+def level_name(level):
+    """! Name of an entry level."""
+    return LEVELS[level] if level < len(LEVELS) else "?"
+
+
+def open_ring(path):
+    """! Map a ring file and parse its header.
+    @return (mapping, component names, entry offsets in time order, entries filtered
+    out, entries written)
+    """
+    with open(path, "rb") as f:
+        data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+    magic, version, entry_size, slots, capacity, written, used, filtered = HEADER.unpack_from(
+        data, 0
+    )
+    if magic != b"NRLG":
+        raise ValueError("%s: not a log ring file" % path)
+    if version != 1 or entry_size != ENTRY.size:
+        raise ValueError(
+            "%s: unsupported version %d or entry size %d" % (path, version, entry_size)
+        )
+    names = []
+    for i in range(used):
+        raw = data[HEADER.size + i * NAME_SIZE : HEADER.size + (i + 1) * NAME_SIZE]
+        names.append(raw.split(b"\0", 1)[0].decode("ascii", "replace"))
+    first = written - capacity if written > capacity else 0
+    order = [i % capacity for i in range(first, written)]
+    base = HEADER.size + slots * NAME_SIZE
+    return data, names, [base + i * ENTRY.size for i in order], filtered, written
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("file", help="log-ring.bin")
+    parser.add_argument("--component", action="append", help="keep only this component")
+    parser.add_argument("--node", type=int, action="append", help="keep only this node")
+    parser.add_argument("--level", choices=LEVELS, action="append", help="keep only this level")
+    parser.add_argument("--from", dest="start", type=float, default=-math.inf, help="seconds")
+    parser.add_argument("--to", dest="stop", type=float, default=math.inf, help="seconds")
+    parser.add_argument("--stats", action="store_true", help="count entries per component/level")
+    args = parser.parse_args(argv[1:])
+
+    data, names, offsets, filtered, written = open_ring(args.file)
+    components = None
+    if args.component:
+        components = {i for i, n in enumerate(names) if n in args.component}
+    nodes = set(args.node) if args.node else None
+    levels = {LEVELS.index(l) for l in args.level} if args.level else None
+
+    counts = collections.Counter()
+    out = sys.stdout
+    if not args.stats:
+        out.write("time\tnode\tcomponent\tlevel\tmessage\n")
+    for offset in offsets:
+        t, node, component, level, length, payload = ENTRY.unpack_from(data, offset)
+        if components is not None and component not in components:
+            continue
+        if nodes is not None and node not in nodes:
+            continue
+        if levels is not None and level not in levels:
+            continue
+        t *= 1e-9
+        if t < args.start or t > args.stop:
+            continue
+        name = names[component] if component < len(names) else "?"
+        if args.stats:
+            counts[(name, level_name(level))] += 1
+            continue
+        out.write(
+            "%.9f\t%s\t%s\t%s\t%s\n"
+            % (
+                t,
+                "-" if node == NO_NODE else node,
+                name,
+                level_name(level),
+                payload[:length].decode("utf-8", "replace"),
+            )
+        )
+    if args.stats:
+        out.write("component\tlevel\tentries\n")
+        for (name, level), n in counts.most_common():
+            out.write("%s\t%s\t%d\n" % (name, level, n))
+        out.write(
+            "# %d entries written, %d kept in the ring, %d filtered out by the sink\n"
+            % (written, len(offsets), filtered)
+        )
+    return 0
+
+
+if __name__ == "__main__":
+    try:
+        sys.exit(main(sys.argv))
+    except BrokenPipeError:
+        sys.exit(0)
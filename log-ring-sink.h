@@ -0,0 +1,334 @@
+#ifndef LOG_RING_SINK_H
+#define LOG_RING_SINK_H
+
+/**
+ * @file log-ring-sink.h
+ * @brief Binary ring file sink for the ns-3 log output.
+ *
+ * The NS_LOG macros write text lines to std::clog. The sink takes the place of the
+ * stream buffer of std::clog and turns every line into a fixed-size LogRingEntry
+ * (simulation time, node of the current context, component id, level and the first
+ * bytes of the message) stored in a memory-mapped ring file, so a debugging run pays
+ * for neither the terminal nor the formatting of the prefixes. Components left out of
+ * the component filter are not enabled at all, so their lines are never formatted;
+ * the node filter, known only once a line is written, is applied before an entry is
+ * stored. log-ring-reader.py decodes the file.
+ *
+ * File layout (little-endian):
+ * - LogRingHeader (64 bytes): "NRLG", version, entry size, component slots, capacity,
+ *   entries written since the start, components used, entries filtered out
+ * - component names: componentSlots x 48 bytes, NUL padded, indexed by component id
+ * - entries: capacity x LogRingEntry; with written > capacity the oldest entry is at
+ *   written % capacity
+ */
+
+#include "ns3/core-module.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <set>
+#include <streambuf>
+#include <string>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <unordered_map>
+
+namespace ns3
+{
+
+/// Header of a log ring file
+struct LogRingHeader
+{
+    char magic[4];           //!< "NRLG"
+    uint32_t version;        //!< Format version, 1
+    uint32_t entrySize;      //!< sizeof(LogRingEntry)
+    uint32_t componentSlots; //!< Entries of the component name table
+    uint64_t capacity;       //!< Entries of the ring
+    uint64_t written;        //!< Entries written since the start
+    uint32_t components;     //!< Component names used
+    uint32_t filtered;       //!< Log lines dropped by the node filter
+    uint8_t padding[24];     //!< Always 0
+};
+
+static_assert(sizeof(LogRingHeader) == 64, "LogRingHeader must stay packed");
+
+/// One log line as stored in the ring
+struct LogRingEntry
+{
+    int64_t timeNs;     //!< Simulation time of the line
+    uint32_t nodeId;    //!< Node of the current context, 0xffffffff outside any node
+    uint16_t component; //!< Index in the component table, 0xffff if unknown
+    uint8_t level;      //!< LogRingSink::Level
+    uint8_t length;     //!< Bytes of payload used
+    char payload[112];  //!< Start of the message, not NUL terminated
+};
+
+static_assert(sizeof(LogRingEntry) == 128, "LogRingEntry must stay packed");
+
+class LogRingSink : public std::streambuf
+{
+  public:
+    /// Levels stored in the entries
+    enum Level : uint8_t
+    {
+        ERROR,
+        WARN,
+        DEBUG,
+        INFO,
+        FUNCTION,
+        LOGIC,
+        UNKNOWN = 255
+    };
+
+    static constexpr uint32_t COMPONENT_SLOTS = 256; //!< Size of the component table
+    static constexpr std::size_t NAME_SIZE = 48;     //!< Bytes per component name
+
+    LogRingSink() = default;
+
+    LogRingSink(const LogRingSink&) = delete;
+    LogRingSink& operator=(const LogRingSink&) = delete;
+
+    ~LogRingSink() override
+    {
+        if (m_previous)
+        {
+            std::clog.rdbuf(m_previous);
+        }
+        Unmap();
+    }
+
+    /**
+     * @brief Create the ring file, replacing any file opened before.
+     *
+     * A forked replica calls it again to get its own file.
+     * @param path ring file
+     * @param capacity entries of the ring
+     */
+    void Open(const std::string& path, uint64_t capacity)
+    {
+        NS_ABORT_MSG_IF(capacity == 0, "The log ring needs a capacity");
+        Unmap();
+        m_size = sizeof(LogRingHeader) + COMPONENT_SLOTS * NAME_SIZE +
+                 capacity * sizeof(LogRingEntry);
+        int fd = open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+        NS_ABORT_MSG_IF(fd < 0, "Unable to create " << path);
+        NS_ABORT_MSG_IF(ftruncate(fd, m_size) != 0, "Unable to size " << path);
+        void* map = mmap(nullptr, m_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        close(fd);
+        NS_ABORT_MSG_IF(map == MAP_FAILED, "Unable to map " << path);
+        m_header = static_cast<LogRingHeader*>(map);
+        std::memcpy(m_header->magic, "NRLG", 4);
+        m_header->version = 1;
+        m_header->entrySize = sizeof(LogRingEntry);
+        m_header->componentSlots = COMPONENT_SLOTS;
+        m_header->capacity = capacity;
+        m_names = reinterpret_cast<char*>(m_header + 1);
+        m_entries = reinterpret_cast<LogRingEntry*>(m_names + COMPONENT_SLOTS * NAME_SIZE);
+        m_components.clear();
+    }
+
+    /// @brief Redirect std::clog, and thus the NS_LOG output, into the ring.
+    void Install()
+    {
+        NS_ABORT_MSG_UNLESS(m_header, "Open the log ring before installing it");
+        if (!m_previous)
+        {
+            m_previous = std::clog.rdbuf(this);
+        }
+    }
+
+    /**
+     * @brief Enable a log component with the prefixes the sink parses.
+     *
+     * Does nothing for a component left out of the component filter.
+     * @param name log component
+     * @param level ns-3 log level of the component
+     */
+    void Enable(const std::string& name, LogLevel level) const
+    {
+        if (!m_componentFilter.empty() && !m_componentFilter.count(name))
+        {
+            return;
+        }
+        LogComponentEnable(name, static_cast<LogLevel>(level | LOG_PREFIX_FUNC | LOG_PREFIX_LEVEL));
+    }
+
+    /// @brief Enable only this component in Enable (all components if none is added).
+    void AddComponentFilter(const std::string& name)
+    {
+        m_componentFilter.insert(name);
+    }
+
+    /// @brief Keep only the lines logged in the context of this node (all if none is added).
+    void AddNodeFilter(uint32_t nodeId)
+    {
+        m_nodeFilter.insert(nodeId);
+    }
+
+    /// @return entries written since Open
+    uint64_t GetWritten() const
+    {
+        return m_header ? m_header->written : 0;
+    }
+
+  protected:
+    int_type overflow(int_type c) override
+    {
+        if (c != traits_type::eof())
+        {
+            if (c == '\n')
+            {
+                Emit();
+            }
+            else
+            {
+                m_line.push_back(static_cast<char>(c));
+            }
+        }
+        return traits_type::not_eof(c);
+    }
+
+    std::streamsize xsputn(const char* s, std::streamsize n) override
+    {
+        for (std::streamsize i = 0; i < n; ++i)
+        {
+            if (s[i] == '\n')
+            {
+                Emit();
+            }
+            else
+            {
+                m_line.push_back(s[i]);
+            }
+        }
+        return n;
+    }
+
+  private:
+    void Unmap()
+    {
+        if (m_header)
+        {
+            munmap(m_header, m_size);
+            m_header = nullptr;
+        }
+    }
+
+    /// Store the completed line: [context] Component:Function(): [LEVEL] message
+    void Emit()
+    {
+        if (!m_header || m_line.empty())
+        {
+            m_line.clear();
+            return;
+        }
+        const uint32_t node = Simulator::GetContext();
+        if (!m_nodeFilter.empty() && !m_nodeFilter.count(node))
+        {
+            ++m_header->filtered;
+            m_line.clear();
+            return;
+        }
+        // per-class contexts such as " [ CellId 1, bwpId 0] " come before the component
+        std::size_t start = 0;
+        while (start < m_line.size())
+        {
+            if (m_line[start] == ' ')
+            {
+                ++start;
+            }
+            else if (m_line[start] == '[')
+            {
+                const std::size_t close = m_line.find(']', start);
+                start = close == std::string::npos ? m_line.size() : close + 1;
+            }
+            else
+            {
+                break;
+            }
+        }
+        const std::size_t colon = m_line.find(':', start);
+        std::string component = colon == std::string::npos
+                                    ? std::string()
+                                    : m_line.substr(start, colon - start);
+        if (component.find(' ') != std::string::npos)
+        {
+            component.clear();
+        }
+
+        // NS_LOG_FUNCTION lines have no level prefix: Component:Function(arguments)
+        uint8_t level = FUNCTION;
+        std::size_t message = colon == std::string::npos ? 0 : colon + 1;
+        const std::size_t prefix = m_line.find("(): [", message);
+        if (prefix != std::string::npos)
+        {
+            const std::size_t close = m_line.find(']', prefix);
+            level = ParseLevel(m_line.substr(prefix + 5, close - prefix - 5));
+            message = std::min(close + 2, m_line.size());
+        }
+
+        LogRingEntry& entry = m_entries[m_header->written % m_header->capacity];
+        entry.timeNs = Simulator::Now().GetNanoSeconds();
+        entry.nodeId = node;
+        entry.component = GetComponentId(component);
+        entry.level = level;
+        // keep the context, it tells the cell and bandwidth part apart
+        const std::size_t context = std::min(m_line.find_first_not_of(' '), start);
+        std::string payload = m_line.substr(context, start - context) + m_line.substr(message);
+        entry.length = static_cast<uint8_t>(std::min(payload.size(), sizeof(entry.payload)));
+        std::memcpy(entry.payload, payload.data(), entry.length);
+        ++m_header->written;
+        m_line.clear();
+    }
+
+    static uint8_t ParseLevel(const std::string& label)
+    {
+        static const char* labels[] = {"ERROR", "WARN", "DEBUG", "INFO", "FUNCT", "LOGIC"};
+        for (uint8_t i = 0; i < 6; ++i)
+        {
+            if (label.compare(0, std::strlen(labels[i]), labels[i]) == 0)
+            {
+                return i;
+            }
+        }
+        return UNKNOWN;
+    }
+
+    uint16_t GetComponentId(const std::string& name)
+    {
+        if (name.empty())
+        {
+            return 0xffff;
+        }
+        auto it = m_components.find(name);
+        if (it != m_components.end())
+        {
+            return it->second;
+        }
+        if (m_header->components >= COMPONENT_SLOTS)
+        {
+            return 0xffff;
+        }
+        const uint16_t id = m_header->components++;
+        std::strncpy(m_names + id * NAME_SIZE, name.c_str(), NAME_SIZE - 1);
+        m_components.emplace(name, id);
+        return id;
+    }
+
+    LogRingHeader* m_header{nullptr};                        //!< Start of the mapping
+    char* m_names{nullptr};                                  //!< Component name table
+    LogRingEntry* m_entries{nullptr};                        //!< Ring of entries
+    std::size_t m_size{0};                                   //!< Bytes mapped
+    std::streambuf* m_previous{nullptr};                     //!< std::clog buffer replaced
+    std::string m_line;                                      //!< Line being assembled
+    std::unordered_map<std::string, uint16_t> m_components; //!< Component ids
+    std::set<std::string> m_componentFilter;                 //!< Components enabled, empty for all
+    std::set<uint32_t> m_nodeFilter;                         //!< Nodes kept, empty for all
+};
+
+} // namespace ns3
+
+#endif // LOG_RING_SINK_H
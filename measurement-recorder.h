@@ -0,0 +1,233 @@
+#ifndef MEASUREMENT_RECORDER_H
+#define MEASUREMENT_RECORDER_H
+
+/**
+ * @file measurement-recorder.h
+ * @brief Periodic per-UE radio measurement recorder.
+ *
+ * Every sampling interval the recorder takes one sample per tracked UE (RSRP, last
+ * downlink data SINR, serving cell and position) and keeps it in memory. Samples are
+ * written out in blocks through a single BufferedFileWriter, either as tab separated
+ * text or as fixed-size binary records:
+ *
+ * - header: the 4 bytes "NRMS", uint32 version, uint32 record size
+ * - records: MeasurementSample, little-endian, in time order
+ */
+
+#include "buffered-file-writer.h"
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/nr-module.h"
+
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/// One sample of one UE, also the on-disk record of the binary format
+struct MeasurementSample
+{
+    int64_t timeNs;  //!< Simulation time of the sample
+    uint64_t imsi;   //!< UE IMSI
+    uint16_t cellId; //!< Serving cell
+    uint16_t rnti;   //!< RNTI in the serving cell
+    uint32_t nodeId; //!< UE node
+    double rsrpDbm;  //!< RSRP reported by the PHY
+    double sinrDb;   //!< Last downlink data SINR, NaN until the first report
+    double x;        //!< UE position
+    double y;        //!< UE position
+    double z;        //!< UE position
+};
+
+static_assert(sizeof(MeasurementSample) == 64, "MeasurementSample must stay packed");
+
+class MeasurementRecorder
+{
+  public:
+    /// Output encoding
+    enum Format
+    {
+        TEXT,  //!< tab separated values with a header line
+        BINARY //!< fixed-size MeasurementSample records
+    };
+
+    MeasurementRecorder() = default;
+
+    MeasurementRecorder(const MeasurementRecorder&) = delete;
+    MeasurementRecorder& operator=(const MeasurementRecorder&) = delete;
+
+    ~MeasurementRecorder()
+    {
+        FlushSamples();
+        m_writer.Close();
+    }
+
+    /// @brief Set the output file, must be called before the first flush.
+    void SetOutputFile(const std::string& path)
+    {
+        m_writer.SetPath(path);
+    }
+
+    /// @brief Select the output encoding, must be called before Start.
+    void SetFormat(Format format)
+    {
+        m_format = format;
+    }
+
+    /// @brief Set the sampling interval (default 10 ms).
+    void SetInterval(Time interval)
+    {
+        m_interval = interval;
+    }
+
+    /// @brief Set how many samples are kept in memory before a flush.
+    void SetBlockSamples(std::size_t samples)
+    {
+        m_blockSamples = samples;
+    }
+
+    /**
+     * @brief Add a UE to the set of sampled devices.
+     * @param ueDevice the UE net device, its first bandwidth part is sampled
+     */
+    void Track(Ptr<NrUeNetDevice> ueDevice)
+    {
+        auto ue = std::make_unique<UeState>();
+        ue->device = ueDevice;
+        ue->phy = ueDevice->GetPhy(0);
+        ue->mobility = ueDevice->GetNode()->GetObject<MobilityModel>();
+        ue->nodeId = ueDevice->GetNode()->GetId();
+        ue->phy->TraceConnectWithoutContext(
+            "DlDataSinr",
+            MakeBoundCallback(&MeasurementRecorder::DlDataSinr, ue.get()));
+        m_ues.push_back(std::move(ue));
+    }
+
+    /// @brief Track every NrUeNetDevice of a container.
+    void Track(const NetDeviceContainer& ueDevices)
+    {
+        for (uint32_t i = 0; i < ueDevices.GetN(); ++i)
+        {
+            Ptr<NrUeNetDevice> ueDevice = DynamicCast<NrUeNetDevice>(ueDevices.Get(i));
+            NS_ABORT_MSG_UNLESS(ueDevice, "MeasurementRecorder only tracks NrUeNetDevice");
+            Track(ueDevice);
+        }
+    }
+
+    /// @brief Schedule the first sample.
+    void Start(Time delay)
+    {
+        m_samples.reserve(m_blockSamples);
+        if (m_format == TEXT)
+        {
+            m_writer.Write("time\tnodeId\timsi\tcellId\trnti\tRSRP\tSINR\tx\ty\tz\n");
+        }
+        else
+        {
+            const uint32_t version = 1;
+            const uint32_t recordSize = sizeof(MeasurementSample);
+            m_writer.Write("NRMS", 4);
+            m_writer.Write(&version, sizeof(version));
+            m_writer.Write(&recordSize, sizeof(recordSize));
+        }
+        m_event = Simulator::Schedule(delay, &MeasurementRecorder::Sample, this);
+    }
+
+    /// @brief Stop sampling, write the pending samples and close the file.
+    void Finish()
+    {
+        m_event.Cancel();
+        FlushSamples();
+        m_writer.Close();
+    }
+
+  private:
+    /// Per-UE state, heap allocated so trace callbacks can keep a stable pointer
+    struct UeState
+    {
+        Ptr<NrUeNetDevice> device;
+        Ptr<NrUePhy> phy;
+        Ptr<MobilityModel> mobility;
+        uint32_t nodeId{0};
+        double lastSinrDb{std::numeric_limits<double>::quiet_NaN()};
+    };
+
+    static void DlDataSinr(UeState* ue,
+                           uint16_t cellId,
+                           uint16_t rnti,
+                           double avgSinr,
+                           uint16_t bwpId)
+    {
+        ue->lastSinrDb = 10 * std::log10(avgSinr);
+    }
+
+    void Sample()
+    {
+        const int64_t now = Simulator::Now().GetNanoSeconds();
+        for (const auto& ue : m_ues)
+        {
+            Vector pos = ue->mobility->GetPosition();
+            m_samples.push_back({now,
+                                 ue->device->GetImsi(),
+                                 ue->phy->GetCellId(),
+                                 ue->phy->GetRnti(),
+                                 ue->nodeId,
+                                 ue->phy->GetRsrp(),
+                                 ue->lastSinrDb,
+                                 pos.x,
+                                 pos.y,
+                                 pos.z});
+        }
+        if (m_samples.size() >= m_blockSamples)
+        {
+            FlushSamples();
+        }
+        m_event = Simulator::Schedule(m_interval, &MeasurementRecorder::Sample, this);
+    }
+
+    void FlushSamples()
+    {
+        if (m_samples.empty())
+        {
+            return;
+        }
+        if (m_format == BINARY)
+        {
+            m_writer.Write(m_samples.data(), m_samples.size() * sizeof(MeasurementSample));
+        }
+        else
+        {
+            std::ostringstream block;
+            char time[32];
+            for (const auto& s : m_samples)
+            {
+                std::snprintf(time, sizeof(time), "%.9f", s.timeNs * 1e-9);
+                block << time << "\t" << s.nodeId << "\t" << s.imsi << "\t" << s.cellId
+                      << "\t" << s.rnti << "\t" << s.rsrpDbm << "\t" << s.sinrDb << "\t" << s.x
+                      << "\t" << s.y << "\t" << s.z << "\n";
+            }
+            m_writer.Write(block.str());
+        }
+        m_samples.clear();
+    }
+
+    std::vector<std::unique_ptr<UeState>> m_ues; //!< Tracked UEs
+    std::vector<MeasurementSample> m_samples;    //!< Samples not yet handed to the writer
+    BufferedFileWriter m_writer;                 //!< Output file
+    Format m_format{TEXT};                       //!< Output encoding
+    Time m_interval{MilliSeconds(10)};           //!< Sampling interval
+    std::size_t m_blockSamples{16384};           //!< Samples per flush
+    EventId m_event;                             //!< Next sampling event
+};
+
+} // namespace ns3
+
+#endif // MEASUREMENT_RECORDER_H
@@ -15,8 +15,34 @@
 #include "ns3/nr-point-to-point-epc-helper.h"
 #include "ns3/point-to-point-helper.h"
 #include "ns3/nr-handover-algorithm.h"
+#include "backlog-udp-client.h"
+#include "channel-update-policy.h"
+#include "config-hash.h"
+#include "flow-sampler.h"
+#include "flow-summary-exporter.h"
+#include "handover-event-log.h"
+#include "handover-kpi.h"
+#include "handover-options.h"
+#include "instrumented-scheduler.h"
+#include "kpi-convergence.h"
+#include "log-ring-sink.h"
+#include "hex-topology.h"
+#include "measurement-recorder.h"
+#include "nr-trace-output.h"
+#include "replica-fork.h"
+#include "results-store.h"
+#include "rsrp-prescreen.h"
+#include "run-summary.h"
+#include "scenario-table.h"
+#include "spatial-attachment.h"
+#include "telemetry-sampler.h"
+#include "trajectory-mobility.h"
 #include <fstream>
 
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <sstream>
 #include <filesystem> // Quero mover os arquivos de trace depois de gerados
 namespace fs = std::filesystem; // apelido pra digitar menos
 
@@ -26,121 +52,269 @@ using namespace ns3;
 
 void organizar(std::string caminho_res);
 
-
-void LogRsrp(Ptr<NrUePhy> phy) {
-    static bool firstWrite = true; // Flag to track the first write in this run
-
-    std::ios_base::openmode mode = (firstWrite) ? std::ios::out : std::ios::app; 
-    std::ofstream file("measurements.txt", mode); // Open file with chosen mode
-
-    if (file.is_open()) {
-        // If it's the first write, add the header
-        if (firstWrite) {
-            file << "time\tRSRP\n";
-            firstWrite = false; // Change flag after first write
+/**
+ * Build, run and destroy one simulation.
+ * @param argc number of command line arguments
+ * @param argv command line arguments of the configuration
+ * @param batchRun name of the configuration in a batch, empty for a single run
+ * @param summary filled with the summary row of the run
+ * @return exit status of the run
+ */
+int RunScenario(int argc, char* argv[], const std::string& batchRun, RunSummary& summary);
+
+/*
+ * --batch=<file> runs many configurations in this process, saving the process start-up
+ * and TypeId registration of each: every line of the file holds the command line
+ * arguments of one configuration ('#' starts a comment), applied after the other
+ * arguments of the command line. Configuration n writes to <outputDir>/config-<n>, and
+ * the summary rows of all of them go to <file>-summary.csv.
+ */
+int
+main(int argc, char* argv[])
+{
+    std::string batchFile;
+    std::vector<std::string> common; // arguments of every configuration
+    for (int i = 1; i < argc; ++i)
+    {
+        std::string arg = argv[i];
+        if (arg.rfind("--batch=", 0) == 0)
+        {
+            batchFile = arg.substr(8);
+        }
+        else
+        {
+            common.push_back(arg);
         }
-
-        // Write the time and RSRP value
-        file << Simulator::Now().As(Time::S) << "\t" << phy->GetRsrp() << std::endl;
-        file.close(); // Close after writing
-    } else {
-        std::cerr << "Error: Unable to open measurements.txt\n";
+    }
+    if (batchFile.empty())
+    {
+        RunSummary summary;
+        return RunScenario(argc, argv, "", summary);
     }
 
-    Simulator::Schedule(Seconds(0.01), &LogRsrp, phy);
+    std::ifstream batch(batchFile);
+    NS_ABORT_MSG_UNLESS(batch.is_open(), "Unable to open " << batchFile);
+    const std::string table = fs::path(batchFile).replace_extension().string() + "-summary.csv";
+    std::vector<RunSummary> rows;
+    auto batchStart = std::chrono::steady_clock::now();
+    for (std::string line; std::getline(batch, line);)
+    {
+        std::istringstream words(line.substr(0, line.find('#')));
+        std::vector<std::string> args{argv[0]};
+        args.insert(args.end(), common.begin(), common.end());
+        const std::size_t first = args.size();
+        for (std::string word; words >> word;)
+        {
+            args.push_back(word);
+        }
+        if (args.size() == first)
+        {
+            continue;
+        }
+        std::vector<char*> configArgv;
+        for (auto& arg : args)
+        {
+            configArgv.push_back(arg.data());
+        }
+        std::ostringstream name;
+        name << "config-" << std::setw(3) << std::setfill('0') << rows.size() + 1;
+        rows.emplace_back();
+        rows.back().Set("config", rows.size());
+        RunScenario(configArgv.size(), configArgv.data(), name.str(), rows.back());
+        // the next configuration starts from the ns-3 defaults again, with no address
+        // handed out and the automatic random streams numbered as in a fresh process
+        Config::Reset();
+        ProfilingMapScheduler::Reset();
+        Ipv4AddressGenerator::Reset();
+        Ipv6AddressGenerator::Reset();
+        RngSeedManager::ResetNextStreamIndex();
+        RunSummary::WriteTable(rows, table);
+    }
+    std::cout << rows.size() << " configurations run in "
+              << std::chrono::duration<double>(std::chrono::steady_clock::now() - batchStart)
+                     .count()
+              << " s, summary in " << table << std::endl;
+    return EXIT_SUCCESS;
 }
 
-
 int
-main(int argc, char* argv[])
+RunScenario(int argc, char* argv[], const std::string& batchRun, RunSummary& summary)
 {
-    std::string scenario = "UMa"; // scenario
-    double frequency = 28e9;      // central frequency
-    double bandwidth = 100e6;     // bandwidth
-    double mobility = true;       // enable mobility
-    double simTime = 7;           // in second
-    double speed = 15;            // UE speed increased to 10 m/s
+    HandoverOptions options;
+    options.outputDir = "scratch/results/nrHandover/"; // all files written by this run
     double hBS;          // base station antenna height
     double hUT;          // user antenna height
-    double txPower = 40; // txPower
-    bool logging = true;
-
-    CommandLine cmd(__FILE__);
-    cmd.AddValue("scenario",
-                 "The scenario for the simulation. Choose among 'RMa', 'UMa', 'UMi', "
-                 "'InH-OfficeMixed', 'InH-OfficeOpen'.",
-                 scenario);
-    cmd.AddValue("frequency", "The central carrier frequency in Hz.", frequency);
-    cmd.AddValue("mobility",
-                 "Enable UE mobility (1) or static UEs (0)",
-                 mobility);
-    cmd.AddValue("logging", "Enable logging (1) or disable (0)", logging);
+    std::string measurementFormat = "text"; // text or binary
+
+    HashedCommandLine cmd(__FILE__);
+    options.AddTo(cmd);
+    cmd.AddValue("measurementFormat",
+                 "Encoding of the per-UE measurement file: 'text' (measurements.txt) or "
+                 "'binary' (measurements.bin)",
+                 measurementFormat);
     cmd.Parse(argc, argv);
-    
-    if (logging)
+
+    if (!batchRun.empty())
     {
-        LogComponentEnable("ThreeGppPropagationLossModel", LOG_LEVEL_WARN);
+        // a forked parent exits instead of returning to the batch
+        NS_ABORT_MSG_IF(options.replicas > 0 || !options.replicaWindows.empty(),
+                        "replicas cannot run in batch mode");
+        options.outputDir += "/" + batchRun;
     }
- 
-    Config::SetDefault("ns3::NrRlcUm::MaxTxBufferSize", UintegerValue(999999999));
- 
-    // Set antenna heights based on scenario
-    if (scenario == "RMa")
+    fs::create_directories(options.outputDir);
+
+    // hash of the effective configuration; one already in the results store is not run
+    const std::string hash = options.Hash(cmd, "nr-handover");
+    if (options.FindCached(hash, summary))
     {
-        hBS = 35;
-        hUT = 1.5;
+        return EXIT_SUCCESS;
     }
-    else if (scenario == "UMa")
+    if (options.profile)
     {
-        hBS = 25;
-        hUT = 1.5;
+        ProfilingMapScheduler::Install();
     }
-    else if (scenario == "UMi-StreetCanyon")
+    
+    // log output: text on stderr, or binary entries in outputDir/log-ring.bin
+    NS_ABORT_MSG_UNLESS(options.logSink == "stderr" || options.logSink == "ring",
+                        "logSink must be stderr or ring");
+    LogRingSink logRing;
+    if (options.logging && options.logSink == "ring")
     {
-        hBS = 10;
-        hUT = 1.5;
+        logRing.Open(options.outputDir + "/log-ring.bin", options.logRingEntries);
+        std::istringstream components(options.logComponents);
+        for (std::string c; std::getline(components, c, ',');)
+        {
+            logRing.AddComponentFilter(c);
+        }
+        std::istringstream nodes(options.logNodes);
+        for (std::string n; std::getline(nodes, n, ',');)
+        {
+            logRing.AddNodeFilter(std::stoul(n));
+        }
+        logRing.Install();
     }
-    else if (scenario == "InH-OfficeMixed" || scenario == "InH-OfficeOpen")
+    auto enableLog = [&options, &logRing](const char* component, LogLevel level) {
+        if (options.logSink == "ring")
+        {
+            logRing.Enable(component, level);
+        }
+        else
+        {
+            LogComponentEnable(component, level);
+        }
+    };
+    if (options.logging)
     {
-        hBS = 3;
-        hUT = 1;
+        enableLog("ThreeGppPropagationLossModel", LOG_LEVEL_WARN);
     }
-    else
+ 
+    // the backlog source never has more than backlogPackets queued, leave room for two windows
+    NS_ABORT_MSG_UNLESS(options.trafficMode == "udp" || options.trafficMode == "backlog",
+                        "trafficMode must be udp or backlog");
+    if (options.backlogPackets == 0)
     {
-        NS_ABORT_MSG("Scenario not supported. Choose among 'RMa', 'UMa', 'UMi', "
-                     "'InH-OfficeMixed', and 'InH-OfficeOpen'.");
+        // remote host link (10 ms) plus about 5 ms of EPC, RLC and scheduling
+        options.backlogPackets = BacklogUdpClient::GetBdpWindow(options.bandwidth,
+                                                                MilliSeconds(15),
+                                                                MilliSeconds(5),
+                                                                1500);
     }
+    Config::SetDefault("ns3::NrRlcUm::MaxTxBufferSize",
+                       UintegerValue(options.trafficMode == "backlog"
+                                         ? 2 * options.backlogPackets * 1600
+                                         : 999999999));
  
-    // Create nodes: 1 gNB and 2 UEs
+    // Antenna heights, inter-site distance of the hexagonal layout and carrier frequency
+    const ScenarioParameters& deployment = GetScenarioParameters(options.scenario);
+    hBS = deployment.hBS;
+    hUT = deployment.hUT;
+    if (options.frequency <= 0)
+    {
+        options.frequency = deployment.frequency;
+    }
+    if (options.isd <= 0)
+    {
+        options.isd = deployment.isd;
+    }
+ 
+    // Layout: the two gNBs below, or hexRings rings of sites with one gNB per cell
+    HexTopology hex(options.hexRings, options.isd, options.sectors);
+    const double legacyArea = 100.0 * 100.0; // x in [-50, 50], y in [0, 100]
+    if (options.ueDensity > 0)
+    {
+        double area = options.hexRings > 0 ? hex.GetArea() : legacyArea;
+        options.numUes = std::max<uint32_t>(1, std::lround(options.ueDensity * area * 1e-6));
+    }
+
+    // Create nodes
     NodeContainer gnbNodes;
     NodeContainer ueNodes;
-    gnbNodes.Create(2);  // Single gNodeB
-    ueNodes.Create(1);   // Single UE
+    gnbNodes.Create(options.hexRings > 0 ? hex.GetNumCells() : 2);
+    ueNodes.Create(options.numUes);
  
-    // Position the gNB
+    // Position the gNBs
     Ptr<ListPositionAllocator> gnbPositionAlloc = CreateObject<ListPositionAllocator>();
-    gnbPositionAlloc->Add(Vector(0.0, 0.0, hBS));  // First gNB at origin
-    gnbPositionAlloc->Add(Vector(0.0, 100.0, hBS)); // Second gNB at (0, 100)
+    if (options.hexRings > 0)
+    {
+        for (uint32_t c = 0; c < gnbNodes.GetN(); ++c)
+        {
+            gnbPositionAlloc->Add(hex.GetCellPosition(c, hBS));
+        }
+    }
+    else
+    {
+        gnbPositionAlloc->Add(Vector(0.0, 0.0, hBS));  // First gNB at origin
+        gnbPositionAlloc->Add(Vector(0.0, 100.0, hBS)); // Second gNB at (0, 100)
+    }
     MobilityHelper gnbMobility;
     gnbMobility.SetMobilityModel("ns3::ConstantPositionMobilityModel");
     gnbMobility.SetPositionAllocator(gnbPositionAlloc);
     gnbMobility.Install(gnbNodes);
  
-    // Configure UE mobility with 10 m/s speed
-    MobilityHelper ueMobility;
-    ueMobility.SetMobilityModel("ns3::ConstantVelocityMobilityModel");
-    ueMobility.Install(ueNodes);
- 
-    if (mobility)
+    // UE mobility: replayed from a trajectory file, or constant velocity
+    if (!options.mobilityTrace.empty())
     {
-        // UE0 position and velocity (10 m/s along Y-axis)
-        ueNodes.Get(0)->GetObject<MobilityModel>()->SetPosition(Vector(50, 10, hUT));
-        ueNodes.Get(0)->GetObject<ConstantVelocityMobilityModel>()->SetVelocity(Vector(0, speed, 0));
+        TrajectoryMobilityModel::Install(Create<TrajectoryFile>(options.mobilityTrace), ueNodes);
     }
     else
     {
-        // Static positions if mobility disabled
-        ueNodes.Get(0)->GetObject<MobilityModel>()->SetPosition(Vector(50, 10, hUT));
+        // Configure UE mobility with 10 m/s speed
+        MobilityHelper ueMobility;
+        ueMobility.SetMobilityModel("ns3::ConstantVelocityMobilityModel");
+        ueMobility.Install(ueNodes);
+
+        if (options.mobility)
+        {
+            // UE0 position and velocity (10 m/s along Y-axis)
+            ueNodes.Get(0)->GetObject<MobilityModel>()->SetPosition(Vector(50, 10, hUT));
+            ueNodes.Get(0)->GetObject<ConstantVelocityMobilityModel>()->SetVelocity(
+                Vector(0, options.speed, 0));
+        }
+        else
+        {
+            // Static positions if mobility disabled
+            ueNodes.Get(0)->GetObject<MobilityModel>()->SetPosition(Vector(50, 10, hUT));
+        }
+
+        // Other UEs (all of them in the hexagonal layout): uniform drop, random heading
+        Ptr<UniformRandomVariable> uePlacement = CreateObject<UniformRandomVariable>();
+        for (uint32_t u = (options.hexRings > 0 ? 0 : 1); u < ueNodes.GetN(); ++u)
+        {
+            Vector position = options.hexRings > 0 ? hex.GetRandomPosition(uePlacement, hUT)
+                                                   : Vector(uePlacement->GetValue(-50, 50),
+                                                            uePlacement->GetValue(0, 100),
+                                                            hUT);
+            double heading = uePlacement->GetValue(0, 2 * M_PI);
+            auto ueMobilityModel = ueNodes.Get(u)->GetObject<ConstantVelocityMobilityModel>();
+            ueMobilityModel->SetPosition(position);
+            if (options.mobility)
+            {
+                ueMobilityModel->SetVelocity(
+                    Vector(options.speed * std::cos(heading),
+                           options.speed * std::sin(heading),
+                           0));
+            }
+        }
     }
  
     // Create NR helpers
@@ -148,13 +322,22 @@ main(int argc, char* argv[])
     Ptr<IdealBeamformingHelper> idealBeamformingHelper = CreateObject<IdealBeamformingHelper>();
     Ptr<NrHelper> nrHelper = CreateObject<NrHelper>();
 
-    // Configure handover parameters
-    nrHelper->SetHandoverAlgorithmType("ns3::A2A4RsrqHandoverAlgorithm");
-    nrHelper->SetHandoverAlgorithmAttribute("ServingCellThreshold", UintegerValue(30));  // 30 dB
-    nrHelper->SetHandoverAlgorithmAttribute("NeighbourCellOffset", UintegerValue(5));    // 5 dB offset
-    // nrHelper->SetHandoverAlgorithmType("ns3::NrA3RsrpHandoverAlgorithm"); // A3 RSRP-based handover
-    //nrHelper->SetHandoverAlgorithmAttribute("Hysteresis", DoubleValue(3.0));            // 3 dB hysteresis when using A3
-    //nrHelper->SetHandoverAlgorithmAttribute("TimeToTrigger", TimeValue(MilliSeconds(100))); // 100 ms
+    // Configure handover parameters, A2-A4 (RSRQ) by default or A3 (RSRP) with
+    // --handoverAlgorithm=ns3::NrA3RsrpHandoverAlgorithm
+    nrHelper->SetHandoverAlgorithmType(options.handoverAlgorithm);
+    if (options.handoverAlgorithm.find("A2A4") != std::string::npos)
+    {
+        nrHelper->SetHandoverAlgorithmAttribute("ServingCellThreshold",
+                                                UintegerValue(options.servingCellThreshold));
+        nrHelper->SetHandoverAlgorithmAttribute("NeighbourCellOffset",
+                                                UintegerValue(options.neighbourCellOffset));
+    }
+    else if (options.handoverAlgorithm.find("A3") != std::string::npos)
+    {
+        nrHelper->SetHandoverAlgorithmAttribute("Hysteresis", DoubleValue(options.hysteresis));
+        nrHelper->SetHandoverAlgorithmAttribute("TimeToTrigger",
+                                                TimeValue(Seconds(options.timeToTrigger * 1e-3)));
+    }
 
     // Configure other helpers
     nrHelper->SetBeamformingHelper(idealBeamformingHelper);
@@ -165,14 +348,28 @@ main(int argc, char* argv[])
     CcBwpCreator ccBwpCreator;
     const uint8_t numCcPerBand = 1;
     
-    CcBwpCreator::SimpleOperationBandConf bandConf(frequency, bandwidth, numCcPerBand);
+    CcBwpCreator::SimpleOperationBandConf bandConf(options.frequency,
+                                                   options.bandwidth,
+                                                   numCcPerBand);
     OperationBandInfo band = ccBwpCreator.CreateOperationBandContiguousCc(bandConf);
     
     // Channel configuration
+    Time channelPeriod = ConfigureChannelUpdates(options.channelUpdate,
+                                                 options.channelUpdatePeriod,
+                                                 options.channelUpdateDistance,
+                                                 options.mobility ? options.speed : 0);
     Ptr<NrChannelHelper> channelHelper = CreateObject<NrChannelHelper>();
-    channelHelper->ConfigureFactories(scenario, "Default", "ThreeGpp");
+    channelHelper->ConfigureFactories(options.scenario, "Default", "ThreeGpp");
     channelHelper->AssignChannelsToBands({band});
     allBwps = CcBwpCreator::GetAllBwps({band});
+    if (options.profile)
+    {
+        // time the channel matrices and fast fading apart from the PHY events running them
+        for (const auto& bwp : allBwps)
+        {
+            ProfilingMapScheduler::TimeChannel(bwp.get()->m_channel);
+        }
+    }
  
     // Beamforming and scheduler
     idealBeamformingHelper->SetAttribute("BeamformingMethod",
@@ -186,20 +383,56 @@ main(int argc, char* argv[])
  
     nrHelper->SetGnbAntennaAttribute("NumRows", UintegerValue(8));
     nrHelper->SetGnbAntennaAttribute("NumColumns", UintegerValue(8));
-    nrHelper->SetGnbAntennaAttribute("AntennaElement", PointerValue(CreateObject<IsotropicAntennaModel>()));
+    if (options.sectors == 3)
+    {
+        nrHelper->SetGnbAntennaAttribute("AntennaElement",
+                                         PointerValue(CreateObject<ThreeGppAntennaModel>()));
+    }
+    else
+    {
+        nrHelper->SetGnbAntennaAttribute("AntennaElement",
+                                         PointerValue(CreateObject<IsotropicAntennaModel>()));
+    }
  
-    // Install NR devices
-    NetDeviceContainer gnbNetDev = nrHelper->InstallGnbDevice(gnbNodes, allBwps);
+    // RSRP-only pre-screen: same nodes, mobility and channel, trigger applied offline
+    if (options.prescreen)
+    {
+        summary.Set("program", "nr-handover");
+        RunPrescreen(options,
+                     allBwps[0].get()->m_channel->GetPropagationLossModel(),
+                     hex,
+                     gnbNodes,
+                     ueNodes,
+                     summary);
+        options.WriteSummary(summary, hash);
+        Simulator::Destroy();
+        return EXIT_SUCCESS;
+    }
+
+    // Install NR devices, one at a time when each sector needs its own bearing
+    NetDeviceContainer gnbNetDev;
+    if (options.sectors == 3 && options.hexRings > 0)
+    {
+        for (uint32_t c = 0; c < gnbNodes.GetN(); ++c)
+        {
+            nrHelper->SetGnbAntennaAttribute("BearingAngle", DoubleValue(hex.GetCellBearing(c)));
+            gnbNetDev.Add(nrHelper->InstallGnbDevice(NodeContainer(gnbNodes.Get(c)), allBwps));
+        }
+    }
+    else
+    {
+        gnbNetDev = nrHelper->InstallGnbDevice(gnbNodes, allBwps);
+    }
     NetDeviceContainer ueNetDev = nrHelper->InstallUeDevice(ueNodes, allBwps);
  
-    int64_t randomStream = 1;
+    int64_t randomStream = options.firstStream;
     randomStream += nrHelper->AssignStreams(gnbNetDev, randomStream);
     randomStream += nrHelper->AssignStreams(ueNetDev, randomStream);
  
     // Set TX power for gNB
     for (uint32_t i = 0; i < gnbNetDev.GetN(); ++i)
     {
-        nrHelper->GetGnbPhy(gnbNetDev.Get(i), 0)->SetTxPower(txPower);
+        nrHelper->GetGnbPhy(gnbNetDev.Get(i), 0)->SetTxPower(options.txPower);
     }
 
     // Create internet stack and assign IP addresses
@@ -219,9 +452,26 @@ main(int argc, char* argv[])
         UdpServerHelper dlPacketSinkHelper(dlPort);
         serverApps.Add(dlPacketSinkHelper.Install(ueNodes.Get(u)));
  
+        if (options.trafficMode == "backlog")
+        {
+            // full buffer that only sends what the cell drains
+            Ptr<BacklogUdpClient> dlClient = CreateObject<BacklogUdpClient>();
+            dlClient->SetAttribute("PacketSize", UintegerValue(1500));
+            dlClient->SetAttribute("MaxInFlight", UintegerValue(options.backlogPackets));
+            dlClient->SetRemote(ueIpIface.GetAddress(u), dlPort);
+            dlClient->SetSink(DynamicCast<UdpServer>(serverApps.Get(u)));
+            remoteHost->AddApplication(dlClient);
+            clientApps.Add(dlClient);
+            continue;
+        }
+
         // UDP client sending to UE
         UdpClientHelper dlClient(ueIpIface.GetAddress(u), dlPort);
-        dlClient.SetAttribute("Interval", TimeValue(MicroSeconds(1)));
+        // MicroSeconds() takes an integer, a sub-us interval would become 0
+        const Time interval = Seconds(options.udpInterval * 1e-6);
+        NS_ABORT_MSG_UNLESS(interval.IsStrictlyPositive(),
+                            "udpInterval must be positive, got " << options.udpInterval << " us");
+        dlClient.SetAttribute("Interval", TimeValue(interval));
         //dlClient.SetAttribute("MaxPackets", UintegerValue(10));
         dlClient.SetAttribute ("MaxPackets", UintegerValue(0xFFFFFFFF));
 
@@ -229,50 +479,258 @@ main(int argc, char* argv[])
         clientApps.Add(dlClient.Install(remoteHost));
     }
  
-    // Attach UEs to the single gNB
-    nrHelper->AttachToClosestGnb(ueNetDev, gnbNetDev);
-    Ptr<Node> ueNode = ueNodes.Get(0);
-    Ptr<NrUeNetDevice> ueNetDevice = ueNode->GetDevice(0)->GetObject<NrUeNetDevice>();
-    if (ueNetDevice) {
-        Ptr<NrUePhy> uePhy = ueNetDevice->GetPhy(0);
-	Simulator::Schedule(Seconds(0.5),&LogRsrp,uePhy);
+    // X2 between neighbouring cells only, the full mesh grows quadratically with the layout
+    if (options.hexRings > 0)
+    {
+        for (const auto& [a, b] : hex.GetNeighbourCellPairs())
+        {
+            nrEpcHelper->AddX2Interface(gnbNodes.Get(a), gnbNodes.Get(b));
+        }
+    }
+    else
+    {
+        nrEpcHelper->AddX2Interface(gnbNodes.Get(0), gnbNodes.Get(1));
+    }
+
+    // Attach UEs to the closest gNB, timed to compare the grid search with the full scan
+    double attachSeconds;
+    if (options.attachMode == "closest")
+    {
+        auto attachStart = std::chrono::steady_clock::now();
+        nrHelper->AttachToClosestGnb(ueNetDev, gnbNetDev);
+        attachSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() -
+                                                      attachStart)
+                            .count();
+    }
+    else
+    {
+        NS_ABORT_MSG_UNLESS(options.attachMode == "grid" || options.attachMode == "rsrp",
+                            "attachMode must be closest, grid or rsrp");
+        SpatialAttachment attachment;
+        if (options.attachMode == "rsrp")
+        {
+            attachment.SetCandidates(options.attachCandidates);
+            attachment.SetPropagationLossModel(
+                allBwps[0].get()->m_channel->GetPropagationLossModel());
+        }
+        else
+        {
+            attachment.SetCandidates(1);
+        }
+        attachment.Attach(nrHelper, ueNetDev, gnbNetDev);
+        attachSeconds = attachment.GetIndexSeconds() + attachment.GetAttachSeconds();
     }
+    std::cout << "Attached " << ueNetDev.GetN() << " UEs to " << gnbNetDev.GetN()
+              << " gNBs (" << options.attachMode << ") in " << attachSeconds * 1e3 << " ms"
+              << std::endl;
+
+    // RSRP/SINR/cell/position of every UE, sampled every 10 ms and written in blocks
+    MeasurementRecorder measurements;
+    if (measurementFormat == "binary")
+    {
+        measurements.SetFormat(MeasurementRecorder::BINARY);
+        measurements.SetOutputFile(options.outputDir + "/measurements.bin");
+    }
+    else
+    {
+        NS_ABORT_MSG_UNLESS(measurementFormat == "text",
+                            "measurementFormat must be 'text' or 'binary'");
+        measurements.SetOutputFile(options.outputDir + "/measurements.txt");
+    }
+    measurements.Track(ueNetDev);
+    measurements.Start(Seconds(0.5));
+
+    // handover/RRC events, written to handover-events.txt at Simulator::Destroy
+    HandoverEventLog handoverLog;
+    handoverLog.SetOutputFile(options.outputDir + "/handover-events.txt");
+    handoverLog.Install(ueNetDev, gnbNetDev);
+
+    // handover KPIs updated online from the traces, one record in summary.csv
+    HandoverKpiEngine kpis;
+    kpis.SetPingPongWindow(Seconds(options.pingPongWindow));
+    kpis.SetSinrThreshold(options.sinrThreshold);
+    kpis.Install(ueNetDev);
 
     // Start applications
     serverApps.Start(Seconds(0.4));
     clientApps.Start(Seconds(0.4));
-    serverApps.Stop(Seconds(simTime));
-    clientApps.Stop(Seconds(simTime - 0.2));
+    serverApps.Stop(Seconds(options.simTime));
+    clientApps.Stop(Seconds(options.simTime - 0.2));
  
-    // Enable traces
-    nrHelper->EnableTraces();
+    // Enable traces, written straight into outputDir unless the legacy NR traces are asked for
+    NrTraceOutput traceOutput;
+    if (options.traceMode == "text" || options.traceMode == "binary")
+    {
+        traceOutput.Open(options.outputDir, options.traceMode == "binary");
+        if (options.traceCapture)
+        {
+            traceOutput.SetCapture(Seconds(options.capturePre * 1e-3),
+                                   Seconds(options.capturePost * 1e-3),
+                                   options.captureSinr);
+        }
+        traceOutput.Install(ueNetDev, gnbNetDev);
+    }
+    else if (options.traceMode == "legacy")
+    {
+        nrHelper->EnableTraces();
+    }
+    else
+    {
+        NS_ABORT_MSG_UNLESS(options.traceMode == "off",
+                            "traceMode must be text, binary, legacy or off");
+    }
+    NS_ABORT_MSG_IF(options.traceCapture && options.traceMode != "text" &&
+                        options.traceMode != "binary",
+                    "traceCapture needs traceMode text or binary");
 
     //configuração do flowmonitor
 
     FlowMonitorHelper flowmon;
     Ptr<FlowMonitor> monitor = flowmon.InstallAll();
     monitor->CheckForLostPackets();
-    
-    // Run simulation
-    Simulator::Stop(Seconds(simTime));
-    Simulator::Run();
 
-    std::string tr_name("/home/christhian/5g/ns-3-dev/scratch/results/ex_nrHandover");
+    // rx bytes/packets, losses and delay of each downlink flow per interval
+    FlowSampler flowSampler;
+    if (options.flowSampleInterval > 0)
+    {
+        flowSampler.SetInterval(Seconds(options.flowSampleInterval * 1e-3));
+        flowSampler.SetOutputFile(options.outputDir + "/flow-timeseries.txt");
+        flowSampler.SetFlowMonitor(monitor,
+                                   DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier()));
+        for (uint32_t u = 0; u < ueNodes.GetN(); ++u)
+        {
+            flowSampler.AddFlow(serverApps.Get(u)->GetObject<UdpServer>(),
+                                ueIpIface.GetAddress(u),
+                                dlPort);
+        }
+        flowSampler.Start(Seconds(0.4), Seconds(options.simTime));
+    }
 
+    // batch means of the data flows, stopping the run once they have converged
+    KpiConvergence convergence;
+    if (options.earlyStop)
+    {
+        convergence.SetBatch(Seconds(options.earlyStopBatch * 1e-3));
+        convergence.SetPrecision(options.earlyStopPrecision);
+        convergence.SetMinBatches(options.earlyStopMinBatches);
+        convergence.SetHandoverKpis(&kpis, options.earlyStopHandovers);
+        convergence.SetFlowMonitor(monitor,
+                                   DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier()),
+                                   dlPort);
+        convergence.Start(Seconds(0.4));
+    }
 
-    monitor->SerializeToXmlFile(tr_name + ".xml", true, true);
+    // memory, event list, RLC buffers and wall time, to see where a slow run goes
+    TelemetrySampler telemetry;
+    if (options.telemetryInterval > 0)
+    {
+        telemetry.SetInterval(Seconds(options.telemetryInterval * 1e-3));
+        telemetry.SetOutputDirectory(options.outputDir);
+        telemetry.TrackRlc(gnbNetDev);
+        telemetry.Start(Seconds(options.telemetryInterval * 1e-3));
+    }
+    
+    // Run simulation
+    // Replicas: setup and warm-up once, then each forked child continues with its own
+    // random run (or backlog window) and output directory
+    auto retarget = [&]() {
+        measurements.SetOutputFile(options.outputDir + (measurementFormat == "binary"
+                                                            ? "/measurements.bin"
+                                                            : "/measurements.txt"));
+        handoverLog.SetOutputFile(options.outputDir + "/handover-events.txt");
+        traceOutput.SetDirectory(options.outputDir);
+        flowSampler.SetOutputFile(options.outputDir + "/flow-timeseries.txt");
+        telemetry.SetOutputDirectory(options.outputDir);
+        if (options.logging && options.logSink == "ring")
+        {
+            logRing.Open(options.outputDir + "/log-ring.bin", options.logRingEntries);
+        }
+    };
+    const uint32_t replica =
+        RunReplicas(options, nrHelper, gnbNetDev, ueNetDev, allBwps, clientApps, retarget);
+
+    Simulator::Stop(Seconds(options.simTime) - Simulator::Now());
+    auto runStart = std::chrono::steady_clock::now();
+    Simulator::Run();
+    const double runWallSeconds =
+        std::chrono::duration<double>(std::chrono::steady_clock::now() - runStart).count();
+    traceOutput.Close();
+    if (options.flowSampleInterval > 0)
+    {
+        flowSampler.Finish();
+    }
+    if (options.telemetryInterval > 0)
+    {
+        telemetry.Finish();
+    }
+    if (options.profile)
+    {
+        std::ofstream profileFile(options.outputDir + "/profile.txt");
+        ProfilingMapScheduler::Report(profileFile);
+        ProfilingMapScheduler::Report(std::cout);
+    }
+    measurements.Finish();
+
+    // per-flow bitrate/delay/loss straight from the flow stats, no XML round trip
+    auto classifier = DynamicCast<Ipv4FlowClassifier>(flowmon.GetClassifier());
+    FlowSummaryExporter flowExporter;
+    flowExporter.SetFirstFlowId(options.flowFirstId);
+    FlowSummaryExporter::Write(flowExporter.Collect(monitor, classifier),
+                               options.outputDir + "/flows.csv");
+    FlowSummaryExporter dataFlowFilter;
+    dataFlowFilter.SetDestinationPort(dlPort);
+    FlowSummary dataFlows =
+        FlowSummaryExporter::Aggregate(dataFlowFilter.Collect(monitor, classifier));
+    if (options.flowmonXml)
+    {
+        std::string tr_name(options.outputDir + "/ex_nrHandover");
+        monitor->SerializeToXmlFile(tr_name + ".xml", true, true);
+    }
 
  
     // Check received packets on first UE
     Ptr<UdpServer> serverApp = serverApps.Get(0)->GetObject<UdpServer>();
     uint64_t receivedPackets = serverApp->GetReceived();
- 
+
+    // one-row summary of this run, merged across runs by sweep-handover.py
+    summary.Set("program", "nr-handover");
+    options.AddToSummary(summary);
+    summary.Set("gnbs", gnbNodes.GetN());
+    summary.Set("ues", ueNodes.GetN());
+    summary.Set("attachSeconds", attachSeconds);
+    summary.Set("channelUpdatePeriodMs", channelPeriod.GetSeconds() * 1e3);
+    if (options.telemetryInterval > 0)
+    {
+        telemetry.AddToSummary(summary);
+    }
+    summary.Set("rngRun", RngSeedManager::GetRun());
+    summary.Set("replica", replica);
+    summary.Set("events", Simulator::GetEventCount());
+    summary.Set("runWallSeconds", runWallSeconds);
+    if (options.traceCapture)
+    {
+        traceOutput.AddToSummary(summary);
+    }
+    summary.Set("rxPackets", receivedPackets);
+    summary.Set("lostPackets", serverApp->GetLost());
+    kpis.AddToSummary(summary);
+    if (options.earlyStop)
+    {
+        convergence.AddToSummary(summary);
+    }
+    FlowSummaryExporter::AddToSummary(dataFlows, summary);
+    options.WriteSummary(summary, hash);
+
     Simulator::Destroy();
 
-    organizar("scratch/results/nrHandover/");
+    if (options.traceMode == "legacy")
+    {
+        organizar(options.outputDir);
+    }
 
  
-    return (receivedPackets == 10) ? EXIT_SUCCESS : EXIT_FAILURE;
+    // a completed run succeeds unless the downlink flow was never served
+    return (receivedPackets >= 10) ? EXIT_SUCCESS : EXIT_FAILURE;
 }
 
 void organizar(std::string caminho_res){
@@ -300,7 +758,7 @@ void organizar(std::string caminho_res){
         // Loop para mover cada arquivo
         for (const auto& filename : traceFiles) {
             fs::path sourcePath = filename;              // Arquivo na raiz
-            fs::path destPath = outputDir + filename;    // Destino
+            fs::path destPath = fs::path(outputDir) / filename; // Destino
 
             if (fs::exists(sourcePath)) {
                 // Sobrescreve se já existir lá dentro
@@ -0,0 +1,59 @@
+"""! Converter of the NR text traces to the indexed columnar format.
+
+Converts RxPacketTrace.txt, DlRxPhyStats.txt, UlRxPhyStats.txt or any text trace
+with a header line (as written by EnableTraces and moved by organizar()) into a
+file read by nr-trace-query.py: fixed-width columns sorted by time, a sparse time
+index, posting lists per cellId/RNTI/IMSI and the cell changes (nr_trace_index.py).
+The file is written next to the trace with the .idx extension.
+
+RxPacketTrace has no IMSI column: with several UEs, pass the handover-events.txt of
+the run with --events to attribute its rows to the UEs, otherwise the cell changes
+are only kept for a single UE.
+
+Example:
+    python3 scratch/nr-trace-index.py scratch/results/ex005/RxPacketTrace.txt \\
+        --events scratch/results/ex005/handover-events.txt
+"""
+
+import argparse
+import os
+import sys
+import time
+
+import nr_trace_index
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("traces", nargs="+", help="text trace files")
+    parser.add_argument("--output-dir", help="directory of the .idx files (default: the trace's)")
+    parser.add_argument(
+        "--block", type=int, default=nr_trace_index.BLOCK, help="rows per sparse index entry"
+    )
+    parser.add_argument(
+        "--events", help="handover-events.txt giving the IMSI of the (cellId, RNTI) pairs"
+    )
+    args = parser.parse_args(argv[1:])
+
+    for trace in args.traces:
+        directory = args.output_dir or os.path.dirname(trace)
+        target = os.path.join(directory, os.path.splitext(os.path.basename(trace))[0] + ".idx")
+        start = time.monotonic()
+        info = nr_trace_index.convert(trace, target, args.block, args.events)
+        print(
+            "%s: %d rows, %d columns (%s)%s in %.1f s -> %s"
+            % (
+                trace,
+                info["rows"],
+                len(info["columns"]),
+                ", ".join(info["columns"]),
+                "" if info["sorted"] else ", sorted by time",
+                time.monotonic() - start,
+                target,
+            )
+        )
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
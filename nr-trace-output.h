@@ -0,0 +1,526 @@
+#ifndef NR_TRACE_OUTPUT_H
+#define NR_TRACE_OUTPUT_H
+
+/**
+ * @file nr-trace-output.h
+ * @brief Packet and SINR traces of the NR PHY written straight into the run directory.
+ *
+ * Replaces NrHelper::EnableTraces for the traces these scenarios analyse. The stage
+ * connects directly to the PHY trace sources, keeps the records in memory and writes
+ * them in large blocks into the output directory given up front, either as text or
+ * as packed binary records. The binary files are decoded by nr-trace-reader.py.
+ *
+ * Files:
+ * - RxPacketTrace.{txt,bin}: one RxPacketRecord per received transport block
+ *   (DL at the UEs, UL at the gNBs)
+ * - DlSinrTrace.{txt,bin}: one SinrRecord per DL data SINR report and per serving
+ *   cell RSRP/SINR report of the UEs
+ *
+ * Binary files start with the 4 bytes "NRTR", then uint32 version, uint32 record
+ * type (1 rx packet, 2 SINR) and uint32 record size, followed by the records.
+ *
+ * In capture mode the records are kept in fixed-size rings instead, like an
+ * oscilloscope: a trigger (UE handover start, radio link failure, or a UE SINR falling
+ * below a threshold) writes the records of the pre-trigger window out of the rings and
+ * every record of the post-trigger window straight to the files. The files have the
+ * same format, with gaps between the captured windows.
+ */
+
+#include "buffered-file-writer.h"
+#include "run-summary.h"
+
+#include "ns3/core-module.h"
+#include "ns3/nr-module.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <limits>
+#include <ostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+/// One received transport block, the fields of RxPacketTrace.txt
+struct RxPacketRecord
+{
+    static constexpr uint32_t TYPE = 1;
+
+    int64_t timeNs;    //!< Reception time
+    uint32_t frame;    //!< Frame number
+    uint32_t tbSize;   //!< Transport block size in bytes
+    uint16_t cellId;   //!< Cell of the transmission
+    uint16_t rnti;     //!< UE RNTI
+    uint16_t bwpId;    //!< Bandwidth part
+    uint16_t slot;     //!< Slot number
+    uint8_t direction; //!< 0 for DL (received by a UE), 1 for UL (received by a gNB)
+    uint8_t subframe;  //!< Subframe number
+    uint8_t symStart;  //!< First OFDM symbol
+    uint8_t numSym;    //!< Number of OFDM symbols
+    uint8_t mcs;       //!< MCS
+    uint8_t rank;      //!< MIMO rank
+    uint8_t rv;        //!< Redundancy version
+    uint8_t corrupt;   //!< 1 if the TB was received in error
+    double sinrDb;     //!< Average SINR of the TB
+    double tbler;      //!< Transport block error rate
+
+    static const char* TextHeader()
+    {
+        return "Time\tdirection\tframe\tsubF\tslot\t1stSym\tnSymbol\tcellId\tbwpId\trnti\ttbSize"
+               "\tmcs\trank\trv\tSINR(dB)\tcorrupt\tTBler\n";
+    }
+
+    void WriteText(std::ostream& os) const
+    {
+        char time[32];
+        std::snprintf(time, sizeof(time), "%.9f", timeNs * 1e-9);
+        os << time << "\t" << (direction ? "UL" : "DL") << "\t" << frame << "\t"
+           << +subframe << "\t" << slot << "\t" << +symStart << "\t" << +numSym << "\t" << cellId
+           << "\t" << bwpId << "\t" << rnti << "\t" << tbSize << "\t" << +mcs << "\t" << +rank
+           << "\t" << +rv << "\t" << sinrDb << "\t" << +corrupt << "\t" << tbler << "\n";
+    }
+};
+
+static_assert(sizeof(RxPacketRecord) == 48, "RxPacketRecord must stay packed");
+
+/// One SINR (and optionally RSRP) report of a UE
+struct SinrRecord
+{
+    static constexpr uint32_t TYPE = 2;
+
+    int64_t timeNs;  //!< Report time
+    uint16_t cellId; //!< Serving cell
+    uint16_t rnti;   //!< UE RNTI
+    uint16_t bwpId;  //!< Bandwidth part
+    uint8_t kind;    //!< 0 for a DL data SINR report, 1 for a serving cell RSRP/SINR report
+    uint8_t padding; //!< Always 0
+    double sinrDb;   //!< Average SINR
+    double rsrpDbm;  //!< RSRP, NaN for data SINR reports
+
+    static const char* TextHeader()
+    {
+        return "Time\tkind\tcellId\tbwpId\trnti\tSINR(dB)\tRSRP(dBm)\n";
+    }
+
+    void WriteText(std::ostream& os) const
+    {
+        char time[32];
+        std::snprintf(time, sizeof(time), "%.9f", timeNs * 1e-9);
+        os << time << "\t" << (kind ? "rsrp" : "data") << "\t" << cellId << "\t" << bwpId
+           << "\t" << rnti << "\t" << sinrDb << "\t" << rsrpDbm << "\n";
+    }
+};
+
+static_assert(sizeof(SinrRecord) == 32, "SinrRecord must stay packed");
+
+/**
+ * @brief Buffered file of records of one type, in text or binary encoding.
+ *
+ * Records are kept in a vector and formatted (text) or copied (binary) in blocks. In
+ * capture mode, records past the end of the last triggered window go to a ring of the
+ * most recent ones instead. The ring only overwrites records older than the pre-trigger
+ * window and grows otherwise, so the window is never cut whatever the record rate.
+ */
+template <class Record>
+class TraceRecordFile
+{
+  public:
+    explicit TraceRecordFile(std::size_t blockRecords = 16384)
+        : m_blockRecords(blockRecords)
+    {
+        m_records.reserve(m_blockRecords);
+    }
+
+    ~TraceRecordFile()
+    {
+        Close();
+    }
+
+    /**
+     * @brief Set the output file and write its header.
+     * @param path output file
+     * @param binary whether to write packed records instead of text lines
+     */
+    void Open(const std::string& path, bool binary)
+    {
+        m_binary = binary;
+        m_writer.SetPath(path);
+        if (m_binary)
+        {
+            const uint32_t header[] = {1, Record::TYPE, sizeof(Record)};
+            m_writer.Write("NRTR", 4);
+            m_writer.Write(header, sizeof(header));
+        }
+        else
+        {
+            m_writer.Write(std::string(Record::TextHeader()));
+        }
+    }
+
+    /// @brief Change the output file, before the first flush.
+    void SetPath(const std::string& path)
+    {
+        m_writer.SetPath(path);
+    }
+
+    /**
+     * @brief Keep records in a ring until a trigger instead of writing them all.
+     * @param preNs pre-trigger window the ring must hold
+     * @param ringRecords initial capacity of the ring
+     */
+    void SetCapture(int64_t preNs, std::size_t ringRecords)
+    {
+        NS_ABORT_MSG_IF(ringRecords == 0, "The capture ring needs a capacity");
+        m_ring.assign(ringRecords, Record{});
+        m_ringHead = 0;
+        m_ringSize = 0;
+        m_capturePreNs = preNs;
+        m_capture = true;
+    }
+
+    /// @return capacity the capture ring grew to
+    std::size_t GetRingCapacity() const
+    {
+        return m_ring.size();
+    }
+
+    /// @brief Append a record.
+    void Add(const Record& record)
+    {
+        if (m_capture && record.timeNs > m_writeUntilNs)
+        {
+            if (m_ringSize == m_ring.size() &&
+                m_ring[m_ringHead].timeNs >= record.timeNs - m_capturePreNs)
+            {
+                GrowRing();
+            }
+            if (m_ringSize < m_ring.size())
+            {
+                m_ring[(m_ringHead + m_ringSize++) % m_ring.size()] = record;
+            }
+            else
+            {
+                m_ring[m_ringHead] = record;
+                m_ringHead = (m_ringHead + 1) % m_ring.size();
+            }
+            return;
+        }
+        Append(record);
+    }
+
+    /**
+     * @brief Write the ring records from fromNs on, and every record up to untilNs.
+     * @param fromNs start of the pre-trigger window
+     * @param untilNs end of the post-trigger window
+     */
+    void Trigger(int64_t fromNs, int64_t untilNs)
+    {
+        // the ring only holds records newer than the written ones, oldest first
+        for (std::size_t i = 0; i < m_ringSize; ++i)
+        {
+            const Record& r = m_ring[(m_ringHead + i) % m_ring.size()];
+            if (r.timeNs >= fromNs)
+            {
+                Append(r);
+            }
+        }
+        m_ringHead = 0;
+        m_ringSize = 0;
+        m_writeUntilNs = std::max(m_writeUntilNs, untilNs);
+    }
+
+    /// @brief Hand the buffered records to the writer.
+    void Flush()
+    {
+        if (m_records.empty())
+        {
+            return;
+        }
+        if (m_binary)
+        {
+            m_writer.Write(m_records.data(), m_records.size() * sizeof(Record));
+        }
+        else
+        {
+            std::ostringstream block;
+            for (const auto& r : m_records)
+            {
+                r.WriteText(block);
+            }
+            m_writer.Write(block.str());
+        }
+        m_records.clear();
+    }
+
+    /// @brief Flush and close the file.
+    void Close()
+    {
+        Flush();
+        m_writer.Close();
+    }
+
+  private:
+    void Append(const Record& record)
+    {
+        m_records.push_back(record);
+        if (m_records.size() >= m_blockRecords)
+        {
+            Flush();
+        }
+    }
+
+    /// Double the ring, its oldest record still being inside the pre-trigger window
+    void GrowRing()
+    {
+        std::vector<Record> ring;
+        ring.reserve(2 * m_ring.size());
+        for (std::size_t i = 0; i < m_ringSize; ++i)
+        {
+            ring.push_back(m_ring[(m_ringHead + i) % m_ring.size()]);
+        }
+        ring.resize(2 * m_ring.size());
+        m_ring.swap(ring);
+        m_ringHead = 0;
+    }
+
+    std::vector<Record> m_records; //!< Records not yet handed to the writer
+    BufferedFileWriter m_writer;   //!< Output file
+    std::size_t m_blockRecords;    //!< Records per flush
+    bool m_binary{false};          //!< Encoding
+    bool m_capture{false};         //!< Whether records wait in the ring for a trigger
+    std::vector<Record> m_ring;    //!< Most recent records not written, capture mode
+    std::size_t m_ringHead{0};     //!< Oldest record of the ring
+    std::size_t m_ringSize{0};     //!< Records in the ring
+    int64_t m_writeUntilNs{-1};    //!< End of the last triggered window
+    int64_t m_capturePreNs{0};     //!< Pre-trigger window the ring holds
+};
+
+class NrTraceOutput
+{
+  public:
+    /**
+     * @brief Set the directory the trace files are created in.
+     * @param directory output directory, must exist
+     * @param binary whether to write packed binary records instead of text
+     */
+    void Open(const std::string& directory, bool binary)
+    {
+        const std::string ext = binary ? ".bin" : ".txt";
+        m_rxPackets.Open(directory + "/RxPacketTrace" + ext, binary);
+        m_sinr.Open(directory + "/DlSinrTrace" + ext, binary);
+        m_ext = ext;
+    }
+
+    /// @brief Move the files of an opened output to another directory, before their first flush.
+    void SetDirectory(const std::string& directory)
+    {
+        if (m_ext.empty())
+        {
+            return;
+        }
+        m_rxPackets.SetPath(directory + "/RxPacketTrace" + m_ext);
+        m_sinr.SetPath(directory + "/DlSinrTrace" + m_ext);
+    }
+
+    /**
+     * @brief Only write the records around triggers, must be called before Install.
+     * @param pre window written before a trigger
+     * @param post window written after a trigger
+     * @param sinrThresholdDb a UE SINR report falling below it is a trigger
+     * @param ringRecords initial records kept per file while waiting for a trigger
+     */
+    void SetCapture(Time pre, Time post, double sinrThresholdDb, std::size_t ringRecords = 65536)
+    {
+        NS_ABORT_MSG_IF(pre.IsStrictlyNegative() || post.IsStrictlyNegative(),
+                        "The capture windows cannot be negative");
+        m_capturePreNs = pre.GetNanoSeconds();
+        m_capturePostNs = post.GetNanoSeconds();
+        m_captureSinrDb = sinrThresholdDb;
+        m_capture = true;
+        m_rxPackets.SetCapture(m_capturePreNs, ringRecords);
+        m_sinr.SetCapture(m_capturePreNs, ringRecords);
+    }
+
+    /// @brief Write the pre-trigger window and start a post-trigger window now.
+    void Trigger()
+    {
+        const int64_t now = Simulator::Now().GetNanoSeconds();
+        m_rxPackets.Trigger(now - m_capturePreNs, now + m_capturePostNs);
+        m_sinr.Trigger(now - m_capturePreNs, now + m_capturePostNs);
+        ++m_triggers;
+    }
+
+    /// @return number of triggers so far
+    uint64_t GetTriggers() const
+    {
+        return m_triggers;
+    }
+
+    /// @return records the capture rings of both files grew to hold
+    std::size_t GetRingCapacity() const
+    {
+        return m_rxPackets.GetRingCapacity() + m_sinr.GetRingCapacity();
+    }
+
+    /// @brief Add the capture triggers and ring size to the summary of the run.
+    void AddToSummary(RunSummary& summary) const
+    {
+        summary.Set("traceTriggers", GetTriggers());
+        summary.Set("traceRingRecords", GetRingCapacity());
+    }
+
+    /**
+     * @brief Connect to the PHY trace sources of the first bandwidth part of each device.
+     *
+     * In capture mode also connects the triggers to the UE RRC trace sources.
+     * @param ueDevices the NrUeNetDevice instances
+     * @param gnbDevices the NrGnbNetDevice instances
+     */
+    void Install(const NetDeviceContainer& ueDevices, const NetDeviceContainer& gnbDevices)
+    {
+        for (uint32_t i = 0; i < ueDevices.GetN(); ++i)
+        {
+            Ptr<NrUePhy> phy = NrHelper::GetUePhy(ueDevices.Get(i), 0);
+            const uint32_t ue = m_lastDataSinrDb.size();
+            m_lastDataSinrDb.push_back(std::numeric_limits<double>::quiet_NaN());
+            m_lastCellSinrDb.push_back(std::numeric_limits<double>::quiet_NaN());
+            phy->GetSpectrumPhy()->TraceConnectWithoutContext(
+                "RxPacketTraceUe",
+                MakeBoundCallback(&NrTraceOutput::RxPacket, this, uint8_t(0)));
+            phy->TraceConnectWithoutContext("DlDataSinr",
+                                            MakeBoundCallback(&NrTraceOutput::DataSinr, this, ue));
+            phy->TraceConnectWithoutContext(
+                "ReportCurrentCellRsrpSinr",
+                MakeBoundCallback(&NrTraceOutput::CellRsrpSinr, this, ue));
+            if (m_capture)
+            {
+                auto rrc = DynamicCast<NrUeNetDevice>(ueDevices.Get(i))->GetRrc();
+                bool ok = rrc->TraceConnectWithoutContext(
+                              "HandoverStart",
+                              MakeBoundCallback(&NrTraceOutput::HandoverStart, this)) &&
+                          rrc->TraceConnectWithoutContext(
+                              "RadioLinkFailure",
+                              MakeBoundCallback(&NrTraceOutput::RadioLinkFailure, this));
+                NS_ABORT_MSG_UNLESS(ok, "Missing UE RRC trace source for the trace capture");
+            }
+        }
+        for (uint32_t i = 0; i < gnbDevices.GetN(); ++i)
+        {
+            Ptr<NrGnbPhy> phy = NrHelper::GetGnbPhy(gnbDevices.Get(i), 0);
+            phy->GetSpectrumPhy()->TraceConnectWithoutContext(
+                "RxPacketTraceGnb",
+                MakeBoundCallback(&NrTraceOutput::RxPacket, this, uint8_t(1)));
+        }
+    }
+
+    /// @brief Write the remaining records and close the files.
+    void Close()
+    {
+        m_rxPackets.Close();
+        m_sinr.Close();
+    }
+
+  private:
+    static void RxPacket(NrTraceOutput* out, uint8_t direction, RxPacketTraceParams params)
+    {
+        RxPacketRecord r;
+        r.timeNs = Simulator::Now().GetNanoSeconds();
+        r.frame = params.m_frameNum;
+        r.tbSize = params.m_tbSize;
+        r.cellId = params.m_cellId;
+        r.rnti = params.m_rnti;
+        r.bwpId = params.m_bwpId;
+        r.slot = params.m_slotNum;
+        r.direction = direction;
+        r.subframe = params.m_subframeNum;
+        r.symStart = params.m_symStart;
+        r.numSym = params.m_numSym;
+        r.mcs = params.m_mcs;
+        r.rank = params.m_rank;
+        r.rv = params.m_rv;
+        r.corrupt = params.m_corrupt;
+        r.sinrDb = 10 * std::log10(params.m_sinr);
+        r.tbler = params.m_tbler;
+        out->m_rxPackets.Add(r);
+    }
+
+    static void DataSinr(NrTraceOutput* out,
+                         uint32_t ue,
+                         uint16_t cellId,
+                         uint16_t rnti,
+                         double avgSinr,
+                         uint16_t bwpId)
+    {
+        out->m_sinr.Add({Simulator::Now().GetNanoSeconds(),
+                         cellId,
+                         rnti,
+                         bwpId,
+                         0,
+                         0,
+                         10 * std::log10(avgSinr),
+                         std::numeric_limits<double>::quiet_NaN()});
+        out->CheckSinr(out->m_lastDataSinrDb[ue], 10 * std::log10(avgSinr));
+    }
+
+    static void CellRsrpSinr(NrTraceOutput* out,
+                             uint32_t ue,
+                             uint16_t cellId,
+                             uint16_t rnti,
+                             double power,
+                             double avgSinr,
+                             uint16_t bwpId)
+    {
+        out->m_sinr.Add({Simulator::Now().GetNanoSeconds(),
+                         cellId,
+                         rnti,
+                         bwpId,
+                         1,
+                         0,
+                         10 * std::log10(avgSinr),
+                         10 * std::log10(power) + 30});
+        out->CheckSinr(out->m_lastCellSinrDb[ue], 10 * std::log10(avgSinr));
+    }
+
+    /// Trigger when a SINR source of a UE falls below the threshold, given its last report
+    void CheckSinr(double& lastSinrDb, double sinrDb)
+    {
+        if (m_capture && sinrDb < m_captureSinrDb && !(lastSinrDb < m_captureSinrDb))
+        {
+            Trigger();
+        }
+        lastSinrDb = sinrDb;
+    }
+
+    static void HandoverStart(NrTraceOutput* out,
+                              uint64_t imsi,
+                              uint16_t cellId,
+                              uint16_t rnti,
+                              uint16_t targetCellId)
+    {
+        out->Trigger();
+    }
+
+    static void RadioLinkFailure(NrTraceOutput* out, uint64_t imsi, uint16_t cellId, uint16_t rnti)
+    {
+        out->Trigger();
+    }
+
+    TraceRecordFile<RxPacketRecord> m_rxPackets; //!< RxPacketTrace file
+    TraceRecordFile<SinrRecord> m_sinr;          //!< DlSinrTrace file
+    std::string m_ext;                           //!< File extension, empty until Open
+    bool m_capture{false};                       //!< Whether only the triggered windows are written
+    int64_t m_capturePreNs{0};                   //!< Window written before a trigger
+    int64_t m_capturePostNs{0};                  //!< Window written after a trigger
+    double m_captureSinrDb{0};                   //!< SINR falling below it triggers
+    uint64_t m_triggers{0};                      //!< Triggers so far
+    std::vector<double> m_lastDataSinrDb;        //!< Last data SINR report of each UE
+    std::vector<double> m_lastCellSinrDb;        //!< Last control SINR report of each UE
+};
+
+} // namespace ns3
+
+#endif // NR_TRACE_OUTPUT_H
@@ -0,0 +1,148 @@
+"""! Queries on the indexed NR traces written by nr-trace-index.py.
+
+The file is memory-mapped: the time range is found through the sparse time
+index, the rows of a cellId, RNTI or IMSI through their posting lists, and only
+the pages of the selected rows and columns are read.
+
+Example:
+    # SINR timeline of RNTI 1 between 2.0 and 2.5 s
+    python3 scratch/nr-trace-query.py RxPacketTrace.idx --rnti 1 --from 2.0 --to 2.5 \\
+        --columns Time,cellId,SINR(dB)
+    # rows with SINR below -25 dB
+    python3 scratch/nr-trace-query.py RxPacketTrace.idx --max "SINR(dB)=-25"
+    # all cellId transitions (several UEs need nr-trace-index.py --events)
+    python3 scratch/nr-trace-query.py RxPacketTrace.idx --transitions
+"""
+
+import argparse
+import math
+import sys
+import time
+
+import nr_trace_index
+
+
+def bound(index, text):
+    """! "column=value" -> (column values, value)."""
+    name, _, value = text.partition("=")
+    if name not in index.columns:
+        raise SystemExit("No column %s in %s" % (name, ", ".join(index.names)))
+    return index.column(name), float(value)
+
+
+def nanoseconds(seconds):
+    """! Seconds (or +-inf) -> int64 nanoseconds of the time column."""
+    if math.isinf(seconds):
+        return 2**63 - 1 if seconds > 0 else -(2**63)
+    return round(seconds * 1e9)
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("file", help=".idx file written by nr-trace-index.py")
+    parser.add_argument("--cell", type=int, help="keep only this cellId")
+    parser.add_argument("--rnti", type=int, help="keep only this RNTI")
+    parser.add_argument("--imsi", type=int, help="keep only this IMSI")
+    parser.add_argument("--from", dest="start", type=float, default=-math.inf, help="seconds")
+    parser.add_argument("--to", dest="stop", type=float, default=math.inf, help="seconds")
+    parser.add_argument("--columns", help="comma separated columns to print (default: all)")
+    parser.add_argument(
+        "--min", action="append", default=[], metavar="COLUMN=VALUE", help="keep column >= value"
+    )
+    parser.add_argument(
+        "--max", action="append", default=[], metavar="COLUMN=VALUE", help="keep column <= value"
+    )
+    parser.add_argument("--transitions", action="store_true", help="print the cellId changes")
+    parser.add_argument("--count", action="store_true", help="only count the matching rows")
+    args = parser.parse_args(argv[1:])
+
+    begin = time.monotonic()
+    index = nr_trace_index.TraceIndex(args.file)
+    out = sys.stdout
+    start_ns, stop_ns = nanoseconds(args.start), nanoseconds(args.stop)
+
+    if args.transitions:
+        cell = index.column(index.find_column("cellid"))
+        pairs, by, imsis = index.transitions()
+        if by == "ambiguous":
+            raise SystemExit(
+                "The rows of several UEs cannot be told apart without an IMSI column: "
+                "convert the trace with nr-trace-index.py --events handover-events.txt"
+            )
+        if imsis is None and by == "imsi":
+            column = index.column(index.find_column("imsi"))
+            imsis = [column[new] for _, new in pairs]
+        if args.imsi is not None and imsis is None:
+            raise SystemExit("The transitions of %s are not per IMSI" % args.file)
+        out.write("time\tlastTimeOld\t%sfromCell\ttoCell\n" % ("imsi\t" if imsis else ""))
+        n = 0
+        for i, (old, new) in enumerate(pairs):
+            t = index.time[new]
+            if t < start_ns or t > stop_ns or (args.imsi is not None and imsis[i] != args.imsi):
+                continue
+            out.write(
+                "%.9f\t%.9f\t%s%d\t%d\n"
+                % (
+                    t * 1e-9,
+                    index.time[old] * 1e-9,
+                    "%d\t" % imsis[i] if imsis else "",
+                    cell[old],
+                    cell[new],
+                )
+            )
+            n += 1
+        scope = {
+            "imsi": "per IMSI",
+            "events": "per IMSI of handover-events.txt",
+            "rnti": "of the single UE",
+        }.get(by, "along all rows")
+        sys.stderr.write(
+            "%d transitions (%s) in %.1f ms\n" % (n, scope, (time.monotonic() - begin) * 1e3)
+        )
+        return 0
+
+    equal = {}
+    for lower, value in (("cellid", args.cell), ("rnti", args.rnti), ("imsi", args.imsi)):
+        if value is not None:
+            if index.find_column(lower) is None:
+                raise SystemExit("The trace has no %s column" % lower)
+            equal[lower] = value
+    rows = index.select(start_ns, stop_ns, equal)
+    lows = [bound(index, t) for t in args.min]
+    highs = [bound(index, t) for t in args.max]
+    names = args.columns.split(",") if args.columns else index.names
+    for name in names:
+        if name not in index.columns:
+            raise SystemExit("No column %s in %s" % (name, ", ".join(index.names)))
+    columns = [(name, index.column(name)) for name in names]
+    time_name = index.meta["time"]
+
+    n = 0
+    if not args.count:
+        out.write("\t".join(names) + "\n")
+    for r in rows:
+        if any(values[r] < v for values, v in lows) or any(values[r] > v for values, v in highs):
+            continue
+        n += 1
+        if args.count:
+            continue
+        out.write(
+            "\t".join(
+                "%.9f" % (values[r] * 1e-9) if name == time_name else index.text(name, values[r])
+                for name, values in columns
+            )
+            + "\n"
+        )
+    if args.count:
+        out.write("%d\n" % n)
+    sys.stderr.write(
+        "%d of %d rows in %.1f ms\n" % (n, index.rows, (time.monotonic() - begin) * 1e3)
+    )
+    return 0
+
+
+if __name__ == "__main__":
+    try:
+        sys.exit(main(sys.argv))
+    except BrokenPipeError:
+        sys.exit(0)
@@ -0,0 +1,128 @@
+"""! Decoder of the binary trace files written by the handover scenarios.
+
+Reads RxPacketTrace.bin and DlSinrTrace.bin (nr-trace-output.h) and
+measurements.bin (measurement-recorder.h) and prints them as the same tab
+separated text the programs write with the text encoding, optionally filtered.
+
+Example:
+    python3 scratch/nr-trace-reader.py results/RxPacketTrace.bin --rnti 1 --from 2.0 --to 2.5
+"""
+
+import argparse
+import math
+import struct
+import sys
+
+## Record layouts, keyed by file magic and record type
+RX_PACKET = struct.Struct("<qIIHHHHBBBBBBBBdd")
+SINR = struct.Struct("<qHHHBBdd")
+MEASUREMENT = struct.Struct("<qQHHIddddd")
+
+
+def rx_packet_rows(values):
+    """! RxPacketRecord -> (time, cellId, rnti, text columns)."""
+    (t, frame, tb, cell, rnti, bwp, slot, direction, subf, sym, nsym, mcs, rank, rv, corrupt,
+     sinr, tbler) = values
+    return (
+        t * 1e-9,
+        cell,
+        rnti,
+        [
+            "UL" if direction else "DL", frame, subf, slot, sym, nsym, cell, bwp, rnti, tb,
+            mcs, rank, rv, "%g" % sinr, corrupt, "%g" % tbler,
+        ],
+    )
+
+
+def sinr_rows(values):
+    """! SinrRecord -> (time, cellId, rnti, text columns)."""
+    t, cell, rnti, bwp, kind, _, sinr, rsrp = values
+    return (
+        t * 1e-9,
+        cell,
+        rnti,
+        ["rsrp" if kind else "data", cell, bwp, rnti, "%g" % sinr, "%g" % rsrp],
+    )
+
+
+def measurement_rows(values):
+    """! MeasurementSample -> (time, cellId, rnti, text columns)."""
+    t, imsi, cell, rnti, node, rsrp, sinr, x, y, z = values
+    return (
+        t * 1e-9,
+        cell,
+        rnti,
+        [node, imsi, cell, rnti, "%g" % rsrp, "%g" % sinr, "%g" % x, "%g" % y, "%g" % z],
+    )
+
+
+## magic -> {record type: (struct, header line, row function)}
+FORMATS = {
+    b"NRTR": {
+        1: (RX_PACKET,
+            "Time\tdirection\tframe\tsubF\tslot\t1stSym\tnSymbol\tcellId\tbwpId\trnti\ttbSize"
+            "\tmcs\trank\trv\tSINR(dB)\tcorrupt\tTBler",
+            rx_packet_rows),
+        2: (SINR, "Time\tkind\tcellId\tbwpId\trnti\tSINR(dB)\tRSRP(dBm)", sinr_rows),
+    },
+    b"NRMS": {
+        0: (MEASUREMENT, "time\tnodeId\timsi\tcellId\trnti\tRSRP\tSINR\tx\ty\tz",
+            measurement_rows),
+    },
+}
+
+
+def open_records(path):
+    """! Parse the header of a binary trace file.
+    @return (record struct, header line, row function, payload bytes)
+    """
+    with open(path, "rb") as f:
+        data = f.read()
+    magic = data[:4]
+    if magic == b"NRTR":
+        version, rtype, size = struct.unpack_from("<III", data, 4)
+        offset = 16
+    elif magic == b"NRMS":
+        version, size = struct.unpack_from("<II", data, 4)
+        rtype, offset = 0, 12
+    else:
+        raise ValueError("%s: not a binary trace file" % path)
+    if version != 1:
+        raise ValueError("%s: unsupported version %d" % (path, version))
+    record, header, rows = FORMATS[magic][rtype]
+    if record.size != size:
+        raise ValueError("%s: record size %d, expected %d" % (path, size, record.size))
+    payload = memoryview(data)[offset:]
+    payload = payload[: len(payload) - len(payload) % size]
+    return record, header, rows, payload
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("file", help="RxPacketTrace.bin, DlSinrTrace.bin or measurements.bin")
+    parser.add_argument("--rnti", type=int, help="keep only this RNTI")
+    parser.add_argument("--cell", type=int, help="keep only this cellId")
+    parser.add_argument("--from", dest="start", type=float, default=-math.inf, help="seconds")
+    parser.add_argument("--to", dest="stop", type=float, default=math.inf, help="seconds")
+    args = parser.parse_args(argv[1:])
+
+    record, header, rows, payload = open_records(args.file)
+    out = sys.stdout
+    out.write(header + "\n")
+    for values in record.iter_unpack(payload):
+        t, cell, rnti, columns = rows(values)
+        if t < args.start or t > args.stop:
+            continue
+        if args.rnti is not None and rnti != args.rnti:
+            continue
+        if args.cell is not None and cell != args.cell:
+            continue
+        out.write("%.9f\t%s\n" % (t, "\t".join(str(c) for c in columns)))
+    return 0
+
+
+if __name__ == "__main__":
+    try:
+        sys.exit(main(sys.argv))
+    except BrokenPipeError:
+        sys.exit(0)
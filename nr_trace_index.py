@@ -0,0 +1,406 @@
+"""! Indexed columnar format of the NR text traces, shared by nr-trace-index.py and
+nr-trace-query.py.
+
+A text trace with a header line (RxPacketTrace.txt, DlRxPhyStats.txt,
+UlRxPhyStats.txt, ... as moved by organizar()) becomes one file holding:
+
+- every column as a fixed-width array: integers as int32/int64, reals as
+  float64, text columns (DL/UL) as uint16 codes of a dictionary; the time
+  column as int64 nanoseconds, rows sorted by time
+- a sparse time index: the time of every BLOCK-th row
+- a posting list per value of the cellId, RNTI and IMSI columns: the sorted
+  rows holding the value
+- the pairs of rows (last row in the old cell, first row in the new one) where
+  the cellId changes of a UE. The UE of a row is its IMSI when the trace has one.
+  RxPacketTrace has none: its downlink rows are attributed to an IMSI through the
+  (cellId, RNTI) pairs of handover-events.txt when it is given, and otherwise only
+  a single UE can be followed, recognised by (cellId, RNTI) pairs that never
+  overlap in time; with several UEs the changes are marked ambiguous
+
+Layout: the 4 bytes "NRCI", uint32 version, uint64 length of the JSON metadata,
+the metadata (names, types and offsets of the arrays), then the arrays, each
+aligned to 8 bytes. Readers map the file and only touch the pages a query
+needs.
+"""
+
+import array
+import bisect
+import itertools
+import json
+import mmap
+import struct
+
+MAGIC = b"NRCI"
+VERSION = 1
+PREFIX = struct.Struct("<4sIQ")
+BLOCK = 4096
+INDEXED = ("cellid", "rnti", "imsi")
+
+
+def _parse_header(line):
+    """! Column names of a header line ("% time cellId ..." or "Time\\tdirection...")."""
+    return line.lstrip("%").split()
+
+
+def _column_kind(values):
+    """! 'i' (integer), 'd' (real) or 's' (text) for sample values."""
+    kind = "i"
+    for v in values:
+        try:
+            int(v)
+            continue
+        except ValueError:
+            pass
+        try:
+            float(v)
+            kind = "d"
+        except ValueError:
+            return "s"
+    return kind
+
+
+def _append(column, values, text):
+    """! Append a field to the array of its column."""
+    if column["type"] == "H":
+        codes = column["dictionary"]
+        values.append(codes.setdefault(text, len(codes)))
+    elif column["type"] == "d":
+        values.append(float(text))
+    else:
+        values.append(int(text))
+
+
+def _widen(column, values):
+    """! Convert a column that met a value of another kind: int32 -> int64 -> real -> text.
+    @return the new array, column["type"] updated
+    """
+    if column["type"] == "i":
+        column["type"] = "q"
+        return array.array("q", values)
+    if column["type"] == "q":
+        column["type"] = "d"
+        return array.array("d", values)
+    column["type"] = "H"
+    column["dictionary"] = {}
+    codes = column["dictionary"]
+    return array.array("H", (codes.setdefault("%r" % v, len(codes)) for v in values))
+
+
+def _time_column(names):
+    """! Index of the time column: the one named time, else the first."""
+    for i, n in enumerate(names):
+        if n.lower() == "time":
+            return i
+    return 0
+
+
+def read_events(path):
+    """! (cellId, RNTI) -> sorted [(time in ns, IMSI)] of the events in handover-events.txt."""
+    owners = {}
+    with open(path, encoding="utf-8") as f:
+        names = f.readline().split()
+        time, imsi = names.index("time"), names.index("imsi")
+        rnti, cell = names.index("rnti"), names.index("cellId")
+        for line in f:
+            fields = line.split()
+            if len(fields) == len(names):
+                key = (int(fields[cell]), int(fields[rnti]))
+                owners.setdefault(key, []).append(
+                    (round(float(fields[time]) * 1e9), int(fields[imsi]))
+                )
+    for events in owners.values():
+        events.sort()
+    return owners
+
+
+def _owner(events, time_ns):
+    """! IMSI of the last event at or before time_ns, else of the first event."""
+    i = bisect.bisect_right(events, (time_ns, 2**64))
+    return events[max(i - 1, 0)][1]
+
+
+def _ue_keys(columns, arrays, rows, events):
+    """! UE key of every row, None for a row of no UE, and how the UEs were found."""
+    find = {col["name"].lower(): c for c, col in enumerate(columns)}
+    if "imsi" in find:
+        return arrays[find["imsi"]], "imsi"
+    if "rnti" not in find:
+        return [0] * rows, "all"
+    cells, rntis = arrays[find["cellid"]], arrays[find["rnti"]]
+    # the UL rows are written by the gNBs, keep the UE side
+    downlink = None
+    if "direction" in find and "DL" in columns[find["direction"]].get("dictionary", []):
+        directions = arrays[find["direction"]]
+        code = columns[find["direction"]]["dictionary"].index("DL")
+        downlink = [d == code for d in directions]
+    times = arrays[_time_column([col["name"] for col in columns])]
+    keys = [None] * rows
+    if events is not None:
+        for row in range(rows):
+            owner = events.get((cells[row], rntis[row]))
+            if owner and (downlink is None or downlink[row]):
+                keys[row] = _owner(owner, times[row])
+        return keys, "events"
+    spans = {}
+    for row in range(rows):
+        if downlink is None or downlink[row]:
+            span = spans.setdefault((cells[row], rntis[row]), [row, row])
+            span[1] = row
+            keys[row] = 0
+    ordered = sorted(spans.values())
+    if any(b[0] < a[1] for a, b in zip(ordered, ordered[1:])):
+        return None, "ambiguous"
+    return keys, "rnti"
+
+
+def convert(source, target, block=BLOCK, events=None):
+    """! Convert a text trace.
+    @param events handover-events.txt of the run, gives the IMSI of RxPacketTrace rows
+    @return dict with the number of rows and the names of the columns
+    """
+    with open(source, encoding="utf-8", errors="replace") as f:
+        header = ""
+        for header in f:
+            if header.strip():
+                break
+        names = _parse_header(header)
+        time_col = _time_column(names)
+        # column types from the first rows, then the rows are streamed into the arrays
+        head = []
+        for line in f:
+            fields = line.split()
+            if len(fields) == len(names):
+                head.append(fields)
+                if len(head) == 1000:
+                    break
+        columns = []
+        for c, name in enumerate(names):
+            kind = "q" if c == time_col else _column_kind(r[c] for r in head)
+            columns.append({"name": name, "type": "H" if kind == "s" else kind})
+            if kind == "s":
+                columns[-1]["dictionary"] = {}
+        arrays = [array.array(c["type"]) for c in columns]
+        for fields in itertools.chain(head, (l.split() for l in f)):
+            if len(fields) != len(names):
+                continue
+            try:
+                t = round(float(fields[time_col]) * 1e9)
+            except ValueError:
+                continue
+            for c, (column, values) in enumerate(zip(columns, arrays)):
+                if c == time_col:
+                    values.append(t)
+                    continue
+                while True:
+                    try:
+                        _append(column, values, fields[c])
+                        break
+                    except (ValueError, OverflowError):
+                        arrays[c] = values = _widen(column, values)
+    for column in columns:
+        if "dictionary" in column:
+            if len(column["dictionary"]) > 65535:
+                raise ValueError("column %s has too many distinct values" % column["name"])
+            column["dictionary"] = sorted(column["dictionary"], key=column["dictionary"].get)
+
+    times = arrays[time_col]
+    order = None
+    if any(times[i] > times[i + 1] for i in range(len(times) - 1)):
+        order = sorted(range(len(times)), key=times.__getitem__)
+        for c, values in enumerate(arrays):
+            arrays[c] = array.array(values.typecode, (values[i] for i in order))
+        times = arrays[time_col]
+
+    rows = len(times)
+    # (metadata entry receiving the offset, array)
+    sections = list(zip(columns, arrays))
+    sparse = array.array("q", (times[i] for i in range(0, rows, block)))
+    time_index = {"count": len(sparse)}
+    sections.append((time_index, sparse))
+
+    indexes = {}
+    for c, column in enumerate(columns):
+        if column["name"].lower() not in INDEXED or column["type"] not in ("i", "q"):
+            continue
+        postings = {}
+        for row, v in enumerate(arrays[c]):
+            postings.setdefault(v, array.array("I")).append(row)
+        entries = []
+        for value in sorted(postings):
+            entry = {"value": value, "count": len(postings[value])}
+            sections.append((entry, postings[value]))
+            entries.append(entry)
+        indexes[column["name"].lower()] = entries
+
+    transitions = {"count": 0}
+    cell = next((c for c, col in enumerate(columns) if col["name"].lower() == "cellid"), None)
+    if cell is not None:
+        owners = read_events(events) if events else None
+        keys, by = _ue_keys(columns, arrays, rows, owners)
+        changes = array.array("I")
+        ues = array.array("Q")
+        last = {}
+        cells = arrays[cell]
+        for row in range(rows if keys is not None else 0):
+            key = keys[row]
+            if key is None:
+                continue
+            previous = last.get(key)
+            if previous is not None and cells[previous] != cells[row]:
+                changes.append(previous)
+                changes.append(row)
+                ues.append(key)
+            last[key] = row
+        transitions = {"count": len(changes), "by": by}
+        sections.append((transitions, changes))
+        if by == "events":
+            transitions["imsi"] = {"count": len(ues)}
+            sections.append((transitions["imsi"], ues))
+
+    meta = {
+        "source": source,
+        "rows": rows,
+        "block": block,
+        "time": columns[time_col]["name"],
+        "columns": columns,
+        "time_index": time_index,
+        "indexes": indexes,
+        "transitions": transitions,
+    }
+    # offsets depend on the metadata length, which depends on the offsets: iterate
+    length = 0
+    while True:
+        offset = _align(PREFIX.size + length)
+        for entry, values in sections:
+            entry["offset"] = offset
+            offset = _align(offset + len(values) * values.itemsize)
+        text = json.dumps(meta, separators=(",", ":")).encode()
+        if len(text) <= length:
+            break
+        length = len(text) + 64
+    with open(target, "wb") as f:
+        f.write(PREFIX.pack(MAGIC, VERSION, length))
+        f.write(text.ljust(length, b" "))
+        for entry, values in sections:
+            f.write(b"\0" * (entry["offset"] - f.tell()))
+            values.tofile(f)
+    return {"rows": rows, "columns": [c["name"] for c in columns], "sorted": order is None}
+
+
+def _align(offset):
+    return (offset + 7) // 8 * 8
+
+
+class TraceIndex(object):
+    """! A converted trace, memory-mapped."""
+
+    def __init__(self, path):
+        """! The initializer.
+        @param self The object pointer.
+        @param path File written by convert.
+        """
+        with open(path, "rb") as f:
+            self.data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        magic, version, length = PREFIX.unpack_from(self.data, 0)
+        if magic != MAGIC or version != VERSION:
+            raise ValueError("%s: not a version %d trace index" % (path, VERSION))
+        self.meta = json.loads(bytes(self.data[PREFIX.size : PREFIX.size + length]))
+        self.view = memoryview(self.data)
+        self.rows = self.meta["rows"]
+        self.columns = {}
+        self.names = []
+        for column in self.meta["columns"]:
+            self.columns[column["name"]] = column
+            self.names.append(column["name"])
+        self.time = self._array(self.meta["columns"][self._position(self.meta["time"])], self.rows)
+        self.sparse = self._array(self.meta["time_index"], self.meta["time_index"]["count"])
+
+    def _position(self, name):
+        return self.names.index(name)
+
+    def _array(self, entry, count):
+        """! memoryview of an array of the file."""
+        fmt = entry.get("type", "q")
+        size = struct.calcsize(fmt)
+        return self.view[entry["offset"] : entry["offset"] + count * size].cast(fmt)
+
+    def _array_of(self, entry):
+        """! memoryview of a uint32 array (posting list, transitions) of the file."""
+        return self.view[entry["offset"] : entry["offset"] + entry["count"] * 4].cast("I")
+
+    def column(self, name):
+        """! Values of a column as a memoryview (codes for text columns)."""
+        return self._array(self.columns[name], self.rows)
+
+    def find_column(self, lower):
+        """! Name of the column whose lower case name is lower, or None."""
+        return next((n for n in self.names if n.lower() == lower), None)
+
+    def text(self, name, value):
+        """! Printable value of a column."""
+        dictionary = self.columns[name].get("dictionary")
+        if dictionary is not None:
+            return dictionary[value]
+        if isinstance(value, float):
+            return "%g" % value
+        return str(value)
+
+    def row_range(self, start_ns, stop_ns):
+        """! [first, last) rows with start <= time <= stop, through the sparse index."""
+        block = self.meta["block"]
+        # the first row at or after start is in the block before the first block
+        # starting at or after it, the last row up to stop in the last block starting
+        # up to it
+        b = bisect.bisect_left(self.sparse, start_ns)
+        lo = bisect.bisect_left(
+            self.time, start_ns, max(0, b - 1) * block, min(self.rows, b * block)
+        )
+        b = bisect.bisect_right(self.sparse, stop_ns)
+        hi = bisect.bisect_right(
+            self.time, stop_ns, max(0, b - 1) * block, min(self.rows, b * block)
+        )
+        return lo, max(lo, hi)
+
+    def postings(self, lower, value):
+        """! Sorted rows where the indexed column has value (empty if none)."""
+        for entry in self.meta["indexes"].get(lower, []):
+            if entry["value"] == value:
+                return self._array_of(entry)
+        return memoryview(b"").cast("I")
+
+    def select(self, start_ns, stop_ns, equal):
+        """! Rows within the time range whose columns equal the given values.
+        @param equal dict lower case indexed column name -> value
+        @return list of rows in time order
+        """
+        lo, hi = self.row_range(start_ns, stop_ns)
+        if not equal:
+            return range(lo, hi)
+        # walk the shortest posting list of the window, check the other columns
+        best = None
+        for lower, value in equal.items():
+            if lower not in self.meta["indexes"]:
+                raise ValueError("column %s is not indexed" % lower)
+            rows = self.postings(lower, value)
+            a = bisect.bisect_left(rows, lo)
+            b = bisect.bisect_left(rows, hi)
+            if best is None or b - a < len(best):
+                best = rows[a:b]
+        checks = [(self.column(self.find_column(l)), v) for l, v in equal.items()]
+        return [r for r in best if all(values[r] == v for values, v in checks)]
+
+    def transitions(self):
+        """! (last row in the old cell, first row in the new one) of every cell change.
+        @return (list of pairs, how the rows were attributed to UEs, IMSI of every pair or
+            None): "imsi" from the IMSI column, "events" from handover-events.txt, "rnti"
+            for the single UE of the trace, "all" along all the rows of a trace without
+            RNTI, "ambiguous" (no pairs) for several UEs that could not be told apart
+        """
+        entry = self.meta["transitions"]
+        if not entry["count"]:
+            return [], entry.get("by"), None
+        rows = self._array_of(entry)
+        imsis = None
+        if "imsi" in entry:
+            imsis = self._array(dict(entry["imsi"], type="Q"), entry["imsi"]["count"])
+        return list(zip(rows[0::2], rows[1::2])), entry["by"], imsis
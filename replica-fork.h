@@ -0,0 +1,271 @@
+#ifndef REPLICA_FORK_H
+#define REPLICA_FORK_H
+
+/**
+ * @file replica-fork.h
+ * @brief Fork replicas of a simulation that has been advanced to its warm-up time.
+ *
+ * The setup (devices, antenna arrays, EPC, attachment) and the warm-up period are the
+ * same for every replication of a scenario. A program runs them once, stops the
+ * simulator at the warm-up time and calls ForkReplicas: each child process returns with
+ * its replica number, continues the simulation from the shared state and writes its
+ * own results, while the parent only waits for the children.
+ *
+ * A child must re-target its output files before their first flush (the writers open
+ * their files lazily; BufferedFileWriter::HoldFlushes keeps the warm-up records in
+ * memory) and re-seed whatever it wants to vary, e.g. RngSeedManager::SetRun followed by
+ * the AssignStreams calls of the setup and ReseedChannel for the channel models, which
+ * NrHelper::AssignStreams does not reach. RunReplicas does all of this for the handover
+ * scenarios.
+ */
+
+#include "buffered-file-writer.h"
+#include "handover-options.h"
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/nr-module.h"
+#include "ns3/propagation-module.h"
+#include "ns3/spectrum-module.h"
+
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include <string>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+namespace ns3
+{
+
+/**
+ * @brief Fork n replicas, at most parallel of them running at a time.
+ * @param n number of replicas
+ * @param parallel maximum number of children alive at once
+ * @param failures set in the parent to the number of children that did not exit with 0
+ * @return the replica number 1..n in a child, 0 in the parent after every child exited
+ */
+inline uint32_t
+ForkReplicas(uint32_t n, uint32_t parallel, uint32_t& failures)
+{
+    NS_ABORT_MSG_IF(parallel == 0, "At least one replica must run at a time");
+    // buffered output would be written once per process
+    std::cout.flush();
+    std::cerr.flush();
+    failures = 0;
+    std::set<pid_t> children;
+    auto reap = [&children, &failures]() {
+        int status = 0;
+        pid_t pid = waitpid(-1, &status, 0);
+        if (pid > 0 && children.erase(pid))
+        {
+            failures += !(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        }
+    };
+    for (uint32_t replica = 1; replica <= n; ++replica)
+    {
+        while (children.size() >= parallel)
+        {
+            reap();
+        }
+        pid_t pid = fork();
+        NS_ABORT_MSG_IF(pid < 0, "fork failed for replica " << replica);
+        if (pid == 0)
+        {
+            return replica;
+        }
+        children.insert(pid);
+    }
+    while (!children.empty())
+    {
+        reap();
+    }
+    return 0;
+}
+
+/**
+ * @brief Re-seed the random streams of a channel for the current run number.
+ *
+ * The pathloss (shadowing, O2I), channel condition and 3GPP fast fading models take
+ * automatic streams when they are created, so a new RngRun alone leaves them on the
+ * sequences of the warm-up.
+ * @param channel the spectrum channel of a bandwidth part
+ * @param stream first stream index to use
+ * @return number of streams used
+ */
+inline int64_t
+ReseedChannel(Ptr<SpectrumChannel> channel, int64_t stream)
+{
+    const int64_t first = stream;
+    std::set<Ptr<Object>> done;
+    auto reseedCondition = [&stream, &done](Ptr<Object> model) {
+        PointerValue condition;
+        if (model->GetAttributeFailSafe("ChannelConditionModel", condition))
+        {
+            Ptr<ChannelConditionModel> c = condition.Get<ChannelConditionModel>();
+            if (c && done.insert(c).second)
+            {
+                stream += c->AssignStreams(stream);
+            }
+        }
+    };
+    if (Ptr<PropagationLossModel> pathloss = channel->GetPropagationLossModel())
+    {
+        stream += pathloss->AssignStreams(stream);
+        reseedCondition(pathloss);
+    }
+    for (auto fading = channel->GetPhasedArraySpectrumPropagationLossModel(); fading;
+         fading = fading->GetNext())
+    {
+        stream += fading->AssignStreams(stream);
+        // the 3GPP spectrum model keeps its ThreeGppChannelModel as an attribute
+        PointerValue channelModel;
+        if (fading->GetAttributeFailSafe("ChannelModel", channelModel) &&
+            channelModel.Get<Object>())
+        {
+            Ptr<ThreeGppChannelModel> model = channelModel.Get<ThreeGppChannelModel>();
+            if (model && done.insert(model).second)
+            {
+                stream += model->AssignStreams(stream);
+                reseedCondition(model);
+            }
+        }
+    }
+    return stream - first;
+}
+
+/**
+ * @brief Check that re-seeded replicas gave different results.
+ * @param directory output directory holding replica-1 ... replica-n
+ * @param n number of replicas
+ * @param file a result file every replica writes, e.g. flows.csv
+ * @return the replicas whose file is identical to that of an earlier replica
+ */
+inline std::set<uint32_t>
+FindIdenticalReplicas(const std::string& directory, uint32_t n, const std::string& file)
+{
+    std::set<std::string> seen;
+    std::set<uint32_t> identical;
+    for (uint32_t replica = 1; replica <= n; ++replica)
+    {
+        std::ifstream in(directory + "/replica-" + std::to_string(replica) + "/" + file);
+        if (!in)
+        {
+            continue;
+        }
+        std::string content((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+        if (!seen.insert(content).second)
+        {
+            identical.insert(replica);
+        }
+    }
+    return identical;
+}
+
+/**
+ * @brief Run the warm-up of a handover scenario once and fork its replicas.
+ *
+ * Replicas re-seeded from RngRun (options.replicas), or one replica per backlog window
+ * with the same random run (options.replicaWindows). The parent waits for every
+ * replica and exits; a child moves options.outputDir to its replica-n directory, calls
+ * retarget to open its output files there, and returns to finish the run.
+ * @param options options of the run
+ * @param nrHelper helper that installed the devices
+ * @param gnbNetDev gNB devices
+ * @param ueNetDev UE devices
+ * @param allBwps bandwidth parts holding the channels
+ * @param clientApps downlink clients, BacklogUdpClient with replicaWindows
+ * @param retarget points every output of the run at options.outputDir
+ * @return the replica number in a child, 0 when no replica is asked for
+ */
+inline uint32_t
+RunReplicas(HandoverOptions& options,
+            Ptr<NrHelper> nrHelper,
+            const NetDeviceContainer& gnbNetDev,
+            const NetDeviceContainer& ueNetDev,
+            const BandwidthPartInfoPtrVector& allBwps,
+            const ApplicationContainer& clientApps,
+            const std::function<void()>& retarget)
+{
+    std::vector<uint32_t> windows;
+    std::istringstream windowList(options.replicaWindows);
+    for (std::string w; std::getline(windowList, w, ',');)
+    {
+        windows.push_back(std::stoul(w));
+    }
+    if (!windows.empty())
+    {
+        NS_ABORT_MSG_UNLESS(options.trafficMode == "backlog",
+                            "replicaWindows needs trafficMode=backlog");
+        options.replicas = windows.size();
+    }
+    if (options.replicas == 0)
+    {
+        return 0;
+    }
+    NS_ABORT_MSG_UNLESS(options.warmup > 0 && options.warmup < options.simTime,
+                        "warmup must be within simTime");
+    NS_ABORT_MSG_IF(options.traceMode == "legacy",
+                    "legacy traces cannot be written per replica");
+    NS_ABORT_MSG_IF(options.earlyStop, "earlyStop would cut the warm-up shared by the replicas");
+    const uint64_t baseRun = RngSeedManager::GetRun();
+    // the records of the warm-up stay in memory until each replica has its own files
+    BufferedFileWriter::HoldFlushes(true);
+    Simulator::Stop(Seconds(options.warmup));
+    Simulator::Run();
+    uint32_t failures = 0;
+    const uint32_t replica = ForkReplicas(options.replicas, options.replicaJobs, failures);
+    if (replica == 0)
+    {
+        // nothing of the warm-up is written by the parent
+        std::cout << options.replicas - failures << " of " << options.replicas
+                  << " replicas completed in " << options.outputDir << std::endl;
+        if (windows.empty())
+        {
+            for (uint32_t r :
+                 FindIdenticalReplicas(options.outputDir, options.replicas, "flows.csv"))
+            {
+                std::cerr << "Warning: replica " << r
+                          << " has the same flows.csv as an earlier one, its random "
+                             "streams were not re-seeded"
+                          << std::endl;
+            }
+        }
+        std::_Exit(failures ? EXIT_FAILURE : EXIT_SUCCESS);
+    }
+    options.outputDir += "/replica-" + std::to_string(replica);
+    std::filesystem::create_directories(options.outputDir);
+    if (!windows.empty())
+    {
+        for (uint32_t i = 0; i < clientApps.GetN(); ++i)
+        {
+            clientApps.Get(i)->SetAttribute("MaxInFlight", UintegerValue(windows[replica - 1]));
+        }
+    }
+    else if (replica > 1)
+    {
+        // replica 1 continues the random sequences of the warm-up, like a normal run
+        RngSeedManager::SetRun(baseRun + replica - 1);
+        int64_t stream = options.firstStream;
+        stream += nrHelper->AssignStreams(gnbNetDev, stream);
+        stream += nrHelper->AssignStreams(ueNetDev, stream);
+        for (const auto& bwp : allBwps)
+        {
+            stream += ReseedChannel(bwp.get()->m_channel, stream);
+        }
+    }
+    retarget();
+    BufferedFileWriter::HoldFlushes(false);
+    return replica;
+}
+
+} // namespace ns3
+
+#endif // REPLICA_FORK_H
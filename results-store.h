@@ -0,0 +1,111 @@
+#ifndef RESULTS_STORE_H
+#define RESULTS_STORE_H
+
+/**
+ * @file results-store.h
+ * @brief Append-only store of run summaries keyed by the configuration hash.
+ *
+ * One text line per run: the ConfigHash of the run, then its summary fields as
+ * tab separated "key=value" pairs (KPIs, FlowMonitor summary and the output
+ * directory that holds the trace files). Lines are only ever appended, each with a
+ * single write to a file opened with O_APPEND, so the concurrent jobs of a sweep
+ * can share a store. A run whose hash is found returns the stored summary instead
+ * of simulating.
+ */
+
+#include "run-summary.h"
+
+#include "ns3/core-module.h"
+
+#include <algorithm>
+#include <fcntl.h>
+#include <fstream>
+#include <string>
+#include <unistd.h>
+
+namespace ns3
+{
+
+class ResultsStore
+{
+  public:
+    /// @brief Use this store file, created by the first Append.
+    explicit ResultsStore(const std::string& path)
+        : m_path(path)
+    {
+    }
+
+    /**
+     * @brief Look up a configuration; the last record of the hash wins.
+     * @param hash ConfigHash::GetHash of the configuration
+     * @param summary receives the stored fields when the hash is found; the fields it
+     *        already has (e.g. the number of a batch configuration) are kept
+     * @return true if the hash is in the store
+     */
+    bool Find(const std::string& hash, RunSummary& summary) const
+    {
+        std::ifstream file(m_path);
+        std::string found;
+        for (std::string line; std::getline(file, line);)
+        {
+            if (line.compare(0, hash.size() + 1, hash + "\t") == 0)
+            {
+                found = line;
+            }
+        }
+        if (found.empty())
+        {
+            return false;
+        }
+        const auto kept = summary.GetFields();
+        std::size_t start = hash.size() + 1;
+        while (start < found.size())
+        {
+            std::size_t end = found.find('\t', start);
+            end = end == std::string::npos ? found.size() : end;
+            const std::size_t equal = found.find('=', start);
+            const std::string key = found.substr(start, equal - start);
+            if (equal < end && std::none_of(kept.begin(), kept.end(), [&key](const auto& f) {
+                    return f.first == key;
+                }))
+            {
+                summary.Set(key, found.substr(equal + 1, end - equal - 1));
+            }
+            start = end + 1;
+        }
+        return true;
+    }
+
+    /**
+     * @brief Append the summary of a run.
+     * @param hash ConfigHash::GetHash of the configuration
+     * @param summary fields of the run
+     */
+    void Append(const std::string& hash, const RunSummary& summary) const
+    {
+        std::string line = hash;
+        for (const auto& [key, value] : summary.GetFields())
+        {
+            std::string clean = value;
+            for (char& c : clean)
+            {
+                c = (c == '\t' || c == '\n') ? ' ' : c;
+            }
+            line += "\t" + key + "=" + clean;
+        }
+        line += "\n";
+        int fd = open(m_path.c_str(), O_WRONLY | O_APPEND | O_CREAT, 0644);
+        NS_ABORT_MSG_IF(fd < 0, "Unable to open " << m_path);
+        const ssize_t written = write(fd, line.data(), line.size());
+        close(fd);
+        NS_ABORT_MSG_IF(written != static_cast<ssize_t>(line.size()),
+                        "Unable to append to " << m_path);
+    }
+
+  private:
+    std::string m_path; //!< Store file
+};
+
+} // namespace ns3
+
+#endif // RESULTS_STORE_H
@@ -0,0 +1,406 @@
+#ifndef RSRP_PRESCREEN_H
+#define RSRP_PRESCREEN_H
+
+/**
+ * @file rsrp-prescreen.h
+ * @brief Predicted handover points from the RSRP of every cell, without the NR stack.
+ *
+ * The pre-screen reuses the nodes, the mobility and the 3GPP propagation loss model
+ * (pathloss, shadowing and channel condition) of a scenario, but no NR device is
+ * installed: the simulator only runs the steps of the walk. At every step each UE
+ * computes the RSRP of every cell (gNB TX power spread over the resource elements,
+ * array gains of ideal beamforming, element gain of the sector antenna, pathloss),
+ * passes it through the layer 3 filter and applies the trigger of the handover
+ * algorithm to the filtered values:
+ *
+ * - A3 (RSRP): a neighbour better than the serving cell by the hysteresis during
+ *   the time to trigger
+ * - A2-A4 (RSRQ): serving RSRQ range below ServingCellThreshold and a neighbour at
+ *   least NeighbourCellOffset ranges better; the RSRQ assumes fully loaded cells
+ *
+ * The serving cell changes at the trigger, the handover itself is not modelled, and
+ * fast fading is not included. The predicted handovers, the ping-pongs (back to the
+ * previous cell within the window) and the shortest dwell between two handovers of
+ * a UE tell a sweep point worth a full simulation from one that is not.
+ */
+
+#include "handover-options.h"
+#include "hex-topology.h"
+#include "run-summary.h"
+
+#include "ns3/antenna-module.h"
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/network-module.h"
+#include "ns3/propagation-module.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <limits>
+#include <string>
+#include <vector>
+
+namespace ns3
+{
+
+class RsrpPrescreen
+{
+  public:
+    /// @brief Set the propagation loss model of the channel, e.g. the 3GPP one.
+    void SetPropagationLossModel(Ptr<PropagationLossModel> model)
+    {
+        m_lossModel = model;
+    }
+
+    /**
+     * @brief Set the transmission of every cell.
+     * @param txPowerDbm gNB TX power over the whole bandwidth
+     * @param bandwidth channel bandwidth in Hz, 15 kHz subcarriers
+     */
+    void SetTransmission(double txPowerDbm, double bandwidth)
+    {
+        m_resourceElements = std::max(12.0, std::floor(bandwidth / 15e3 / 12) * 12);
+        m_txPerReDbm = txPowerDbm - 10 * std::log10(m_resourceElements);
+        // thermal noise of one subcarrier and the default UE noise figure (5 dB)
+        m_noisePerReMw = std::pow(10, (-174 + 10 * std::log10(15e3) + 5) / 10);
+    }
+
+    /**
+     * @brief Set the antenna arrays, steered towards each other (ideal beamforming).
+     * @param gnbElements elements of the gNB array
+     * @param ueElements elements of the UE array
+     */
+    void SetArrays(uint32_t gnbElements, uint32_t ueElements)
+    {
+        m_arrayGainDb = 10 * std::log10(double(gnbElements) * ueElements);
+    }
+
+    /// @brief Use the A3 (RSRP) trigger.
+    void SetA3(double hysteresisDb, Time timeToTrigger)
+    {
+        m_a3 = true;
+        m_hysteresisDb = hysteresisDb;
+        m_timeToTriggerNs = timeToTrigger.GetNanoSeconds();
+    }
+
+    /// @brief Use the A2-A4 (RSRQ) trigger, thresholds in RSRQ ranges (0-34).
+    void SetA2A4(uint32_t servingCellThreshold, uint32_t neighbourCellOffset)
+    {
+        m_a3 = false;
+        m_servingCellThreshold = servingCellThreshold;
+        m_neighbourCellOffset = neighbourCellOffset;
+    }
+
+    /// @brief Set the walk step (default 10 ms).
+    void SetStep(Time step)
+    {
+        NS_ABORT_MSG_UNLESS(step.IsStrictlyPositive(), "The pre-screen step must be positive");
+        m_step = step;
+    }
+
+    /// @brief Set the window of a ping-pong (default 1 s).
+    void SetPingPongWindow(Time window)
+    {
+        m_pingPongWindowNs = window.GetNanoSeconds();
+    }
+
+    /**
+     * @brief Add a cell; the cell id is the order of the calls, starting at 1.
+     * @param gnb node of the gNB, with its mobility model
+     * @param element antenna element of the gNB array
+     * @param bearing boresight of the array in radians
+     */
+    void AddCell(Ptr<Node> gnb, Ptr<AntennaModel> element, double bearing)
+    {
+        m_cells.push_back({gnb->GetObject<MobilityModel>(), element, bearing});
+    }
+
+    /**
+     * @brief Walk the UEs from now to stop, attached to their best cell at the start.
+     *
+     * Runs the simulator, which must have nothing else scheduled.
+     * @param ues the UE nodes, with their mobility models
+     * @param stop end of the walk
+     */
+    void Run(const NodeContainer& ues, Time stop)
+    {
+        NS_ABORT_MSG_UNLESS(m_lossModel, "RsrpPrescreen needs a propagation loss model");
+        NS_ABORT_MSG_IF(m_cells.size() < 2, "RsrpPrescreen needs at least two cells");
+        for (uint32_t u = 0; u < ues.GetN(); ++u)
+        {
+            UeState ue;
+            ue.mobility = ues.Get(u)->GetObject<MobilityModel>();
+            ue.rsrpDbm.assign(m_cells.size(), std::numeric_limits<double>::quiet_NaN());
+            m_ues.push_back(ue);
+        }
+        auto start = std::chrono::steady_clock::now();
+        Simulator::ScheduleNow(&RsrpPrescreen::Step, this);
+        Simulator::Stop(stop - Simulator::Now());
+        Simulator::Run();
+        m_wallSeconds =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        std::cout << "Pre-screen: " << m_handovers.size() << " handovers, " << m_pingPongs
+                  << " ping-pongs in " << m_steps << " steps, " << m_wallSeconds * 1e3
+                  << " ms" << std::endl;
+    }
+
+    /// @brief Write the predicted handovers, one line each.
+    void Write(const std::string& path) const
+    {
+        std::ofstream out(path);
+        NS_ABORT_MSG_UNLESS(out, "Unable to create " << path);
+        out << "time\tue\tsourceCell\ttargetCell\tsourceRsrp\ttargetRsrp\tpingPong\n";
+        char time[32];
+        for (const auto& h : m_handovers)
+        {
+            std::snprintf(time, sizeof(time), "%.9f", h.timeNs * 1e-9);
+            out << time << "\t" << h.ue << "\t" << h.source + 1 << "\t"
+                << h.target + 1 << "\t" << h.sourceRsrpDbm << "\t" << h.targetRsrpDbm << "\t"
+                << h.pingPong << "\n";
+        }
+    }
+
+    /**
+     * @brief Add the predictions to a summary.
+     * @param summary run summary receiving the pre-screen fields
+     */
+    void AddToSummary(RunSummary& summary) const
+    {
+        int64_t minDwellNs = -1;
+        for (const auto& ue : m_ues)
+        {
+            if (ue.minDwellNs >= 0 && (minDwellNs < 0 || ue.minDwellNs < minDwellNs))
+            {
+                minDwellNs = ue.minDwellNs;
+            }
+        }
+        summary.Set("prescreenHandovers", m_handovers.size());
+        summary.Set("prescreenPingPongs", m_pingPongs);
+        summary.Set("prescreenMinDwellMs", minDwellNs < 0 ? 0.0 : minDwellNs * 1e-6);
+        summary.Set("prescreenStepMs", m_step.GetSeconds() * 1e3);
+        summary.Set("prescreenSteps", m_steps);
+        summary.Set("prescreenWallMs", m_wallSeconds * 1e3);
+    }
+
+  private:
+    /// One gNB cell
+    struct Cell
+    {
+        Ptr<MobilityModel> mobility; //!< gNB position
+        Ptr<AntennaModel> element;   //!< Antenna element of the array
+        double bearing;              //!< Boresight in radians
+    };
+
+    /// Filtered measurements and trigger state of one UE
+    struct UeState
+    {
+        Ptr<MobilityModel> mobility; //!< UE position
+        std::vector<double> rsrpDbm; //!< Layer 3 filtered RSRP per cell
+        uint32_t serving{0};         //!< Index of the serving cell
+        int64_t enteringNs{-1};      //!< Start of the A3 entering condition, -1 if not met
+        uint32_t lastSource{0};      //!< Source of the previous handover
+        int64_t lastHandoverNs{-1};  //!< Time of the previous handover
+        int64_t minDwellNs{-1};      //!< Shortest time between two handovers
+    };
+
+    /// One predicted handover
+    struct Handover
+    {
+        int64_t timeNs;       //!< Trigger time
+        uint32_t ue;          //!< UE index
+        uint32_t source;      //!< Source cell index
+        uint32_t target;      //!< Target cell index
+        double sourceRsrpDbm; //!< Filtered RSRP of the source
+        double targetRsrpDbm; //!< Filtered RSRP of the target
+        bool pingPong;        //!< Back to the previous cell within the window
+    };
+
+    /// RSRP of a cell at a UE position
+    double Rsrp(const Cell& cell, Ptr<MobilityModel> ue) const
+    {
+        const Angles towardsUe(ue->GetPosition(), cell.mobility->GetPosition());
+        const double elementGainDb =
+            cell.element->GetGainDb(Angles(towardsUe.GetAzimuth() - cell.bearing,
+                                           towardsUe.GetInclination()));
+        return m_lossModel->CalcRxPower(m_txPerReDbm + m_arrayGainDb + elementGainDb,
+                                        cell.mobility,
+                                        ue);
+    }
+
+    /// RSRQ range (0-34) of a cell with every cell fully loaded
+    int RsrqRange(const UeState& ue, uint32_t cell) const
+    {
+        double rssiPerReMw = m_noisePerReMw;
+        for (double rsrp : ue.rsrpDbm)
+        {
+            rssiPerReMw += std::pow(10, rsrp / 10);
+        }
+        // RSSI over 12 subcarriers per resource block
+        const double rsrqDb = ue.rsrpDbm[cell] - 10 * std::log10(12 * rssiPerReMw);
+        return std::clamp(static_cast<int>(std::floor(2 * (rsrqDb + 20))), 0, 34);
+    }
+
+    void Step()
+    {
+        const int64_t now = Simulator::Now().GetNanoSeconds();
+        // filter coefficient 4 (a = 1/2) per 200 ms of measurements, kept at any step
+        const double a = 1 - std::pow(0.5, m_step.GetSeconds() / 0.2);
+        for (uint32_t u = 0; u < m_ues.size(); ++u)
+        {
+            UeState& ue = m_ues[u];
+            for (uint32_t c = 0; c < m_cells.size(); ++c)
+            {
+                const double rsrp = Rsrp(m_cells[c], ue.mobility);
+                ue.rsrpDbm[c] =
+                    std::isnan(ue.rsrpDbm[c]) ? rsrp : (1 - a) * ue.rsrpDbm[c] + a * rsrp;
+            }
+            if (m_steps == 0)
+            {
+                ue.serving = std::max_element(ue.rsrpDbm.begin(), ue.rsrpDbm.end()) -
+                             ue.rsrpDbm.begin();
+                continue;
+            }
+            uint32_t best = ue.serving == 0 ? 1 : 0;
+            for (uint32_t c = 0; c < m_cells.size(); ++c)
+            {
+                if (c != ue.serving && ue.rsrpDbm[c] > ue.rsrpDbm[best])
+                {
+                    best = c;
+                }
+            }
+            if (m_a3 ? A3Triggered(ue, best, now) : A2A4Triggered(ue, best))
+            {
+                HandOver(u, best, now);
+            }
+        }
+        ++m_steps;
+        Simulator::Schedule(m_step, &RsrpPrescreen::Step, this);
+    }
+
+    bool A3Triggered(UeState& ue, uint32_t best, int64_t now) const
+    {
+        if (ue.rsrpDbm[best] <= ue.rsrpDbm[ue.serving] + m_hysteresisDb)
+        {
+            ue.enteringNs = -1;
+            return false;
+        }
+        if (ue.enteringNs < 0)
+        {
+            ue.enteringNs = now;
+        }
+        return now - ue.enteringNs >= m_timeToTriggerNs;
+    }
+
+    bool A2A4Triggered(const UeState& ue, uint32_t best) const
+    {
+        const int serving = RsrqRange(ue, ue.serving);
+        return serving < static_cast<int>(m_servingCellThreshold) &&
+               RsrqRange(ue, best) - serving >= static_cast<int>(m_neighbourCellOffset);
+    }
+
+    void HandOver(uint32_t u, uint32_t target, int64_t now)
+    {
+        UeState& ue = m_ues[u];
+        const bool pingPong = ue.lastHandoverNs >= 0 && ue.lastSource == target &&
+                              now - ue.lastHandoverNs <= m_pingPongWindowNs;
+        m_pingPongs += pingPong;
+        if (ue.lastHandoverNs >= 0)
+        {
+            const int64_t dwell = now - ue.lastHandoverNs;
+            ue.minDwellNs = ue.minDwellNs < 0 ? dwell : std::min(ue.minDwellNs, dwell);
+        }
+        m_handovers.push_back(
+            {now, u, ue.serving, target, ue.rsrpDbm[ue.serving], ue.rsrpDbm[target], pingPong});
+        ue.lastSource = ue.serving;
+        ue.lastHandoverNs = now;
+        ue.serving = target;
+        ue.enteringNs = -1;
+    }
+
+    Ptr<PropagationLossModel> m_lossModel;  //!< Pathloss, shadowing and channel condition
+    std::vector<Cell> m_cells;              //!< gNB cells
+    std::vector<UeState> m_ues;             //!< Walked UEs
+    std::vector<Handover> m_handovers;      //!< Predicted handovers, in time order
+    double m_resourceElements{12};          //!< Subcarriers of the bandwidth
+    double m_txPerReDbm{40};                //!< TX power per subcarrier
+    double m_noisePerReMw{0};               //!< Noise per subcarrier
+    double m_arrayGainDb{0};                //!< Gain of both arrays
+    bool m_a3{true};                        //!< A3 trigger, A2-A4 otherwise
+    double m_hysteresisDb{3};               //!< A3 hysteresis
+    int64_t m_timeToTriggerNs{100000000};   //!< A3 time to trigger
+    uint32_t m_servingCellThreshold{30};    //!< A2-A4 serving RSRQ range threshold
+    uint32_t m_neighbourCellOffset{5};      //!< A2-A4 neighbour offset in RSRQ ranges
+    Time m_step{MilliSeconds(10)};          //!< Walk step
+    int64_t m_pingPongWindowNs{1000000000}; //!< Ping-pong window
+    uint64_t m_pingPongs{0};                //!< Handovers back within the window
+    uint64_t m_steps{0};                    //!< Steps walked
+    double m_wallSeconds{0};                //!< Wall time of the walk
+};
+
+/**
+ * @brief Pre-screen a handover scenario instead of simulating it.
+ *
+ * Uses the TX power, arrays and sector antennas of the NR devices the scenario would
+ * install, writes outputDir/prescreen.txt and fills the summary of the run.
+ * @param options options of the run, with the scenario frequency and isd resolved
+ * @param lossModel propagation loss model of the scenario channel
+ * @param hex layout giving the sector bearings, unused with hexRings=0
+ * @param gnbNodes the gNBs, one per cell
+ * @param ueNodes the UEs, with their mobility
+ * @param summary summary of the run, the program already set
+ */
+inline void
+RunPrescreen(const HandoverOptions& options,
+             Ptr<PropagationLossModel> lossModel,
+             const HexTopology& hex,
+             const NodeContainer& gnbNodes,
+             const NodeContainer& ueNodes,
+             RunSummary& summary)
+{
+    RsrpPrescreen screen;
+    screen.SetPropagationLossModel(lossModel);
+    screen.SetTransmission(options.txPower, options.bandwidth);
+    screen.SetArrays(8 * 8, 2 * 4);
+    if (options.handoverAlgorithm.find("A2A4") != std::string::npos)
+    {
+        screen.SetA2A4(options.servingCellThreshold, options.neighbourCellOffset);
+    }
+    else
+    {
+        screen.SetA3(options.hysteresis, Seconds(options.timeToTrigger * 1e-3));
+    }
+    screen.SetStep(Seconds(options.prescreenStep * 1e-3));
+    screen.SetPingPongWindow(Seconds(options.pingPongWindow));
+    for (uint32_t c = 0; c < gnbNodes.GetN(); ++c)
+    {
+        Ptr<AntennaModel> element;
+        if (options.sectors == 3)
+        {
+            element = CreateObject<ThreeGppAntennaModel>();
+        }
+        else
+        {
+            element = CreateObject<IsotropicAntennaModel>();
+        }
+        screen.AddCell(gnbNodes.Get(c),
+                       element,
+                       options.hexRings > 0 ? hex.GetCellBearing(c) : 0);
+    }
+    screen.Run(ueNodes, Seconds(options.simTime));
+    screen.Write(options.outputDir + "/prescreen.txt");
+    summary.Set("prescreen", 1);
+    options.AddToSummary(summary);
+    summary.Set("gnbs", gnbNodes.GetN());
+    summary.Set("ues", ueNodes.GetN());
+    summary.Set("rngRun", RngSeedManager::GetRun());
+    screen.AddToSummary(summary);
+}
+
+} // namespace ns3
+
+#endif // RSRP_PRESCREEN_H
@@ -0,0 +1,135 @@
+#ifndef RUN_SUMMARY_H
+#define RUN_SUMMARY_H
+
+/**
+ * @file run-summary.h
+ * @brief One-row summary of a simulation run.
+ *
+ * A run collects its configuration and results as ordered key/value pairs and
+ * writes them as a two-line CSV file (header and values). The sweep tools merge
+ * these files from many runs into a single table; a batch of runs in one process
+ * writes its table directly.
+ */
+
+#include "ns3/core-module.h"
+
+#include <algorithm>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+class RunSummary
+{
+  public:
+    /**
+     * @brief Set a field, replacing its previous value but keeping its column position.
+     * @param key column name
+     * @param value anything that can be streamed
+     */
+    template <class T>
+    void Set(const std::string& key, const T& value)
+    {
+        std::ostringstream text;
+        text.precision(10);
+        text << value;
+        for (auto& field : m_fields)
+        {
+            if (field.first == key)
+            {
+                field.second = text.str();
+                return;
+            }
+        }
+        m_fields.emplace_back(key, text.str());
+    }
+
+    /// @return the fields in insertion order
+    const std::vector<std::pair<std::string, std::string>>& GetFields() const
+    {
+        return m_fields;
+    }
+
+    /// @brief Write the header line and the value line to a CSV file.
+    void Write(const std::string& path) const
+    {
+        std::ofstream file(path);
+        NS_ABORT_MSG_UNLESS(file.is_open(), "Unable to open " << path);
+        for (std::size_t i = 0; i < m_fields.size(); ++i)
+        {
+            file << (i ? "," : "") << Quote(m_fields[i].first);
+        }
+        file << "\n";
+        for (std::size_t i = 0; i < m_fields.size(); ++i)
+        {
+            file << (i ? "," : "") << Quote(m_fields[i].second);
+        }
+        file << "\n";
+    }
+
+    /**
+     * @brief Write several summaries as one table, one row each.
+     *
+     * The columns are the union of the fields in first-seen order; a row lacking a
+     * field leaves it empty.
+     * @param rows the summaries
+     * @param path CSV file
+     */
+    static void WriteTable(const std::vector<RunSummary>& rows, const std::string& path)
+    {
+        std::vector<std::string> columns;
+        for (const auto& row : rows)
+        {
+            for (const auto& field : row.m_fields)
+            {
+                if (std::find(columns.begin(), columns.end(), field.first) == columns.end())
+                {
+                    columns.push_back(field.first);
+                }
+            }
+        }
+        std::ofstream file(path);
+        NS_ABORT_MSG_UNLESS(file.is_open(), "Unable to open " << path);
+        for (std::size_t i = 0; i < columns.size(); ++i)
+        {
+            file << (i ? "," : "") << Quote(columns[i]);
+        }
+        file << "\n";
+        for (const auto& row : rows)
+        {
+            for (std::size_t i = 0; i < columns.size(); ++i)
+            {
+                auto it = std::find_if(row.m_fields.begin(),
+                                       row.m_fields.end(),
+                                       [&](const auto& f) { return f.first == columns[i]; });
+                file << (i ? "," : "") << (it != row.m_fields.end() ? Quote(it->second) : "");
+            }
+            file << "\n";
+        }
+    }
+
+  private:
+    static std::string Quote(const std::string& text)
+    {
+        if (text.find_first_of(",\"\n") == std::string::npos)
+        {
+            return text;
+        }
+        std::string quoted = "\"";
+        for (char c : text)
+        {
+            quoted += (c == '"') ? std::string("\"\"") : std::string(1, c);
+        }
+        return quoted + "\"";
+    }
+
+    std::vector<std::pair<std::string, std::string>> m_fields; //!< Ordered key/value pairs
+};
+
+} // namespace ns3
+
+#endif // RUN_SUMMARY_H
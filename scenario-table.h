@@ -0,0 +1,61 @@
+#ifndef SCENARIO_TABLE_H
+#define SCENARIO_TABLE_H
+
+/**
+ * @file scenario-table.h
+ * @brief Deployment parameters of the supported 3GPP TR 38.901 scenarios.
+ *
+ * One row per scenario name accepted by the channel helper: gNB and UE antenna heights,
+ * the inter-site distance of the hexagonal layout and the default carrier frequency.
+ * Adding a scenario is adding a row.
+ */
+
+#include "ns3/core-module.h"
+
+#include <array>
+#include <string_view>
+
+namespace ns3
+{
+
+/// Deployment parameters of one scenario
+struct ScenarioParameters
+{
+    std::string_view name; //!< Scenario name of the channel helper
+    double hBS;            //!< gNB antenna height in m
+    double hUT;            //!< UE antenna height in m
+    double isd;            //!< Inter-site distance in m
+    double frequency;      //!< Default central frequency in Hz
+};
+
+/// The supported scenarios
+inline constexpr std::array<ScenarioParameters, 5> SCENARIO_TABLE{{
+    {"RMa", 35, 1.5, 1732, 28e9},
+    {"UMa", 25, 1.5, 500, 28e9},
+    {"UMi-StreetCanyon", 10, 1.5, 200, 28e9},
+    {"InH-OfficeMixed", 3, 1, 20, 28e9},
+    {"InH-OfficeOpen", 3, 1, 20, 28e9},
+}};
+
+/**
+ * @brief Look up a scenario, aborting on unknown names.
+ * @param name scenario name
+ * @return the parameters of the scenario
+ */
+inline const ScenarioParameters&
+GetScenarioParameters(std::string_view name)
+{
+    for (const auto& scenario : SCENARIO_TABLE)
+    {
+        if (scenario.name == name)
+        {
+            return scenario;
+        }
+    }
+    NS_ABORT_MSG("Scenario not supported. Choose among 'RMa', 'UMa', 'UMi-StreetCanyon', "
+                 "'InH-OfficeMixed', and 'InH-OfficeOpen'.");
+}
+
+} // namespace ns3
+
+#endif // SCENARIO_TABLE_H
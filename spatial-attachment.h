@@ -0,0 +1,237 @@
+#ifndef SPATIAL_ATTACHMENT_H
+#define SPATIAL_ATTACHMENT_H
+
+/**
+ * @file spatial-attachment.h
+ * @brief Initial attachment of the UEs through a uniform grid of the gNB positions.
+ *
+ * NrHelper::AttachToClosestGnb compares every UE with every gNB. This stage buckets
+ * the gNBs in a uniform grid (bucket size about the mean gNB spacing) and searches
+ * the buckets around each UE in growing rings until the k nearest gNBs are known.
+ * The UE then attaches to the nearest of them, or, when a propagation loss model is
+ * set, to the one with the strongest expected RSRP: gNB TX power plus the gain of
+ * the gNB antenna element toward the UE (so co-located sectors differ), minus the
+ * pathloss of the model. The array gain is the same for every cell and left out.
+ *
+ * The wall-clock time of the index build and of the attachment is kept so it can be
+ * compared with AttachToClosestGnb.
+ */
+
+#include "ns3/antenna-module.h"
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/nr-module.h"
+#include "ns3/propagation-module.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <map>
+#include <utility>
+#include <vector>
+
+namespace ns3
+{
+
+class SpatialAttachment
+{
+  public:
+    /// @brief Set the number of nearest gNBs compared per UE (default 4).
+    void SetCandidates(uint32_t k)
+    {
+        NS_ABORT_MSG_IF(k == 0, "At least one candidate gNB is needed");
+        m_candidates = k;
+    }
+
+    /**
+     * @brief Pick among the candidates by expected RSRP instead of distance.
+     * @param model the propagation loss model of the channel, e.g. the 3GPP one
+     */
+    void SetPropagationLossModel(Ptr<PropagationLossModel> model)
+    {
+        m_lossModel = model;
+    }
+
+    /**
+     * @brief Attach every UE to the best of its k nearest gNBs.
+     * @param nrHelper the helper the devices were installed with
+     * @param ueDevices the UE devices
+     * @param gnbDevices the gNB devices
+     */
+    void Attach(Ptr<NrHelper> nrHelper,
+                const NetDeviceContainer& ueDevices,
+                const NetDeviceContainer& gnbDevices)
+    {
+        NS_ABORT_MSG_IF(gnbDevices.GetN() == 0, "No gNB to attach to");
+        auto start = std::chrono::steady_clock::now();
+        BuildIndex(gnbDevices);
+        auto indexed = std::chrono::steady_clock::now();
+
+        std::vector<std::pair<double, uint32_t>> candidates;
+        for (uint32_t i = 0; i < ueDevices.GetN(); ++i)
+        {
+            Ptr<MobilityModel> ue = ueDevices.Get(i)->GetNode()->GetObject<MobilityModel>();
+            FindNearest(ue->GetPosition(), candidates);
+            uint32_t best = candidates.front().second;
+            if (m_lossModel)
+            {
+                double bestRsrp = -std::numeric_limits<double>::infinity();
+                for (const auto& [distance, g] : candidates)
+                {
+                    Ptr<NetDevice> gnb = gnbDevices.Get(g);
+                    double rsrp = m_lossModel->CalcRxPower(
+                        NrHelper::GetGnbPhy(gnb, 0)->GetTxPower() + ElementGainDb(g, ue),
+                        gnb->GetNode()->GetObject<MobilityModel>(),
+                        ue);
+                    if (rsrp > bestRsrp)
+                    {
+                        bestRsrp = rsrp;
+                        best = g;
+                    }
+                }
+            }
+            nrHelper->AttachToGnb(ueDevices.Get(i), gnbDevices.Get(best));
+        }
+        auto attached = std::chrono::steady_clock::now();
+        m_indexSeconds = std::chrono::duration<double>(indexed - start).count();
+        m_attachSeconds = std::chrono::duration<double>(attached - indexed).count();
+    }
+
+    /// @return wall-clock seconds spent building the grid
+    double GetIndexSeconds() const
+    {
+        return m_indexSeconds;
+    }
+
+    /// @return wall-clock seconds spent choosing the gNBs and attaching the UEs
+    double GetAttachSeconds() const
+    {
+        return m_attachSeconds;
+    }
+
+  private:
+    using Bucket = std::pair<int64_t, int64_t>;
+
+    void BuildIndex(const NetDeviceContainer& gnbDevices)
+    {
+        m_positions.clear();
+        m_grid.clear();
+        double minX = std::numeric_limits<double>::infinity();
+        double minY = minX;
+        double maxX = -minX;
+        double maxY = -minX;
+        m_elements.clear();
+        for (uint32_t g = 0; g < gnbDevices.GetN(); ++g)
+        {
+            Vector pos = gnbDevices.Get(g)->GetNode()->GetObject<MobilityModel>()->GetPosition();
+            m_positions.push_back(pos);
+            if (m_lossModel)
+            {
+                // element pattern and boresight of the gNB array, as the prescreen uses them
+                Ptr<Object> array =
+                    NrHelper::GetGnbPhy(gnbDevices.Get(g), 0)->GetSpectrumPhy()->GetAntenna();
+                PointerValue element;
+                DoubleValue bearing;
+                array->GetAttribute("AntennaElement", element);
+                array->GetAttribute("BearingAngle", bearing);
+                m_elements.emplace_back(element.Get<AntennaModel>(), bearing.Get());
+            }
+            minX = std::min(minX, pos.x);
+            minY = std::min(minY, pos.y);
+            maxX = std::max(maxX, pos.x);
+            maxY = std::max(maxY, pos.y);
+        }
+        // about one gNB per bucket (co-located sectors share one), wider for gNBs in a line
+        const double width = maxX - minX;
+        const double height = maxY - minY;
+        m_bucketSize = std::max({std::sqrt(width * height / m_positions.size()),
+                                 std::max(width, height) / m_positions.size(),
+                                 1.0});
+        for (uint32_t g = 0; g < m_positions.size(); ++g)
+        {
+            m_grid[GetBucket(m_positions[g])].push_back(g);
+        }
+        m_maxRing = static_cast<int64_t>(std::ceil(std::max(width, height) / m_bucketSize)) + 1;
+    }
+
+    /// Gain in dB of the antenna element of a gNB toward a UE
+    double ElementGainDb(uint32_t g, Ptr<MobilityModel> ue) const
+    {
+        const auto& [element, bearing] = m_elements[g];
+        const Angles towardsUe(ue->GetPosition(), m_positions[g]);
+        return element->GetGainDb(
+            Angles(towardsUe.GetAzimuth() - bearing, towardsUe.GetInclination()));
+    }
+
+    Bucket GetBucket(const Vector& pos) const
+    {
+        return {static_cast<int64_t>(std::floor(pos.x / m_bucketSize)),
+                static_cast<int64_t>(std::floor(pos.y / m_bucketSize))};
+    }
+
+    /**
+     * Visit the buckets around a position ring by ring. Every gNB outside ring r is at
+     * least r buckets away, so the search stops once the k-th candidate is closer.
+     * @param pos UE position
+     * @param candidates filled with (distance, gNB index), nearest first
+     */
+    void FindNearest(const Vector& pos, std::vector<std::pair<double, uint32_t>>& candidates) const
+    {
+        candidates.clear();
+        const std::size_t k = std::min<std::size_t>(m_candidates, m_positions.size());
+        auto [bx, by] = GetBucket(pos);
+        // the UE can be outside the gNB area, keep growing until the area is covered
+        int64_t farRing = m_maxRing + static_cast<int64_t>(
+                                          std::ceil(CalculateDistance(pos, m_positions[0]) /
+                                                    m_bucketSize));
+        for (int64_t r = 0; r <= farRing; ++r)
+        {
+            for (int64_t dx = -r; dx <= r; ++dx)
+            {
+                for (int64_t dy = -r; dy <= r; ++dy)
+                {
+                    if (std::max(std::abs(dx), std::abs(dy)) != r)
+                    {
+                        continue;
+                    }
+                    auto it = m_grid.find({bx + dx, by + dy});
+                    if (it == m_grid.end())
+                    {
+                        continue;
+                    }
+                    for (uint32_t g : it->second)
+                    {
+                        candidates.emplace_back(CalculateDistance(pos, m_positions[g]), g);
+                    }
+                }
+            }
+            if (candidates.size() >= k)
+            {
+                std::partial_sort(candidates.begin(), candidates.begin() + k, candidates.end());
+                if (candidates[k - 1].first <= r * m_bucketSize)
+                {
+                    break;
+                }
+            }
+        }
+        std::sort(candidates.begin(), candidates.end());
+        candidates.resize(k);
+    }
+
+    uint32_t m_candidates{4};                       //!< Nearest gNBs compared per UE
+    Ptr<PropagationLossModel> m_lossModel;          //!< Set for RSRP based selection
+    std::vector<Vector> m_positions;                //!< gNB positions, by device index
+    std::map<Bucket, std::vector<uint32_t>> m_grid; //!< Bucket -> gNB indices
+    double m_bucketSize{1};                         //!< Bucket edge in meters
+    int64_t m_maxRing{0};                           //!< Rings spanning the gNB area
+    double m_indexSeconds{0};                       //!< Time of the last index build
+    double m_attachSeconds{0};                      //!< Time of the last attachment
+    /// gNB antenna element and bearing in radians, by device index (RSRP selection only)
+    std::vector<std::pair<Ptr<AntennaModel>, double>> m_elements;
+};
+
+} // namespace ns3
+
+#endif // SPATIAL_ATTACHMENT_H
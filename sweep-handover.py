@@ -0,0 +1,85 @@
+"""! Parameter sweep driver for nr-handover.cc and ex005.cc.
+
+Expands a grid of command line values, runs every point for every RNG run on all
+local cores (one process and one output directory per job) and merges the
+per-run summary.csv files into a single table.
+
+Example:
+    python3 scratch/sweep-handover.py --program nr-handover --output sweep \\
+        -p scenario=UMa,UMi-StreetCanyon -p speed=10,15,20 \\
+        -p handoverAlgorithm=ns3::NrA3RsrpHandoverAlgorithm \\
+        -p hysteresis=0.5,1,3 -p timeToTrigger=10,40,100 --runs 1:5
+"""
+
+import argparse
+import os
+import sys
+
+import handover_jobs
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("--program", default="nr-handover", help="scratch program to run")
+    parser.add_argument("--output", default="sweep", help="root directory of the job outputs")
+    parser.add_argument(
+        "-p",
+        "--param",
+        action="append",
+        default=[],
+        metavar="NAME=VALUES",
+        help="grid axis, VALUES is 'a,b,c' or 'start:stop[:step]'",
+    )
+    parser.add_argument("--runs", default="1", help="RngRun values, same syntax as VALUES")
+    parser.add_argument("--jobs", type=int, default=os.cpu_count(), help="parallel processes")
+    parser.add_argument("--ns3-dir", default=".", help="root of the ns-3 tree")
+    parser.add_argument("--binary", help="built program to run instead of ./ns3 run")
+    parser.add_argument(
+        "--resume", action="store_true", help="skip jobs that already have a summary.csv"
+    )
+    args = parser.parse_args(argv[1:])
+
+    grid = {}
+    for item in args.param:
+        name, _, values = item.partition("=")
+        grid[name] = handover_jobs.parse_values(values)
+    grid["RngRun"] = handover_jobs.parse_values(args.runs)
+
+    points = handover_jobs.expand_grid(grid)
+    jobs = [
+        handover_jobs.Job("job%05d" % i, args.program, params, args.output)
+        for i, params in enumerate(points)
+    ]
+    results = []
+    todo = []
+    for job in jobs:
+        summary = handover_jobs.read_summary(os.path.join(job.outdir, "summary.csv"))
+        if args.resume and summary is not None:
+            result = {"job": job.name, "status": "ok"}
+            result.update(job.params)
+            result.update(summary)
+            results.append(result)
+        else:
+            todo.append(job)
+
+    print("%d jobs (%d to run) on %d workers" % (len(jobs), len(todo), args.jobs))
+    for n, result in enumerate(
+        handover_jobs.run_jobs(todo, args.jobs, args.ns3_dir, args.binary), 1
+    ):
+        results.append(result)
+        print(
+            "[%d/%d] %s %s (%s s)"
+            % (n, len(todo), result["job"], result["status"], result["wallSeconds"])
+        )
+        sys.stdout.flush()
+
+    results.sort(key=lambda r: r["job"])
+    table = os.path.join(args.output, "sweep-summary.csv")
+    handover_jobs.write_table(results, table)
+    failed = sum(1 for r in results if r["status"] != "ok")
+    print("Merged %d runs into %s (%d failed)" % (len(results), table, failed))
+    return 1 if failed else 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
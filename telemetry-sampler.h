@@ -0,0 +1,291 @@
+#ifndef TELEMETRY_SAMPLER_H
+#define TELEMETRY_SAMPLER_H
+
+/**
+ * @file telemetry-sampler.h
+ * @brief Resource usage of a run sampled over simulated time.
+ *
+ * Every sampling interval the sampler records the process RSS (/proc/self/statm),
+ * the number of pending events (CountingMapScheduler), the RLC TX buffer occupancy of
+ * every downlink bearer of the gNBs and the wall-clock time spent per simulated
+ * second. telemetry.txt has one line per sample, rlc-buffers.txt one line per bearer
+ * and sample. Finish prints the peaks.
+ *
+ * The RLC does not expose its buffer size, so the occupancy of a bearer is estimated
+ * from its traces: bytes handed down by the PDCP minus bytes sent by the RLC minus
+ * bytes dropped by the RLC. RLC headers make it slightly low. The bearers are found by
+ * walking the UeMap of each gNB RRC at every sample, so bearers set up later (new
+ * connections, handovers) are picked up.
+ */
+
+#include "buffered-file-writer.h"
+#include "instrumented-scheduler.h"
+#include "run-summary.h"
+
+#include "ns3/core-module.h"
+#include "ns3/nr-module.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+namespace ns3
+{
+
+class TelemetrySampler
+{
+  public:
+    /// @brief Set the sampling interval (default 100 ms).
+    void SetInterval(Time interval)
+    {
+        NS_ABORT_MSG_UNLESS(interval.IsStrictlyPositive(),
+                            "Telemetry interval must be positive, got " << interval);
+        m_interval = interval;
+    }
+
+    /**
+     * @brief Set the output files.
+     * @param directory directory of telemetry.txt and rlc-buffers.txt
+     */
+    void SetOutputDirectory(const std::string& directory)
+    {
+        m_writer.SetPath(directory + "/telemetry.txt");
+        m_rlcWriter.SetPath(directory + "/rlc-buffers.txt");
+    }
+
+    /// @brief Sample the RLC bearers of these gNBs.
+    void TrackRlc(const NetDeviceContainer& gnbDevices)
+    {
+        for (uint32_t i = 0; i < gnbDevices.GetN(); ++i)
+        {
+            Ptr<NrGnbNetDevice> gnb = DynamicCast<NrGnbNetDevice>(gnbDevices.Get(i));
+            NS_ABORT_MSG_UNLESS(gnb, "TelemetrySampler only tracks NrGnbNetDevice");
+            m_gnbs.push_back(gnb);
+        }
+    }
+
+    /**
+     * @brief Install the counting scheduler and schedule the first sample.
+     * @param delay time of the first sample
+     */
+    void Start(Time delay)
+    {
+        if (!CountingMapScheduler::IsInstalled())
+        {
+            CountingMapScheduler::Install();
+        }
+        m_writer.Write(std::string("time\twallSeconds\twallPerSimSecond\trssMb\tpendingEvents"
+                                   "\texecutedEvents\tbearers\trlcBytes\trlcMaxBytes\n"));
+        m_rlcWriter.Write(std::string("time\tcellId\trnti\tlcid\tbytes\n"));
+        m_wallStart = std::chrono::steady_clock::now();
+        m_lastWall = 0;
+        m_lastSim = Simulator::Now();
+        m_event = Simulator::Schedule(delay, &TelemetrySampler::Sample, this);
+    }
+
+    /// @brief Stop sampling, close the files and print the peaks.
+    void Finish()
+    {
+        m_event.Cancel();
+        m_writer.Close();
+        m_rlcWriter.Close();
+        std::cout << "Telemetry peaks: RSS " << m_peakRss / 1048576.0 << " MB, "
+                  << m_peakPending << " pending events, RLC " << m_peakRlc
+                  << " bytes, " << m_peakWallPerSimSecond << " s wall per simulated second"
+                  << std::endl;
+    }
+
+    /// @return highest RSS sampled, in bytes
+    uint64_t GetPeakRss() const
+    {
+        return m_peakRss;
+    }
+
+    /// @return highest pending event count sampled
+    uint64_t GetPeakPendingEvents() const
+    {
+        return m_peakPending;
+    }
+
+    /// @return highest total RLC occupancy sampled, in bytes
+    uint64_t GetPeakRlcBytes() const
+    {
+        return m_peakRlc;
+    }
+
+    /// @return slowest interval, in wall-clock seconds per simulated second
+    double GetPeakWallPerSimSecond() const
+    {
+        return m_peakWallPerSimSecond;
+    }
+
+    /// @brief Add the peaks to the summary of the run.
+    void AddToSummary(RunSummary& summary) const
+    {
+        summary.Set("peakRssMb", m_peakRss / 1048576.0);
+        summary.Set("peakPendingEvents", m_peakPending);
+        summary.Set("peakRlcBytes", m_peakRlc);
+        summary.Set("peakWallPerSimSecond", m_peakWallPerSimSecond);
+    }
+
+    /// @return resident set size of this process in bytes, 0 if unavailable
+    static uint64_t GetRss()
+    {
+        FILE* statm = std::fopen("/proc/self/statm", "r");
+        if (!statm)
+        {
+            return 0;
+        }
+        unsigned long size = 0;
+        unsigned long resident = 0;
+        int n = std::fscanf(statm, "%lu %lu", &size, &resident);
+        std::fclose(statm);
+        return n == 2 ? static_cast<uint64_t>(resident) * sysconf(_SC_PAGESIZE) : 0;
+    }
+
+  private:
+    /// Trace counters of one bearer, heap allocated so trace callbacks keep a stable pointer
+    struct Bearer
+    {
+        Ptr<Object> rlc; // keeps the map key alive
+        uint16_t cellId{0};
+        uint16_t rnti{0};
+        uint8_t lcid{0};
+        uint64_t pdcpBytes{0};
+        uint64_t rlcBytes{0};
+        uint64_t dropBytes{0};
+
+        uint64_t Occupancy() const
+        {
+            return pdcpBytes > rlcBytes + dropBytes ? pdcpBytes - rlcBytes - dropBytes : 0;
+        }
+    };
+
+    static void PdcpTx(Bearer* bearer, uint16_t rnti, uint8_t lcid, uint32_t size)
+    {
+        bearer->pdcpBytes += size;
+    }
+
+    static void RlcTx(Bearer* bearer, uint16_t rnti, uint8_t lcid, uint32_t size)
+    {
+        bearer->rlcBytes += size;
+    }
+
+    static void RlcDrop(Bearer* bearer, Ptr<const Packet> p)
+    {
+        bearer->dropBytes += p->GetSize();
+    }
+
+    /// Connect to the bearers created since the last walk; returns the bearers in use
+    std::vector<Bearer*> WalkBearers()
+    {
+        std::vector<Bearer*> active;
+        for (const auto& gnb : m_gnbs)
+        {
+            ObjectMapValue ueMap;
+            gnb->GetRrc()->GetAttribute("UeMap", ueMap);
+            for (auto ue = ueMap.Begin(); ue != ueMap.End(); ++ue)
+            {
+                UintegerValue rnti;
+                ObjectMapValue drbMap;
+                ue->second->GetAttribute("C-RNTI", rnti);
+                ue->second->GetAttribute("DataRadioBearerMap", drbMap);
+                for (auto drb = drbMap.Begin(); drb != drbMap.End(); ++drb)
+                {
+                    PointerValue rlc;
+                    drb->second->GetAttribute("NrRlc", rlc);
+                    auto key = rlc.Get<Object>();
+                    auto& bearer = m_bearers[PeekPointer(key)];
+                    if (!bearer)
+                    {
+                        PointerValue pdcp;
+                        UintegerValue lcid;
+                        drb->second->GetAttribute("NrPdcp", pdcp);
+                        drb->second->GetAttribute("LogicalChannelIdentity", lcid);
+                        bearer = std::make_unique<Bearer>();
+                        bearer->rlc = key;
+                        bearer->cellId = gnb->GetCellId();
+                        bearer->rnti = rnti.Get();
+                        bearer->lcid = lcid.Get();
+                        pdcp.Get<Object>()->TraceConnectWithoutContext(
+                            "TxPDU",
+                            MakeBoundCallback(&TelemetrySampler::PdcpTx, bearer.get()));
+                        key->TraceConnectWithoutContext(
+                            "TxPDU",
+                            MakeBoundCallback(&TelemetrySampler::RlcTx, bearer.get()));
+                        key->TraceConnectWithoutContext(
+                            "TxDrop",
+                            MakeBoundCallback(&TelemetrySampler::RlcDrop, bearer.get()));
+                    }
+                    active.push_back(bearer.get());
+                }
+            }
+        }
+        return active;
+    }
+
+    void Sample()
+    {
+        const double now = Simulator::Now().GetSeconds();
+        const double wall =
+            std::chrono::duration<double>(std::chrono::steady_clock::now() - m_wallStart).count();
+        const double simElapsed = (Simulator::Now() - m_lastSim).GetSeconds();
+        const double wallPerSimSecond = simElapsed > 0 ? (wall - m_lastWall) / simElapsed : 0;
+        m_lastWall = wall;
+        m_lastSim = Simulator::Now();
+
+        const uint64_t rss = GetRss();
+        const uint64_t pending = CountingMapScheduler::GetPending();
+        uint64_t rlcTotal = 0;
+        uint64_t rlcMax = 0;
+        std::ostringstream rlcText;
+        const auto bearers = WalkBearers();
+        for (const Bearer* b : bearers)
+        {
+            uint64_t bytes = b->Occupancy();
+            rlcTotal += bytes;
+            rlcMax = std::max(rlcMax, bytes);
+            rlcText << now << "\t" << b->cellId << "\t" << b->rnti << "\t" << +b->lcid << "\t"
+                    << bytes << "\n";
+        }
+        m_rlcWriter.Write(rlcText.str());
+
+        std::ostringstream text;
+        text << now << "\t" << wall << "\t" << wallPerSimSecond << "\t" << rss / 1048576.0 << "\t"
+             << pending << "\t" << Simulator::GetEventCount() << "\t" << bearers.size() << "\t"
+             << rlcTotal << "\t" << rlcMax << "\n";
+        m_writer.Write(text.str());
+
+        m_peakRss = std::max(m_peakRss, rss);
+        m_peakPending = std::max(m_peakPending, pending);
+        m_peakRlc = std::max(m_peakRlc, rlcTotal);
+        m_peakWallPerSimSecond = std::max(m_peakWallPerSimSecond, wallPerSimSecond);
+        m_event = Simulator::Schedule(m_interval, &TelemetrySampler::Sample, this);
+    }
+
+    std::vector<Ptr<NrGnbNetDevice>> m_gnbs;                    //!< gNBs walked for bearers
+    std::map<const Object*, std::unique_ptr<Bearer>> m_bearers; //!< Bearers by RLC instance
+    BufferedFileWriter m_writer;                                //!< telemetry.txt
+    BufferedFileWriter m_rlcWriter;                             //!< rlc-buffers.txt
+    Time m_interval{MilliSeconds(100)};                         //!< Sampling interval
+    EventId m_event;                                            //!< Next sample
+    std::chrono::steady_clock::time_point m_wallStart;          //!< Wall clock at Start
+    double m_lastWall{0};                                       //!< Wall seconds at the last sample
+    Time m_lastSim;                                             //!< Simulation time of the last sample
+    uint64_t m_peakRss{0};                                      //!< Peak RSS in bytes
+    uint64_t m_peakPending{0};                                  //!< Peak pending events
+    uint64_t m_peakRlc{0};                                      //!< Peak total RLC bytes
+    double m_peakWallPerSimSecond{0};                           //!< Slowest interval
+};
+
+} // namespace ns3
+
+#endif // TELEMETRY_SAMPLER_H
@@ -0,0 +1,143 @@
+"""! Converter of UE mobility traces to the binary trajectory format.
+
+Writes the memory-mapped trajectory file replayed by trajectory-mobility.h
+(--mobilityTrace of nr-handover and ex005) from either
+
+- a CSV/TSV table with the columns ue, time (s), x, y and optionally z, or
+- an ns-2 movement script ("$node_(i) set X_ ..." initial positions and
+  "$ns_ at t \\"$node_(i) setdest x y speed\\"" movements).
+
+UE ids are mapped to trajectories 0..n-1 in ascending order; the mapping is
+printed. Waypoints are sorted by time per UE.
+
+Example:
+    python3 scratch/trajectory-converter.py vehicles.csv vehicles.traj --z 1.5
+    python3 scratch/trajectory-converter.py scenario.ns_movements scenario.traj
+"""
+
+import argparse
+import collections
+import csv
+import math
+import re
+import struct
+import sys
+
+HEADER = struct.Struct("<4sIII")
+INDEX = struct.Struct("<QQ")
+WAYPOINT = struct.Struct("<qddd")
+
+NS2_SET = re.compile(r"\$node_\((\d+)\)\s+set\s+([XYZ])_\s+(\S+)")
+NS2_SETDEST = re.compile(
+    r"\$ns_\s+at\s+(\S+)\s+\"\$node_\((\d+)\)\s+setdest\s+(\S+)\s+(\S+)\s+(\S+)\s*\""
+)
+
+
+def read_csv(path, z):
+    """! ue -> [(time s, x, y, z)] from a table with a header line."""
+    trajectories = collections.defaultdict(list)
+    with open(path, newline="", encoding="utf-8") as f:
+        sample = f.read(4096)
+        f.seek(0)
+        dialect = csv.Sniffer().sniff(sample, delimiters=",\t; ")
+        for row in csv.DictReader(f, dialect=dialect):
+            trajectories[int(row["ue"])].append(
+                (
+                    float(row["time"]),
+                    float(row["x"]),
+                    float(row["y"]),
+                    float(row["z"]) if row.get("z") not in (None, "") else z,
+                )
+            )
+    return trajectories
+
+
+def position_at(waypoints, t):
+    """! Position at time t on a list of (time, x, y, z) waypoints."""
+    if t <= waypoints[0][0]:
+        return waypoints[0][1:]
+    for (t0, x0, y0, z0), (t1, x1, y1, z1) in zip(waypoints, waypoints[1:]):
+        if t0 <= t < t1:
+            f = (t - t0) / (t1 - t0)
+            return (x0 + f * (x1 - x0), y0 + f * (y1 - y0), z0 + f * (z1 - z0))
+    return waypoints[-1][1:]
+
+
+def read_ns2(path, z):
+    """! ue -> [(time s, x, y, z)] from an ns-2 movement script."""
+    initial = collections.defaultdict(lambda: {"X": 0.0, "Y": 0.0, "Z": z})
+    moves = []
+    with open(path, encoding="utf-8") as f:
+        for line in f:
+            m = NS2_SETDEST.search(line)
+            if m:
+                t, node, x, y, speed = m.groups()
+                moves.append((float(t), int(node), float(x), float(y), float(speed)))
+                continue
+            m = NS2_SET.search(line)
+            if m:
+                initial[int(m.group(1))][m.group(2)] = float(m.group(3))
+    trajectories = {n: [(0.0, p["X"], p["Y"], p["Z"])] for n, p in initial.items()}
+    for t, node, x, y, speed in sorted(moves):
+        waypoints = trajectories.setdefault(node, [(0.0, x, y, z)])
+        # a new setdest interrupts the movement in progress
+        here = position_at(waypoints, t)
+        while len(waypoints) > 1 and waypoints[-1][0] > t:
+            waypoints.pop()
+        waypoints.append((t,) + tuple(here))
+        distance = math.hypot(x - here[0], y - here[1])
+        if speed > 0 and distance > 0:
+            waypoints.append((t + distance / speed, x, y, here[2]))
+    return trajectories
+
+
+def write_trajectories(trajectories, path):
+    """! Write the binary file.
+    @return (UE ids in trajectory order, number of waypoints)
+    """
+    ues = sorted(trajectories)
+    ordered = [sorted(trajectories[ue], key=lambda w: w[0]) for ue in ues]
+    with open(path, "wb") as f:
+        f.write(HEADER.pack(b"NRTJ", 1, len(ues), WAYPOINT.size))
+        first = 0
+        for waypoints in ordered:
+            f.write(INDEX.pack(first, len(waypoints)))
+            first += len(waypoints)
+        for waypoints in ordered:
+            f.write(
+                b"".join(WAYPOINT.pack(round(t * 1e9), x, y, z) for t, x, y, z in waypoints)
+            )
+    return ues, first
+
+
+def main(argv):
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument("input", help="CSV/TSV table or ns-2 movement script")
+    parser.add_argument("output", help="binary trajectory file")
+    parser.add_argument("--format", choices=["csv", "ns2"], help="input format (default: guess)")
+    parser.add_argument("--z", type=float, default=1.5, help="height when the input has none")
+    args = parser.parse_args(argv[1:])
+
+    fmt = args.format
+    if fmt is None:
+        with open(args.input, encoding="utf-8") as f:
+            fmt = "ns2" if "$node_" in f.read(4096) else "csv"
+    read = read_ns2 if fmt == "ns2" else read_csv
+    trajectories = read(args.input, args.z)
+    if not trajectories:
+        print("No waypoints in %s" % args.input)
+        return 1
+    ues, waypoints = write_trajectories(trajectories, args.output)
+    end = max(max(w[0] for w in trajectories[ue]) for ue in ues)
+    print(
+        "Wrote %s: %d UEs, %d waypoints, last at %g s"
+        % (args.output, len(ues), waypoints, end)
+    )
+    print("trajectory\tue")
+    for i, ue in enumerate(ues):
+        print("%d\t%d" % (i, ue))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main(sys.argv))
@@ -0,0 +1,231 @@
+#ifndef TRAJECTORY_MOBILITY_H
+#define TRAJECTORY_MOBILITY_H
+
+/**
+ * @file trajectory-mobility.h
+ * @brief UE mobility replayed from a memory-mapped binary trajectory file.
+ *
+ * Measured vehicle and pedestrian traces are converted once by
+ * trajectory-converter.py into a file that is mapped, not loaded: each
+ * TrajectoryMobilityModel keeps a cursor on the current segment of its UE and
+ * interpolates linearly between the two waypoints around the current time. The
+ * cursor moves forward as simulated time advances, and the pages behind it are handed
+ * back to the kernel, so memory follows the active window instead of the trace length.
+ * No events are scheduled; a position is computed when it is asked for, and the course
+ * change is notified when the cursor enters a new segment.
+ *
+ * File layout (little-endian):
+ * - header: the 4 bytes "NRTJ", uint32 version, uint32 number of UEs, uint32 waypoint size
+ * - index: per UE, uint64 first waypoint and uint64 number of waypoints
+ * - waypoints: TrajectoryWaypoint, grouped per UE and sorted by time within a UE
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/network-module.h"
+
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <string>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ns3
+{
+
+/// One waypoint of a UE, also the on-disk record
+struct TrajectoryWaypoint
+{
+    int64_t timeNs; //!< Time the UE is at the position
+    double x;       //!< Position
+    double y;       //!< Position
+    double z;       //!< Position
+};
+
+static_assert(sizeof(TrajectoryWaypoint) == 32, "TrajectoryWaypoint must stay packed");
+
+/// A mapped trajectory file, shared by the models of all UEs
+class TrajectoryFile : public SimpleRefCount<TrajectoryFile>
+{
+  public:
+    /// @brief Map a trajectory file written by trajectory-converter.py.
+    explicit TrajectoryFile(const std::string& path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        NS_ABORT_MSG_IF(fd < 0, "Unable to open " << path);
+        struct stat st;
+        NS_ABORT_MSG_IF(fstat(fd, &st) != 0 || st.st_size < 16, path << " is not a trajectory");
+        m_size = st.st_size;
+        void* map = mmap(nullptr, m_size, PROT_READ, MAP_SHARED, fd, 0);
+        close(fd);
+        NS_ABORT_MSG_IF(map == MAP_FAILED, "Unable to map " << path);
+        m_data = static_cast<const uint8_t*>(map);
+        uint32_t header[3];
+        std::memcpy(header, m_data + 4, sizeof(header));
+        NS_ABORT_MSG_UNLESS(std::memcmp(m_data, "NRTJ", 4) == 0 && header[0] == 1 &&
+                                header[2] == sizeof(TrajectoryWaypoint),
+                            path << " is not a version 1 trajectory file");
+        m_ues = header[1];
+        const uint64_t indexEnd = 16 + 16 * uint64_t(m_ues);
+        NS_ABORT_MSG_IF(indexEnd > m_size,
+                        path << " is truncated: no room for the index of " << m_ues << " UEs");
+        m_index = reinterpret_cast<const uint64_t*>(m_data + 16);
+        m_waypoints = reinterpret_cast<const TrajectoryWaypoint*>(m_index + 2 * m_ues);
+        const uint64_t waypoints = (m_size - indexEnd) / sizeof(TrajectoryWaypoint);
+        for (uint32_t ue = 0; ue < m_ues; ++ue)
+        {
+            // written this way so that a corrupt first waypoint cannot wrap around
+            const uint64_t first = m_index[2 * ue];
+            const uint64_t count = m_index[2 * ue + 1];
+            NS_ABORT_MSG_IF(count == 0 || first > waypoints || count > waypoints - first,
+                            path << ": bad waypoint range of UE " << ue);
+        }
+    }
+
+    TrajectoryFile(const TrajectoryFile&) = delete;
+    TrajectoryFile& operator=(const TrajectoryFile&) = delete;
+
+    ~TrajectoryFile()
+    {
+        munmap(const_cast<uint8_t*>(m_data), m_size);
+    }
+
+    /// @return number of UE trajectories in the file
+    uint32_t GetNumUes() const
+    {
+        return m_ues;
+    }
+
+    /// @return first waypoint of a UE
+    const TrajectoryWaypoint* GetFirst(uint32_t ue) const
+    {
+        return m_waypoints + m_index[2 * ue];
+    }
+
+    /// @return number of waypoints of a UE
+    uint64_t GetCount(uint32_t ue) const
+    {
+        return m_index[2 * ue + 1];
+    }
+
+    /// @brief Let the kernel drop the whole pages in [from, to), they will not be read again.
+    void Release(const TrajectoryWaypoint* from, const TrajectoryWaypoint* to) const
+    {
+        static const uintptr_t page = sysconf(_SC_PAGESIZE);
+        const uintptr_t begin = (reinterpret_cast<uintptr_t>(from) + page - 1) / page * page;
+        const uintptr_t end = reinterpret_cast<uintptr_t>(to) / page * page;
+        if (begin < end)
+        {
+            madvise(reinterpret_cast<void*>(begin), end - begin, MADV_DONTNEED);
+        }
+    }
+
+  private:
+    const uint8_t* m_data{nullptr};                 //!< Start of the mapping
+    std::size_t m_size{0};                          //!< Bytes mapped
+    uint32_t m_ues{0};                              //!< UE trajectories
+    const uint64_t* m_index{nullptr};               //!< First waypoint and count per UE
+    const TrajectoryWaypoint* m_waypoints{nullptr}; //!< All waypoints
+};
+
+class TrajectoryMobilityModel : public MobilityModel
+{
+  public:
+    static TypeId GetTypeId()
+    {
+        static TypeId tid = TypeId("ns3::TrajectoryMobilityModel")
+                                .SetParent<MobilityModel>()
+                                .AddConstructor<TrajectoryMobilityModel>();
+        return tid;
+    }
+
+    /**
+     * @brief Replay one trajectory of a file.
+     * @param file mapped trajectory file
+     * @param ue index of the trajectory in the file
+     */
+    void SetTrajectory(Ptr<TrajectoryFile> file, uint32_t ue)
+    {
+        NS_ABORT_MSG_IF(ue >= file->GetNumUes(), "No trajectory " << ue << " in the file");
+        m_file = file;
+        m_current = file->GetFirst(ue);
+        m_last = m_current + file->GetCount(ue) - 1;
+    }
+
+    /**
+     * @brief Give node i the trajectory i of a file.
+     * @param file mapped trajectory file, with at least as many trajectories as nodes
+     * @param nodes the UE nodes, without a mobility model yet
+     */
+    static void Install(Ptr<TrajectoryFile> file, const NodeContainer& nodes)
+    {
+        NS_ABORT_MSG_IF(file->GetNumUes() < nodes.GetN(),
+                        "The trajectory file has " << file->GetNumUes() << " UEs, "
+                                                   << nodes.GetN() << " needed");
+        for (uint32_t i = 0; i < nodes.GetN(); ++i)
+        {
+            Ptr<TrajectoryMobilityModel> model = CreateObject<TrajectoryMobilityModel>();
+            model->SetTrajectory(file, i);
+            nodes.Get(i)->AggregateObject(model);
+        }
+    }
+
+  private:
+    /// Move the cursor to the segment of the current time
+    void Update() const
+    {
+        const int64_t now = Simulator::Now().GetNanoSeconds();
+        const TrajectoryWaypoint* start = m_current;
+        while (m_current < m_last && m_current[1].timeNs <= now)
+        {
+            ++m_current;
+        }
+        if (m_current != start)
+        {
+            m_file->Release(start, m_current);
+            NotifyCourseChange();
+        }
+    }
+
+    Vector DoGetPosition() const override
+    {
+        Update();
+        const int64_t now = Simulator::Now().GetNanoSeconds();
+        const TrajectoryWaypoint& a = m_current[0];
+        if (m_current == m_last || now <= a.timeNs)
+        {
+            return Vector(a.x, a.y, a.z);
+        }
+        const TrajectoryWaypoint& b = m_current[1];
+        const double f = double(now - a.timeNs) / (b.timeNs - a.timeNs);
+        return Vector(a.x + f * (b.x - a.x), a.y + f * (b.y - a.y), a.z + f * (b.z - a.z));
+    }
+
+    /// The trajectory defines the position; the position allocators of helpers are ignored
+    void DoSetPosition(const Vector& position) override
+    {
+    }
+
+    Vector DoGetVelocity() const override
+    {
+        Update();
+        const TrajectoryWaypoint& a = m_current[0];
+        if (m_current == m_last || Simulator::Now().GetNanoSeconds() < a.timeNs)
+        {
+            return Vector(0, 0, 0);
+        }
+        const TrajectoryWaypoint& b = m_current[1];
+        const double dt = (b.timeNs - a.timeNs) * 1e-9;
+        return Vector((b.x - a.x) / dt, (b.y - a.y) / dt, (b.z - a.z) / dt);
+    }
+
+    Ptr<TrajectoryFile> m_file;                           //!< Mapped trajectory file
+    mutable const TrajectoryWaypoint* m_current{nullptr}; //!< Waypoint starting the segment
+    const TrajectoryWaypoint* m_last{nullptr};            //!< Last waypoint of the UE
+};
+
+} // namespace ns3
+
+#endif // TRAJECTORY_MOBILITY_H